@@ -0,0 +1,32 @@
+#include <memory>
+#include <string>
+
+#include "coco_api.h"
+#include "common/error.hpp"
+#include "log/log.hpp"
+#include "net/layer7/coco_http.hpp"
+#include "protocol/http/http_file.h"
+
+// serve the files of directory, for example:
+//      ./http_file_server ./www
+//      curl -r 0-99 http://127.0.0.1:9083/static/index.html
+int main(int argc, char **argv) {
+    log_level = log_trace;
+    CocoInit();
+
+    std::string dir = argc > 1 ? argv[1] : ".";
+    std::string ip = "0.0.0.0";
+    int32_t port = 9083;
+
+    auto server = std::unique_ptr<HttpServer>(new HttpServer(false));
+    auto mux = std::unique_ptr<HttpServeMux>(new HttpServeMux());
+    mux->handle("/static/", new HttpFileHandler(dir));
+    if (server->ListenAndServe(ip, port, mux.get()) != COCO_SUCCESS) {
+        coco_error("listen failed");
+        return -1;
+    }
+    server->Start();
+
+    // serve until SIGTERM or SIGINT, then drain the connections.
+    return CocoRun();
+}
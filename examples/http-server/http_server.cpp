@@ -44,7 +44,6 @@ int main() {
     }
     httpServer->Start();
 
-    CocoLoopMs(1000);
-
-    return 0;
+    // serve until SIGTERM or SIGINT, then drain the connections.
+    return CocoRun();
 }
\ No newline at end of file
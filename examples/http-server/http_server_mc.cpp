@@ -0,0 +1,55 @@
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include "base/coco_runtime.hpp"
+#include "coco_api.h"
+#include "common/error.hpp"
+#include "log/log.hpp"
+#include "net/layer7/coco_http.hpp"
+
+using namespace std;
+
+class DefHandler : public IHttpHandler {
+ public:
+    DefHandler() = default;
+    virtual ~DefHandler() = default;
+
+    virtual int serve_http(HttpResponseWriter *w, HttpMessage *r) {
+        std::string res = "hello world";
+        w->header()->set_content_length((int)res.length());
+        w->header()->set_content_type("text/plain");
+
+        w->Write(const_cast<char *>(res.c_str()), (int)res.length());
+
+        return COCO_SUCCESS;
+    }
+};
+
+int main() {
+    log_level = log_trace;
+
+    std::string _ip = "0.0.0.0";
+    int32_t _port = 9082;
+
+    // one worker per cpu core, each worker accepts on its own SO_REUSEPORT shard.
+    CocoRuntime rt(0);
+    rt.SetCpuAffinity(true);
+    int ret = rt.Start([&](CocoWorker *w) -> int {
+        // the server and mux live in the worker's scheduler, never shared.
+        HttpServeMux *mux = new HttpServeMux();
+        mux->handle("/", new DefHandler());
+
+        HttpServer *server = new HttpServer(false);
+        if (server->ListenAndServe(_ip, _port, mux) != 0) {
+            coco_error("worker %d listen failed", w->GetId());
+            return -1;
+        }
+        return server->Start();
+    });
+    if (ret != COCO_SUCCESS) {
+        return -1;
+    }
+
+    return rt.Join();
+}
@@ -0,0 +1,57 @@
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include "base/coco_master.hpp"
+#include "coco_api.h"
+#include "common/error.hpp"
+#include "log/log.hpp"
+#include "net/layer7/coco_http.hpp"
+
+using namespace std;
+
+class DefHandler : public IHttpHandler {
+ public:
+    DefHandler() = default;
+    virtual ~DefHandler() = default;
+
+    virtual int serve_http(HttpResponseWriter *w, HttpMessage *r) {
+        std::string res = "hello world";
+        w->header()->set_content_length((int)res.length());
+        w->header()->set_content_type("text/plain");
+
+        w->Write(const_cast<char *>(res.c_str()), (int)res.length());
+
+        return COCO_SUCCESS;
+    }
+};
+
+// kill -HUP to restart the workers, or start another one to upgrade the running one.
+int main() {
+    log_level = log_trace;
+
+    std::string _ip = "0.0.0.0";
+    int32_t _port = 9083;
+
+    // one worker process per cpu core, the master holds the sockets.
+    CocoMaster master(0);
+    if (master.SetUpgradePath("/tmp/http_server_mp.sock") != COCO_SUCCESS) {
+        return -1;
+    }
+    if (master.ListenTcp(_ip, _port) != COCO_SUCCESS) {
+        return -1;
+    }
+
+    return master.Run([&](int id) -> int {
+        HttpServeMux *mux = new HttpServeMux();
+        mux->handle("/", new DefHandler());
+
+        // the socket inherited from master, never bind again.
+        HttpServer *server = new HttpServer(false);
+        if (server->ListenAndServe(_ip, _port, mux) != 0) {
+            coco_error("worker %d listen failed", id);
+            return -1;
+        }
+        return server->Start();
+    });
+}
@@ -36,7 +36,7 @@ PingPongClient::PingPongClient(std::string _server_ip, int _port,
   timeout = _timeout;
 }
 int PingPongClient::connect() {
-  conn = DialTcp(dst_ip, dst_port, timeout);
+  conn = DialTcp(dst_ip, dst_port, timeout, SocketOptions::LowLatency());
   if (conn == NULL) {
     return -1;
   }
@@ -1,3 +1,5 @@
+#include <stdlib.h>
+
 #include <iostream>
 #include <memory>
 #include <string>
@@ -13,6 +15,8 @@ using namespace std;
 
 string local_ip = "127.0.0.1";
 int port = 8080;
+// pause accepting when too many connections.
+int max_conns = 10000;
 
 class PingPongServer : public ConnRoutine {
 
@@ -63,11 +67,13 @@ public:
 private:
   TcpListener *l_;
   ConnManager *manager_;
+  ConnQuota quota_;
 };
 
 PingPongListener::PingPongListener(TcpListener *l) {
   l_ = l;
   manager_ = new ConnManager();
+  quota_.max_conns = max_conns;
 }
 
 PingPongListener::~PingPongListener() {
@@ -84,26 +90,37 @@ PingPongListener::~PingPongListener() {
 
 int PingPongListener::Cycle() {
   while (true) {
-    manager_->Destroy();
+    if (manager_->WaitAdmit(&quota_) != COCO_SUCCESS) {
+      break;
+    }
 
     std::unique_ptr<TcpConn> p;
     TcpConn *conn = l_->Accept();
+    if (conn == nullptr) {
+      continue;
+    }
     p.reset(conn);
     PingPongServer *pserver = new PingPongServer(manager_, std::move(p));
+    manager_->Attach(pserver, &quota_);
     pserver->Start();
   }
   return 0;
 }
 
-int main() {
+int main(int argc, char **argv) {
   log_level = log_dbg;
   CocoInit();
 
-  TcpListener *l = ListenTcp(local_ip, port);
+  // the small messages of pingpong, never delayed by nagle or delayed ack.
+  TcpListener *l = ListenTcp(local_ip, port, SocketOptions::LowLatency());
   if (l == NULL) {
     coco_error("create listen socket failed");
     return -1;
   }
+  // the max connections accepted in one wakeup, 1 to accept one by one.
+  if (argc > 1) {
+    l->SetAcceptBatch(atoi(argv[1]));
+  }
   PingPongListener *pl = new PingPongListener(l);
   pl->Start();
 
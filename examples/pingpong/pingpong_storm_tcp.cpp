@@ -0,0 +1,76 @@
+#include <stdlib.h>
+
+#include <iostream>
+#include <string>
+
+#include "base/coco_task.hpp"
+#include "coco_api.h"
+#include "common/error.hpp"
+#include "log/log.hpp"
+#include "net/coco_socket.hpp"
+#include "net/layer4/coco_tcp.hpp"
+
+using namespace std;
+
+string server_ip = "127.0.0.1";
+int port = 8080;
+
+// the connection storm to benchmark the accept of pingpong_server_tcp, each
+// coroutine connects, does one ping-pong and closes, as fast as possible.
+// Usage:
+//       pingpong_storm_tcp [concurrency] [seconds]
+int nb_done = 0;
+int nb_failed = 0;
+
+void storm(bool *stop) {
+  char buf[16] = "ping";
+  while (!*stop) {
+    TcpConn *conn = DialTcp(server_ip, port, 1000 * 1000);
+    if (conn == NULL) {
+      nb_failed++;
+      CocoSleepMs(10);
+      continue;
+    }
+
+    ssize_t nread = 0;
+    if (conn->Write(buf, 4, NULL) != COCO_SUCCESS ||
+        conn->Read(buf, sizeof(buf), &nread) != COCO_SUCCESS) {
+      nb_failed++;
+    } else {
+      nb_done++;
+    }
+    delete conn;
+  }
+}
+
+int main(int argc, char **argv) {
+  int concurrency = argc > 1 ? atoi(argv[1]) : 256;
+  int seconds = argc > 2 ? atoi(argv[2]) : 10;
+
+  log_level = log_warn;
+  CocoInit();
+  CocoSetGoLimits(concurrency, concurrency, concurrency);
+
+  bool stop = false;
+  CocoWaitGroup wg;
+  wg.Add(concurrency);
+  for (int i = 0; i < concurrency; i++) {
+    CocoGo([&]() {
+      storm(&stop);
+      wg.Done();
+    });
+  }
+
+  int last = 0;
+  for (int i = 0; i < seconds; i++) {
+    CocoSleep(1);
+    cout << "conns/s: " << nb_done - last << ", failed: " << nb_failed << endl;
+    last = nb_done;
+  }
+  stop = true;
+  wg.Wait();
+
+  cout << "total conns: " << nb_done << ", avg conns/s: " << nb_done / seconds
+       << ", failed: " << nb_failed << endl;
+  return 0;
+}
@@ -0,0 +1,188 @@
+#pragma once
+
+#include <errno.h>
+#include <stddef.h>
+
+#include <deque>
+#include <vector>
+
+#include "st.h"
+
+#include "common/error.hpp"
+
+/**
+ * the channel to pass values between coroutines of the same scheduler.
+ * Usage:
+ *       Channel<WebSocektMessage *> ch(1024);
+ *       // producer, in the message handler.
+ *       ch.send(msg);
+ *       // consumer, in a worker coroutine.
+ *       std::vector<WebSocektMessage *> msgs;
+ *       while (ch.recv_many(msgs, 64) == COCO_SUCCESS) {
+ *           ...
+ *       }
+ * @remark the values are moved into and out of the channel, never copied.
+ * @remark the timeout is in us, ST_UTIME_NO_TIMEOUT to wait forever.
+ */
+template <class T>
+class Channel {
+ public:
+    /**
+     * @param capacity the max number of queued values, 0 for unbounded.
+     */
+    Channel(size_t capacity = 0) {
+        capacity_ = capacity;
+        closed_ = false;
+        not_empty_ = st_cond_new();
+        not_full_ = st_cond_new();
+    }
+    virtual ~Channel() {
+        st_cond_destroy(not_empty_);
+        st_cond_destroy(not_full_);
+    }
+
+ public:
+    /**
+     * send the value, wait when the channel is full.
+     * @return ERROR_CHANNEL_CLOSED, ERROR_CHANNEL_TIMEOUT or ERROR_CHANNEL_INTERRUPTED.
+     */
+    int send(T v, st_utime_t timeout = ST_UTIME_NO_TIMEOUT) {
+        int ret = COCO_SUCCESS;
+
+        st_utime_t deadline = deadline_of(timeout);
+        while (!closed_ && full()) {
+            if ((ret = wait(not_full_, deadline)) != COCO_SUCCESS) {
+                return ret;
+            }
+        }
+        if (closed_) {
+            return ERROR_CHANNEL_CLOSED;
+        }
+
+        push(v);
+        return ret;
+    }
+    // send the value without wait, ERROR_CHANNEL_FULL when the channel is full.
+    int try_send(T v) {
+        if (closed_) {
+            return ERROR_CHANNEL_CLOSED;
+        }
+        if (full()) {
+            return ERROR_CHANNEL_FULL;
+        }
+
+        push(v);
+        return COCO_SUCCESS;
+    }
+
+    /**
+     * receive a value, wait when the channel is empty.
+     * @return ERROR_CHANNEL_CLOSED when closed and drained, ERROR_CHANNEL_TIMEOUT or
+     *       ERROR_CHANNEL_INTERRUPTED.
+     */
+    int recv(T &v, st_utime_t timeout = ST_UTIME_NO_TIMEOUT) {
+        int ret = COCO_SUCCESS;
+
+        st_utime_t deadline = deadline_of(timeout);
+        while (queue_.empty()) {
+            if (closed_) {
+                return ERROR_CHANNEL_CLOSED;
+            }
+            if ((ret = wait(not_empty_, deadline)) != COCO_SUCCESS) {
+                return ret;
+            }
+        }
+
+        pop(v);
+        return ret;
+    }
+    // receive a value without wait, ERROR_CHANNEL_EMPTY when the channel is empty.
+    int try_recv(T &v) {
+        if (queue_.empty()) {
+            return closed_ ? ERROR_CHANNEL_CLOSED : ERROR_CHANNEL_EMPTY;
+        }
+
+        pop(v);
+        return COCO_SUCCESS;
+    }
+    /**
+     * receive at most max values in one wakeup, wait when the channel is empty.
+     * @param vs the received values are appended to it.
+     */
+    int recv_many(std::vector<T> &vs, size_t max, st_utime_t timeout = ST_UTIME_NO_TIMEOUT) {
+        int ret = COCO_SUCCESS;
+
+        st_utime_t deadline = deadline_of(timeout);
+        while (queue_.empty()) {
+            if (closed_) {
+                return ERROR_CHANNEL_CLOSED;
+            }
+            if ((ret = wait(not_empty_, deadline)) != COCO_SUCCESS) {
+                return ret;
+            }
+        }
+
+        size_t n = queue_.size() < max ? queue_.size() : max;
+        for (size_t i = 0; i < n; i++) {
+            vs.push_back(std::move(queue_.front()));
+            queue_.pop_front();
+        }
+        // there's room for all the waiting senders.
+        if (capacity_) {
+            st_cond_broadcast(not_full_);
+        }
+        return ret;
+    }
+
+    /**
+     * close the channel, the senders fail and the receivers drain the queued values.
+     */
+    void close() {
+        closed_ = true;
+        st_cond_broadcast(not_empty_);
+        st_cond_broadcast(not_full_);
+    }
+
+    bool closed() { return closed_; }
+    size_t size() { return queue_.size(); }
+    size_t capacity() { return capacity_; }
+
+ private:
+    bool full() { return capacity_ && queue_.size() >= capacity_; }
+    void push(T &v) {
+        queue_.push_back(std::move(v));
+        st_cond_signal(not_empty_);
+    }
+    void pop(T &v) {
+        v = std::move(queue_.front());
+        queue_.pop_front();
+        if (capacity_) {
+            st_cond_signal(not_full_);
+        }
+    }
+    st_utime_t deadline_of(st_utime_t timeout) {
+        return timeout == ST_UTIME_NO_TIMEOUT ? ST_UTIME_NO_TIMEOUT : st_utime() + timeout;
+    }
+    int wait(st_cond_t cond, st_utime_t deadline) {
+        st_utime_t timeout = ST_UTIME_NO_TIMEOUT;
+        if (deadline != ST_UTIME_NO_TIMEOUT) {
+            st_utime_t now = st_utime();
+            if (now >= deadline) {
+                return ERROR_CHANNEL_TIMEOUT;
+            }
+            timeout = deadline - now;
+        }
+
+        if (st_cond_timedwait(cond, timeout) != 0) {
+            return errno == ETIME ? ERROR_CHANNEL_TIMEOUT : ERROR_CHANNEL_INTERRUPTED;
+        }
+        return COCO_SUCCESS;
+    }
+
+ private:
+    size_t capacity_;
+    bool closed_;
+    std::deque<T> queue_;
+    st_cond_t not_empty_;
+    st_cond_t not_full_;
+};
@@ -0,0 +1,100 @@
+#include "base/coco_clock.hpp"
+
+#include <stdio.h>
+#include <string.h>
+
+// the coarse clocks of linux are read by vdso, with the resolution of jiffy.
+#ifdef CLOCK_MONOTONIC_COARSE
+#define COCO_CLOCK_MONOTONIC CLOCK_MONOTONIC_COARSE
+#define COCO_CLOCK_REALTIME CLOCK_REALTIME_COARSE
+#else
+#define COCO_CLOCK_MONOTONIC CLOCK_MONOTONIC
+#define COCO_CLOCK_REALTIME CLOCK_REALTIME
+#endif
+
+static const char *_coco_week_days[] = {"Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat"};
+static const char *_coco_months[] = {"Jan", "Feb", "Mar", "Apr", "May", "Jun",
+                                     "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"};
+
+thread_local CocoClock *_coco_clock = nullptr;
+
+CocoClock::CocoClock() {
+    mono_us_ = wall_us_ = 0;
+    sec_ = -1;
+    memset(log_time_, 0, sizeof(log_time_));
+    log_time_len_ = 0;
+    memset(http_date_, 0, sizeof(http_date_));
+}
+
+CocoClock::~CocoClock() {}
+
+CocoClock *CocoClock::Instance() {
+    if (_coco_clock == nullptr) {
+        _coco_clock = new CocoClock();
+    }
+    return _coco_clock;
+}
+
+int64_t CocoClock::MonoUs() {
+    refresh();
+    return mono_us_;
+}
+
+int64_t CocoClock::WallUs() {
+    refresh();
+    return wall_us_;
+}
+
+const char *CocoClock::LogTime() {
+    refresh();
+    return log_time_;
+}
+
+const char *CocoClock::HttpDate() {
+    refresh();
+    return http_date_;
+}
+
+void CocoClock::refresh() {
+    timespec ts;
+    clock_gettime(COCO_CLOCK_MONOTONIC, &ts);
+    int64_t mono_us = (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+    if (mono_us == mono_us_) {
+        return;
+    }
+    mono_us_ = mono_us;
+
+    clock_gettime(COCO_CLOCK_REALTIME, &ts);
+    wall_us_ = (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+
+    // localtime_r takes the lock of timezone, so only once a second.
+    if (ts.tv_sec != sec_) {
+        sec_ = ts.tv_sec;
+
+        struct tm local;
+        if (localtime_r(&sec_, &local) != NULL) {
+            int n = snprintf(log_time_, sizeof(log_time_), "%d-%02d-%02d %02d:%02d:%02d.000000",
+                             1900 + local.tm_year, 1 + local.tm_mon, local.tm_mday, local.tm_hour,
+                             local.tm_min, local.tm_sec);
+            log_time_len_ = n < 0 ? 0 : (int)strlen(log_time_);
+        }
+
+        struct tm gmt;
+        if (gmtime_r(&sec_, &gmt) != NULL) {
+            snprintf(http_date_, sizeof(http_date_), "%s, %02d %s %d %02d:%02d:%02d GMT",
+                     _coco_week_days[gmt.tm_wday], gmt.tm_mday, _coco_months[gmt.tm_mon],
+                     1900 + gmt.tm_year, gmt.tm_hour, gmt.tm_min, gmt.tm_sec);
+        }
+    }
+
+    // the fraction is the last 6 digits of log time.
+    if (log_time_len_ < 6) {
+        return;
+    }
+    int usec = (int)(ts.tv_nsec / 1000);
+    char *p = log_time_ + log_time_len_;
+    for (int i = 0; i < 6; i++) {
+        *--p = (char)('0' + usec % 10);
+        usec /= 10;
+    }
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <stdint.h>
+#include <time.h>
+
+// the length of "2006-01-02 15:04:05.000000".
+#define COCO_CLOCK_LOG_TIME_SIZE 26
+// the length of "Mon, 02 Jan 2006 15:04:05 GMT".
+#define COCO_CLOCK_HTTP_DATE_SIZE 29
+// the buffer of the formatted strings, for the worst case that each %d field is 11 bytes.
+#define COCO_CLOCK_FORMAT_BUFFER_SIZE 96
+
+/**
+ * the cached clock, for the hot paths which need "now" but not the exact one, for
+ * example the log lines, the Date header of http and the ttl of caches.
+ * the time is read from the coarse clock, which is served by vdso without syscall and
+ * ticks every millisecond or so, and the cached time is refreshed when it ticks, and the
+ * strings are formatted once a second, only the fraction is updated in each tick.
+ * @remark the clock belongs to current thread, so never share the strings between threads.
+ */
+class CocoClock {
+ public:
+    CocoClock();
+    virtual ~CocoClock();
+
+    // the clock of current thread.
+    static CocoClock *Instance();
+
+ public:
+    // the monotonic time in us, never goes back, for the timeouts and ttls.
+    int64_t MonoUs();
+    int64_t MonoMs() { return MonoUs() / 1000; }
+    // the wall time since epoch in us.
+    int64_t WallUs();
+    // the local time for log, for example "2006-01-02 15:04:05.000000".
+    const char *LogTime();
+    // the IMF-fixdate of RFC 7231, for example "Mon, 02 Jan 2006 15:04:05 GMT".
+    const char *HttpDate();
+
+ private:
+    // refresh when the coarse clock ticks.
+    void refresh();
+
+ private:
+    int64_t mono_us_;
+    int64_t wall_us_;
+    // the second of the formatted strings.
+    time_t sec_;
+    char log_time_[COCO_CLOCK_FORMAT_BUFFER_SIZE];
+    // the length of log time, the fraction is the last 6 digits.
+    int log_time_len_;
+    char http_date_[COCO_CLOCK_FORMAT_BUFFER_SIZE];
+};
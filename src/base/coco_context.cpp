@@ -0,0 +1,209 @@
+#include "base/coco_context.hpp"
+
+#include <errno.h>
+
+#include <algorithm>
+
+#include "base/coroutine_local.hpp"
+#include "coco_api.h"
+#include "common/error.hpp"
+#include "log/log.hpp"
+
+CocoContext::CocoContext(CocoContext *parent, int64_t timeout_us) {
+    refs_ = 1;
+    err_ = COCO_SUCCESS;
+    deadline_ = 0;
+    timer_ = 0;
+    parent_ = parent;
+
+    st_utime_t now = st_utime();
+    st_utime_t deadline = timeout_us < 0 ? 0 : now + (st_utime_t)timeout_us;
+
+    if (parent_) {
+        parent_->AddRef();
+        parent_->children_.push_back(this);
+        err_ = parent_->err_;
+
+        // the parent is cancelled at its deadline, which cancels us.
+        if (parent_->deadline_ && (!deadline || parent_->deadline_ <= deadline)) {
+            deadline_ = parent_->deadline_;
+            return;
+        }
+    }
+
+    deadline_ = deadline;
+    if (deadline_ && err_ == COCO_SUCCESS) {
+        // interrupt the coroutines blocked out of the socket io, for example dns and channels.
+        timer_ = CocoAfter((deadline_ - now + 999) / 1000,
+                           [this]() { cancel(ERROR_CONTEXT_DEADLINE); });
+    }
+}
+
+CocoContext::~CocoContext() {
+    if (timer_) {
+        CocoCancel(timer_);
+    }
+
+    // the children hold a ref of us, so there's no child now.
+    if (parent_) {
+        auto it = std::find(parent_->children_.begin(), parent_->children_.end(), this);
+        if (it != parent_->children_.end()) {
+            parent_->children_.erase(it);
+        }
+        parent_->Release();
+    }
+}
+
+CocoContext *CocoContext::Current() {
+    CoroutineLocalData *data = CoroutineLocalGet();
+    return data ? data->ctx : nullptr;
+}
+
+void CocoContext::Switch(CocoContext *ctx) {
+    CoroutineLocalData *data = CoroutineLocalGet();
+    if (!data || data->ctx == ctx) {
+        return;
+    }
+
+    // unbind first, which may consume the pending interrupt of the old one.
+    st_thread_t self = st_thread_self();
+    if (data->ctx) {
+        data->ctx->unbind(self);
+        data->ctx->Release();
+    }
+
+    data->ctx = ctx;
+    if (ctx) {
+        ctx->AddRef();
+        ctx->bind(self);
+    }
+}
+
+void CocoContext::Release() {
+    if (--refs_ == 0) {
+        delete this;
+    }
+}
+
+void CocoContext::Cancel() { cancel(ERROR_CONTEXT_CANCELED); }
+
+int CocoContext::Err() {
+    if (err_ != COCO_SUCCESS) {
+        return err_;
+    }
+    if (deadline_ && st_utime() >= deadline_) {
+        return ERROR_CONTEXT_DEADLINE;
+    }
+    return COCO_SUCCESS;
+}
+
+int CocoContext::IoTimeout(int64_t timeout_us, int64_t *pv) {
+    int ret = COCO_SUCCESS;
+
+    *pv = timeout_us;
+
+    CocoContext *ctx = Current();
+    if (!ctx) {
+        return ret;
+    }
+
+    if ((ret = ctx->Err()) != COCO_SUCCESS) {
+        return ret;
+    }
+
+    if (ctx->deadline_) {
+        int64_t remain = (int64_t)(ctx->deadline_ - st_utime());
+        if (timeout_us < 0 || remain < timeout_us) {
+            *pv = remain;
+        }
+    }
+    return ret;
+}
+
+int CocoContext::IoError(int ret) {
+    if (errno != ETIME && errno != EINTR) {
+        return ret;
+    }
+
+    CocoContext *ctx = Current();
+    int err = ctx ? ctx->Err() : COCO_SUCCESS;
+    return err != COCO_SUCCESS ? err : ret;
+}
+
+void CocoContext::cancel(int err) {
+    if (err_ != COCO_SUCCESS) {
+        return;
+    }
+    err_ = err;
+
+    if (timer_) {
+        CocoCancel(timer_);
+        timer_ = 0;
+    }
+
+    // never yield here, so the lists are never changed.
+    for (auto child : children_) {
+        child->cancel(err);
+    }
+
+    // the current coroutine fails by Err() in the next io, never interrupt itself.
+    st_thread_t self = st_thread_self();
+    for (auto &b : bindings_) {
+        if (b.trd != self && !b.interrupted) {
+            b.interrupted = true;
+            st_thread_interrupt(b.trd);
+        }
+    }
+}
+
+void CocoContext::bind(st_thread_t trd) {
+    Binding b;
+    b.trd = trd;
+    b.interrupted = false;
+    bindings_.push_back(b);
+}
+
+void CocoContext::unbind(st_thread_t trd) {
+    for (auto it = bindings_.begin(); it != bindings_.end(); ++it) {
+        if (it->trd != trd) {
+            continue;
+        }
+
+        bool interrupted = it->interrupted;
+        bindings_.erase(it);
+
+        // the interrupt is pending when not blocked after cancel, consume it, for st
+        // clears the interrupt in the next blocking call.
+        if (interrupted && trd == st_thread_self()) {
+            st_usleep(0);
+        }
+        return;
+    }
+}
+
+CocoContextScope::CocoContextScope(int64_t timeout_us) {
+    prev_ = CocoContext::Current();
+    if (prev_) {
+        prev_->AddRef();
+    }
+
+    ctx_ = new CocoContext(prev_, timeout_us);
+    CocoContext::Switch(ctx_);
+}
+
+CocoContextScope::~CocoContextScope() {
+    CocoContext::Switch(prev_);
+
+    // the caller gives up, stop the tasks started in the scope.
+    ctx_->Cancel();
+    ctx_->Release();
+
+    if (prev_) {
+        prev_->Release();
+    }
+}
+
+int CocoWithTimeout(int64_t timeout_us, std::function<int()> fn) {
+    CocoContextScope scope(timeout_us);
+    return fn();
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "st.h"
+
+/**
+ * the deadline and cancellation of a request, shared by the coroutines working for it.
+ * the context is bound to the current coroutine, so all socket io of the coroutine is
+ * limited by the remaining time, and fails fast when cancelled. the tasks of CocoGo() and
+ * the coroutines of CoCoroutine::set_context() inherit the context, so cancelling it
+ * interrupts all of them, and the child contexts.
+ * Usage:
+ *       CocoContextScope scope(500 * 1000);
+ *       // the dns, connect, handshake and io of client share the 500ms budget.
+ *       ret = client.Get("/api", "", &msg);
+ * @remark the context is refcounted, by the creator and the bound coroutines.
+ * @remark the context belongs to the st scheduler of current thread, never pass it to
+ *       the offload threads.
+ */
+class CocoContext {
+ public:
+    /**
+     * create a context, with one ref owned by the caller.
+     * @param parent the parent context, cancelled with it, nullptr for root.
+     * @param timeout_us the deadline after now, ST_UTIME_NO_TIMEOUT for parent's.
+     */
+    CocoContext(CocoContext *parent, int64_t timeout_us);
+
+    // the context of current coroutine, nullptr for none.
+    static CocoContext *Current();
+    // bind ctx to current coroutine, nullptr to unbind.
+    static void Switch(CocoContext *ctx);
+
+ public:
+    void AddRef() { refs_++; }
+    // free the context when no refs.
+    void Release();
+
+    // cancel the context and its children, interrupt the bound coroutines.
+    void Cancel();
+    /**
+     * the state of context.
+     * @return ERROR_CONTEXT_CANCELED or ERROR_CONTEXT_DEADLINE when done, or COCO_SUCCESS.
+     */
+    int Err();
+    // the deadline in st_utime, 0 for none.
+    st_utime_t Deadline() { return deadline_; }
+
+ public:
+    /**
+     * the timeout of socket io of current coroutine, clipped by the deadline.
+     * @return the error of context when done, never do the io.
+     */
+    static int IoTimeout(int64_t timeout_us, int64_t *pv);
+    // the error of the failed socket io, the error of context when timeout or interrupted by it.
+    static int IoError(int ret);
+
+ private:
+    virtual ~CocoContext();
+
+    void cancel(int err);
+    void bind(st_thread_t trd);
+    void unbind(st_thread_t trd);
+
+ private:
+    struct Binding {
+        st_thread_t trd;
+        // interrupted by cancel, which may be pending when unbound.
+        bool interrupted;
+    };
+
+    int refs_;
+    int err_;
+    st_utime_t deadline_;
+    // the timer to cancel at deadline, 0 for none.
+    uint64_t timer_;
+    CocoContext *parent_;
+    std::vector<CocoContext *> children_;
+    std::vector<Binding> bindings_;
+};
+
+/**
+ * run the scope of current coroutine in a child context of the current one.
+ * the context is cancelled when leaving the scope, so the tasks started in the scope stop,
+ * and the previous context is restored.
+ */
+class CocoContextScope {
+ public:
+    CocoContextScope(int64_t timeout_us = ST_UTIME_NO_TIMEOUT);
+    virtual ~CocoContextScope();
+
+    CocoContext *Context() { return ctx_; }
+
+ private:
+    CocoContext *prev_;
+    CocoContext *ctx_;
+};
@@ -0,0 +1,255 @@
+#include "base/coco_lifecycle.hpp"
+
+#include <fcntl.h>
+#include <signal.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/signalfd.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+
+#include "base/coroutine.hpp"
+#include "coco_api.h"
+#include "log/log.hpp"
+#include "utils/utils.hpp"
+
+// the deadline of shutdown in st_utime, 0 when running, shared by all schedulers.
+static std::atomic<st_utime_t> _coco_shutdown_deadline(0);
+// only one scheduler handles the signals.
+static std::atomic<bool> _coco_signal_owned(false);
+
+#ifndef __linux__
+// the self-pipe written by the signal handler.
+static int _coco_signal_pipe[2] = {-1, -1};
+
+static void coco_signal_handler(int signo) {
+    int err = errno;
+    char v = (char)signo;
+    if (::write(_coco_signal_pipe[1], &v, 1) < 0) {
+        // the pipe is full, the pending signals are enough.
+    }
+    errno = err;
+}
+#endif
+
+// the coroutine to read the shutdown signals.
+class SignalRoutine : public CoroutineHandler {
+ public:
+    SignalRoutine() {
+        fd_ = -1;
+        stfd_ = nullptr;
+        coroutine = new CoCoroutine("signal", this);
+    }
+    virtual ~SignalRoutine() {
+        coco_freep(coroutine);
+        if (stfd_) {
+            st_netfd_close(stfd_);
+        }
+    }
+
+    int Start() {
+        int ret = COCO_SUCCESS;
+
+#ifdef __linux__
+        // block the signals, which are read by signalfd.
+        sigset_t mask;
+        sigemptyset(&mask);
+        sigaddset(&mask, SIGTERM);
+        sigaddset(&mask, SIGINT);
+        pthread_sigmask(SIG_BLOCK, &mask, NULL);
+
+        if ((fd_ = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC)) < 0) {
+            ret = ERROR_SHUTDOWN_SIGNAL;
+            coco_error("create signalfd failed. ret=%d", ret);
+            return ret;
+        }
+#else
+        if (pipe(_coco_signal_pipe) < 0) {
+            ret = ERROR_SHUTDOWN_SIGNAL;
+            coco_error("create signal pipe failed. ret=%d", ret);
+            return ret;
+        }
+        fcntl(_coco_signal_pipe[1], F_SETFL, fcntl(_coco_signal_pipe[1], F_GETFL) | O_NONBLOCK);
+        fd_ = _coco_signal_pipe[0];
+
+        struct sigaction sa;
+        memset(&sa, 0, sizeof(sa));
+        sa.sa_handler = coco_signal_handler;
+        sigemptyset(&sa.sa_mask);
+        sigaction(SIGTERM, &sa, NULL);
+        sigaction(SIGINT, &sa, NULL);
+#endif
+
+        if ((stfd_ = st_netfd_open(fd_)) == NULL) {
+            ret = ERROR_SHUTDOWN_SIGNAL;
+            coco_error("open signal fd %d failed. ret=%d", fd_, ret);
+            ::close(fd_);
+            return ret;
+        }
+
+        return coroutine->start();
+    }
+
+    virtual int Cycle() {
+        while (!ShouldTermCycle()) {
+            int signo = 0;
+#ifdef __linux__
+            signalfd_siginfo info;
+            if (st_read(stfd_, &info, sizeof(info), ST_UTIME_NO_TIMEOUT) != sizeof(info)) {
+                if (errno == EINTR) {
+                    break;
+                }
+                continue;
+            }
+            signo = (int)info.ssi_signo;
+#else
+            char v;
+            if (st_read(stfd_, &v, 1, ST_UTIME_NO_TIMEOUT) != 1) {
+                if (errno == EINTR) {
+                    break;
+                }
+                continue;
+            }
+            signo = v;
+#endif
+
+            // the second signal, never wait.
+            if (CocoIsDraining()) {
+                coco_warn("got signal %d again, shutdown now", signo);
+                CocoShutdown(0);
+                continue;
+            }
+            coco_trace("got signal %d, shutdown in %dms", signo, COCO_SHUTDOWN_TIMEOUT_MS);
+            CocoShutdown(COCO_SHUTDOWN_TIMEOUT_MS);
+        }
+        return COCO_SUCCESS;
+    }
+
+ private:
+    int fd_;
+    st_netfd_t stfd_;
+};
+
+thread_local CocoLifecycle *_coco_lifecycle = nullptr;
+
+CocoLifecycle::CocoLifecycle() { signal_ = nullptr; }
+
+CocoLifecycle::~CocoLifecycle() { coco_freep(signal_); }
+
+CocoLifecycle *CocoLifecycle::Instance() {
+    if (_coco_lifecycle == nullptr) {
+        _coco_lifecycle = new CocoLifecycle();
+    }
+    return _coco_lifecycle;
+}
+
+void CocoLifecycle::AddListener(ListenRoutine *l) { listeners_.push_back(l); }
+
+void CocoLifecycle::RemoveListener(ListenRoutine *l) {
+    auto it = std::find(listeners_.begin(), listeners_.end(), l);
+    if (it != listeners_.end()) {
+        listeners_.erase(it);
+    }
+}
+
+void CocoLifecycle::AddManager(ConnManager *m) { managers_.push_back(m); }
+
+void CocoLifecycle::RemoveManager(ConnManager *m) {
+    auto it = std::find(managers_.begin(), managers_.end(), m);
+    if (it != managers_.end()) {
+        managers_.erase(it);
+    }
+}
+
+int CocoLifecycle::Run() {
+    // the first scheduler handles the signals.
+    bool owned = false;
+    if (_coco_signal_owned.compare_exchange_strong(owned, true)) {
+        signal_ = new SignalRoutine();
+        if (signal_->Start() != COCO_SUCCESS) {
+            coco_warn("handle shutdown signals failed, ignore");
+        }
+    }
+
+    while (!CocoIsDraining()) {
+        st_usleep(COCO_RUN_TICK_US);
+    }
+
+    return drain();
+}
+
+int CocoLifecycle::drain() {
+    int ret = COCO_SUCCESS;
+
+    // stop accepting, copy for the listener may unregister itself.
+    std::vector<ListenRoutine *> listeners = listeners_;
+    coco_trace("shutdown, stop %d listeners, conns=%d", (int)listeners.size(), conns());
+    for (auto l : listeners) {
+        l->Stop();
+    }
+
+    // let the connections finish the current request.
+    for (auto m : managers_) {
+        m->ForEach([](ConnRoutine *conn) { conn->Drain(); });
+    }
+
+    st_utime_t deadline = _coco_shutdown_deadline;
+    st_utime_t reported = st_utime();
+    while (conns() > 0) {
+        st_utime_t now = st_utime();
+        if (now >= deadline) {
+            break;
+        }
+        if (now - reported >= COCO_DRAIN_REPORT_US) {
+            coco_trace("draining, conns=%d, remain=%dms", conns(), (int)((deadline - now) / 1000));
+            reported = now;
+        }
+        st_usleep(coco_min(COCO_RUN_TICK_US, deadline - now));
+    }
+
+    // the deadline is reached, interrupt the stragglers.
+    if (conns() > 0) {
+        coco_warn("drain timeout, interrupt %d conns", conns());
+        for (auto m : managers_) {
+            m->ForEach([](ConnRoutine *conn) { conn->Interrupt(); });
+        }
+
+        st_utime_t force_deadline = st_utime() + COCO_DRAIN_FORCE_US;
+        while (conns() > 0 && st_utime() < force_deadline) {
+            st_usleep(COCO_RUN_TICK_US / 10);
+        }
+    }
+
+    if (conns() > 0) {
+        ret = ERROR_SHUTDOWN_TIMEOUT;
+        coco_error("shutdown with %d conns alive. ret=%d", conns(), ret);
+        return ret;
+    }
+
+    coco_trace("shutdown done, all conns drained");
+    return ret;
+}
+
+int CocoLifecycle::conns() {
+    int n = 0;
+    for (auto m : managers_) {
+        n += m->Size();
+    }
+    return n;
+}
+
+int CocoRun() { return CocoLifecycle::Instance()->Run(); }
+
+void CocoShutdown(int64_t timeout_ms) {
+    st_utime_t deadline = st_utime() + (st_utime_t)coco_max(timeout_ms, 0) * 1000;
+    // the deadline is never extended, a later shutdown may shorten it.
+    st_utime_t v = _coco_shutdown_deadline;
+    while ((v == 0 || deadline < v) && !_coco_shutdown_deadline.compare_exchange_weak(v, deadline)) {
+    }
+}
+
+bool CocoIsDraining() { return _coco_shutdown_deadline != 0; }
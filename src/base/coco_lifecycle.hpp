@@ -0,0 +1,56 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <vector>
+
+class ConnManager;
+class ListenRoutine;
+class SignalRoutine;
+
+// the default drain timeout when shutdown by signal.
+#define COCO_SHUTDOWN_TIMEOUT_MS (30 * 1000)
+// the interval to check the shutdown and the drain progress.
+#define COCO_RUN_TICK_US (100 * 1000)
+// the interval to report the drain progress.
+#define COCO_DRAIN_REPORT_US (1000 * 1000)
+// the time to wait for the interrupted connections to exit.
+#define COCO_DRAIN_FORCE_US (1000 * 1000)
+
+/**
+ * the lifecycle of scheduler, see CocoRun() and CocoShutdown().
+ * the listeners and connection managers of scheduler are registered, so the drain
+ * stops the listeners, waits for the connections, and interrupts the stragglers when
+ * the deadline is reached.
+ * the first scheduler in CocoRun() handles SIGTERM and SIGINT, by signalfd on linux,
+ * or a self-pipe written by the signal handler on others.
+ * @remark the lifecycle belongs to the st scheduler of current thread, while the
+ *       shutdown request is shared by all schedulers.
+ */
+class CocoLifecycle {
+ public:
+    CocoLifecycle();
+    virtual ~CocoLifecycle();
+
+    // the lifecycle of current scheduler.
+    static CocoLifecycle *Instance();
+
+ public:
+    void AddListener(ListenRoutine *l);
+    void RemoveListener(ListenRoutine *l);
+    void AddManager(ConnManager *m);
+    void RemoveManager(ConnManager *m);
+
+    // run until shutdown and drained.
+    int Run();
+
+ private:
+    int drain();
+    // the connections of all managers.
+    int conns();
+
+ private:
+    std::vector<ListenRoutine *> listeners_;
+    std::vector<ConnManager *> managers_;
+    SignalRoutine *signal_;
+};
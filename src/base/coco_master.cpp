@@ -0,0 +1,762 @@
+#include "base/coco_master.hpp"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/prctl.h>
+#endif
+
+#include "common/error.hpp"
+#include "log/log.hpp"
+#include "net/layer4/coco_tcp.hpp"
+#include "net/layer4/coco_udp.hpp"
+#include "utils/utils.hpp"
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+// the id of worker process, and the sockets inherited from master by address.
+static int _coco_master_worker_id = -1;
+static std::map<std::string, int> _coco_inherited_fds;
+
+// the self-pipe written by the signal handler of master.
+static int _coco_master_signal_pipe[2] = {-1, -1};
+
+static void coco_master_signal_handler(int signo) {
+    int err = errno;
+    char v = (char)signo;
+    if (::write(_coco_master_signal_pipe[1], &v, 1) < 0) {
+        // the pipe is full, the pending signals are enough.
+    }
+    errno = err;
+}
+
+static int64_t coco_master_now_ms() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static std::string coco_master_key(std::string proto, std::string ip, int port) {
+    return proto + "://" + ip + ":" + std::to_string(port);
+}
+
+// the record of upgrade, each carries a socket by SCM_RIGHTS, and the last carries none.
+struct CocoUpgradeRecord {
+    char key[128];
+    int32_t last;
+};
+
+static int coco_upgrade_send(int fd, std::string key, int sfd) {
+    CocoUpgradeRecord rec;
+    memset(&rec, 0, sizeof(rec));
+    snprintf(rec.key, sizeof(rec.key), "%s", key.c_str());
+    rec.last = sfd < 0;
+
+    iovec iov;
+    iov.iov_base = &rec;
+    iov.iov_len = sizeof(rec);
+
+    msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+
+    char control[CMSG_SPACE(sizeof(int))];
+    if (sfd >= 0) {
+        memset(control, 0, sizeof(control));
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+
+        cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+        memcpy(CMSG_DATA(cmsg), &sfd, sizeof(int));
+    }
+
+    if (sendmsg(fd, &msg, MSG_NOSIGNAL) != (ssize_t)sizeof(rec)) {
+        return ERROR_MASTER_UPGRADE;
+    }
+    return COCO_SUCCESS;
+}
+
+static int coco_upgrade_recv(int fd, CocoUpgradeRecord *rec, int *psfd) {
+    iovec iov;
+    iov.iov_base = rec;
+    iov.iov_len = sizeof(*rec);
+
+    char control[CMSG_SPACE(sizeof(int))];
+    msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    *psfd = -1;
+    if (recvmsg(fd, &msg, MSG_WAITALL) != (ssize_t)sizeof(*rec)) {
+        return ERROR_MASTER_UPGRADE;
+    }
+
+    cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    if (cmsg && cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+        memcpy(psfd, CMSG_DATA(cmsg), sizeof(int));
+    }
+    rec->key[sizeof(rec->key) - 1] = 0;
+
+    if (!rec->last && *psfd < 0) {
+        return ERROR_MASTER_UPGRADE;
+    }
+    return COCO_SUCCESS;
+}
+
+static int coco_upgrade_addr(std::string path, sockaddr_un *addr) {
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    if (path.length() >= sizeof(addr->sun_path)) {
+        return ERROR_MASTER_UPGRADE;
+    }
+    memcpy(addr->sun_path, path.c_str(), path.length());
+    return COCO_SUCCESS;
+}
+
+// whether the path is left by a dead master, nobody accepts on it.
+static bool coco_upgrade_stale(const sockaddr_un *addr) {
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return false;
+    }
+    bool stale = connect(fd, (const sockaddr *)addr, sizeof(*addr)) < 0 && errno == ECONNREFUSED;
+    ::close(fd);
+    return stale;
+}
+
+CocoMaster::CocoMaster(int nb_workers) {
+    if (nb_workers <= 0) {
+        nb_workers = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    nb_workers_ = coco_max(nb_workers, 1);
+
+#ifdef __linux__
+    reuse_port_ = true;
+#else
+    // only linux balances the connections between the sockets of SO_REUSEPORT.
+    reuse_port_ = false;
+#endif
+    io_backend_ = CocoIoEpoll;
+
+    upgrade_fd_ = old_master_fd_ = new_master_fd_ = -1;
+    handoff_deadline_ = 0;
+    upgrade_retry_ms_ = 0;
+    stopping_ = false;
+}
+
+CocoMaster::~CocoMaster() { cleanup(); }
+
+int CocoMaster::SetUpgradePath(std::string path) {
+    int ret = COCO_SUCCESS;
+
+    upgrade_path_ = path;
+    if ((ret = takeover()) != COCO_SUCCESS) {
+        return ret;
+    }
+    return serve_upgrade();
+}
+
+int CocoMaster::ListenTcp(std::string local_ip, int local_port) {
+    return listen("tcp", local_ip, local_port);
+}
+
+int CocoMaster::ListenUdp(std::string local_ip, int local_port) {
+    return listen("udp", local_ip, local_port);
+}
+
+int CocoMaster::listen(std::string proto, std::string local_ip, int local_port) {
+    int ret = COCO_SUCCESS;
+
+    Listener l;
+    l.proto = proto;
+    l.ip = local_ip;
+    l.port = local_port;
+
+    // reuse the sockets of old master, so its accept queues are never dropped.
+    auto it = taken_.find(coco_master_key(proto, local_ip, local_port));
+    if (it != taken_.end()) {
+        l.fds = it->second;
+        taken_.erase(it);
+    }
+
+    int n = reuse_port_ ? nb_workers_ : 1;
+    while ((int)l.fds.size() < n) {
+        int fd = -1;
+        if (proto == "tcp") {
+            ret = ListenTcpFd(local_ip, local_port, reuse_port_, &fd);
+        } else {
+            ret = ListenUdpFd(local_ip, local_port, reuse_port_, &fd);
+        }
+        if (ret != COCO_SUCCESS) {
+            coco_error("master listen %s://%s:%d failed. ret=%d", proto.c_str(), local_ip.c_str(),
+                       local_port, ret);
+            for (auto fd : l.fds) {
+                ::close(fd);
+            }
+            return ret;
+        }
+        l.fds.push_back(fd);
+    }
+
+    coco_trace("master listen %s://%s:%d, sockets=%d", proto.c_str(), local_ip.c_str(), local_port,
+               (int)l.fds.size());
+    listeners_.push_back(l);
+    return ret;
+}
+
+int CocoMaster::takeover() {
+    int ret = COCO_SUCCESS;
+
+    sockaddr_un addr;
+    if ((ret = coco_upgrade_addr(upgrade_path_, &addr)) != COCO_SUCCESS) {
+        coco_error("upgrade path %s too long. ret=%d", upgrade_path_.c_str(), ret);
+        return ret;
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        ret = ERROR_MASTER_UPGRADE;
+        coco_error("create upgrade socket failed. ret=%d", ret);
+        return ret;
+    }
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+    if (connect(fd, (sockaddr *)&addr, sizeof(addr)) < 0) {
+        int err = errno;
+        ::close(fd);
+
+        // no old master, and remove the path left by the crashed one.
+        if (err == ENOENT || err == ECONNREFUSED) {
+            if (err == ECONNREFUSED) {
+                unlink(upgrade_path_.c_str());
+            }
+            return ret;
+        }
+
+        ret = ERROR_MASTER_UPGRADE;
+        coco_error("connect old master %s failed, errno=%d. ret=%d", upgrade_path_.c_str(), err,
+                   ret);
+        return ret;
+    }
+
+    // never hang when the old master is stuck.
+    timeval tv;
+    tv.tv_sec = COCO_UPGRADE_TIMEOUT_MS / 1000;
+    tv.tv_usec = 0;
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    int n = 0;
+    while (true) {
+        CocoUpgradeRecord rec;
+        int sfd = -1;
+        if ((ret = coco_upgrade_recv(fd, &rec, &sfd)) != COCO_SUCCESS) {
+            coco_error("receive sockets from old master failed. ret=%d", ret);
+            break;
+        }
+        if (rec.last) {
+            break;
+        }
+
+        fcntl(sfd, F_SETFD, FD_CLOEXEC);
+        taken_[rec.key].push_back(sfd);
+        n++;
+    }
+
+    // the old master keeps serving when we quit before ready.
+    if (ret != COCO_SUCCESS) {
+        for (auto &it : taken_) {
+            for (auto sfd : it.second) {
+                ::close(sfd);
+            }
+        }
+        taken_.clear();
+        ::close(fd);
+        return ret;
+    }
+
+    old_master_fd_ = fd;
+    coco_trace("take over %d sockets from old master %s", n, upgrade_path_.c_str());
+    return ret;
+}
+
+int CocoMaster::serve_upgrade() {
+    int ret = COCO_SUCCESS;
+
+    sockaddr_un addr;
+    if ((ret = coco_upgrade_addr(upgrade_path_, &addr)) != COCO_SUCCESS) {
+        return ret;
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        ret = ERROR_MASTER_UPGRADE;
+        coco_error("create upgrade socket failed. ret=%d", ret);
+        return ret;
+    }
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+    // the old master removes the path before passing the sockets, and the path left by the
+    // crashed new master is removed, which is never accepted.
+    int r = bind(fd, (sockaddr *)&addr, sizeof(addr));
+    if (r < 0 && errno == EADDRINUSE && coco_upgrade_stale(&addr)) {
+        coco_warn("remove stale upgrade path %s", upgrade_path_.c_str());
+        unlink(upgrade_path_.c_str());
+        r = bind(fd, (sockaddr *)&addr, sizeof(addr));
+    }
+    if (r < 0 || ::listen(fd, 1) < 0) {
+        ret = ERROR_MASTER_UPGRADE;
+        coco_error("serve upgrade path %s failed, errno=%d. ret=%d", upgrade_path_.c_str(), errno,
+                   ret);
+        ::close(fd);
+        return ret;
+    }
+
+    upgrade_fd_ = fd;
+    return ret;
+}
+
+void CocoMaster::handoff() {
+    int fd = accept(upgrade_fd_, NULL, NULL);
+    if (fd < 0) {
+        return;
+    }
+
+    // one upgrade at a time, and never when stopping.
+    if (new_master_fd_ >= 0 || stopping_) {
+        ::close(fd);
+        return;
+    }
+
+    // the new master serves the path from now on.
+    ::close(upgrade_fd_);
+    upgrade_fd_ = -1;
+    unlink(upgrade_path_.c_str());
+
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_NONBLOCK);
+
+    int ret = COCO_SUCCESS;
+    int n = 0;
+    for (auto &l : listeners_) {
+        std::string key = coco_master_key(l.proto, l.ip, l.port);
+        for (auto sfd : l.fds) {
+            if ((ret = coco_upgrade_send(fd, key, sfd)) != COCO_SUCCESS) {
+                break;
+            }
+            n++;
+        }
+        if (ret != COCO_SUCCESS) {
+            break;
+        }
+    }
+    if (ret == COCO_SUCCESS) {
+        ret = coco_upgrade_send(fd, "", -1);
+    }
+
+    if (ret != COCO_SUCCESS) {
+        coco_error("pass sockets to new master failed. ret=%d", ret);
+        ::close(fd);
+        resume_upgrade();
+        return;
+    }
+
+    new_master_fd_ = fd;
+    handoff_deadline_ = coco_master_now_ms() + COCO_UPGRADE_TIMEOUT_MS;
+    coco_trace("pass %d sockets to new master, wait for it to be ready", n);
+}
+
+void CocoMaster::on_handoff_done() {
+    char v = 0;
+    ssize_t nn = 0;
+    if (coco_master_now_ms() < handoff_deadline_) {
+        nn = ::read(new_master_fd_, &v, 1);
+    }
+    ::close(new_master_fd_);
+    new_master_fd_ = -1;
+
+    if (nn == 1 && v == 'R') {
+        coco_trace("new master is ready, stop workers=%d", (int)workers_.size());
+        stopping_ = true;
+        signal_workers(SIGTERM, false);
+        return;
+    }
+
+    // the new master failed, keep serving, and wait for the next one.
+    coco_warn("new master failed, keep serving");
+    resume_upgrade();
+}
+
+void CocoMaster::resume_upgrade() {
+    int ret = COCO_SUCCESS;
+
+    // the path may be held by the new master which is still alive, until it exits.
+    if ((ret = serve_upgrade()) != COCO_SUCCESS) {
+        upgrade_retry_ms_ = coco_master_now_ms() + COCO_UPGRADE_RETRY_MS;
+        coco_warn("serve upgrade path %s failed, retry in %dms. ret=%d", upgrade_path_.c_str(),
+                  COCO_UPGRADE_RETRY_MS, ret);
+        return;
+    }
+
+    upgrade_retry_ms_ = 0;
+    coco_trace("serve upgrade path %s again", upgrade_path_.c_str());
+}
+
+int CocoMaster::Run(CocoMasterFunc fn) {
+    int ret = COCO_SUCCESS;
+
+    fn_ = fn;
+
+    // the address not served any more, its queue is dropped.
+    for (auto &it : taken_) {
+        coco_warn("close socket %s of old master, not listened", it.first.c_str());
+        for (auto fd : it.second) {
+            ::close(fd);
+        }
+    }
+    taken_.clear();
+
+    // each socket of old master is served by a worker.
+    for (auto &l : listeners_) {
+        if ((int)l.fds.size() > nb_workers_) {
+            coco_warn("%s://%s:%d has %d sockets, workers=%d", l.proto.c_str(), l.ip.c_str(),
+                      l.port, (int)l.fds.size(), nb_workers_);
+            nb_workers_ = (int)l.fds.size();
+        }
+    }
+    for (auto &l : listeners_) {
+        while (reuse_port_ && (int)l.fds.size() < nb_workers_) {
+            int fd = -1;
+            if (l.proto == "tcp") {
+                ret = ListenTcpFd(l.ip, l.port, true, &fd);
+            } else {
+                ret = ListenUdpFd(l.ip, l.port, true, &fd);
+            }
+            if (ret != COCO_SUCCESS) {
+                return ret;
+            }
+            l.fds.push_back(fd);
+        }
+    }
+
+    if (pipe(_coco_master_signal_pipe) < 0) {
+        ret = ERROR_MASTER_SIGNAL;
+        coco_error("create master signal pipe failed. ret=%d", ret);
+        return ret;
+    }
+    for (int i = 0; i < 2; i++) {
+        fcntl(_coco_master_signal_pipe[i], F_SETFD, FD_CLOEXEC);
+        fcntl(_coco_master_signal_pipe[i], F_SETFL,
+              fcntl(_coco_master_signal_pipe[i], F_GETFL) | O_NONBLOCK);
+    }
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = coco_master_signal_handler;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = SA_RESTART;
+    sigaction(SIGTERM, &sa, NULL);
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGHUP, &sa, NULL);
+    sigaction(SIGCHLD, &sa, NULL);
+
+    for (int i = 0; i < nb_workers_; i++) {
+        if ((ret = spawn(i)) != COCO_SUCCESS) {
+            break;
+        }
+    }
+
+    // stop the old master after the workers are started, it keeps serving when we failed.
+    if (old_master_fd_ >= 0) {
+        if (ret == COCO_SUCCESS && send(old_master_fd_, "R", 1, MSG_NOSIGNAL) != 1) {
+            coco_warn("notify old master failed, errno=%d", errno);
+        }
+        ::close(old_master_fd_);
+        old_master_fd_ = -1;
+    }
+
+    if (ret != COCO_SUCCESS) {
+        stopping_ = true;
+        signal_workers(SIGTERM, false);
+    }
+    coco_trace("master started, workers=%d, reuse_port=%d", (int)workers_.size(), reuse_port_);
+
+    while (!stopping_ || !workers_.empty()) {
+        pollfd fds[3];
+        int nfds = 0;
+        fds[nfds].fd = _coco_master_signal_pipe[0];
+        fds[nfds++].events = POLLIN;
+        if (upgrade_fd_ >= 0) {
+            fds[nfds].fd = upgrade_fd_;
+            fds[nfds++].events = POLLIN;
+        }
+        if (new_master_fd_ >= 0) {
+            fds[nfds].fd = new_master_fd_;
+            fds[nfds++].events = POLLIN;
+        }
+
+        if (poll(fds, nfds, COCO_MASTER_TICK_MS) < 0 && errno != EINTR) {
+            coco_error("master poll failed, errno=%d", errno);
+        }
+
+        char signos[16];
+        ssize_t n = 0;
+        while ((n = ::read(_coco_master_signal_pipe[0], signos, sizeof(signos))) > 0) {
+            for (int i = 0; i < n; i++) {
+                int signo = signos[i];
+                if (signo == SIGHUP) {
+                    coco_trace("got signal %d, restart workers", signo);
+                    restart();
+                } else if (signo == SIGTERM || signo == SIGINT) {
+                    // the workers shutdown without waiting by the second signal.
+                    coco_trace("got signal %d, stop workers=%d", signo, (int)workers_.size());
+                    stopping_ = true;
+                    signal_workers(SIGTERM, false);
+                }
+            }
+        }
+        reap();
+
+        for (int i = 1; i < nfds; i++) {
+            if (fds[i].revents == 0) {
+                continue;
+            }
+            if (fds[i].fd == upgrade_fd_) {
+                handoff();
+            } else if (fds[i].fd == new_master_fd_) {
+                on_handoff_done();
+            }
+        }
+        if (new_master_fd_ >= 0 && coco_master_now_ms() >= handoff_deadline_) {
+            on_handoff_done();
+        }
+        if (upgrade_retry_ms_ > 0 && !stopping_ && coco_master_now_ms() >= upgrade_retry_ms_) {
+            resume_upgrade();
+        }
+
+        // respawn the crashed workers, on the same sockets.
+        int64_t now = coco_master_now_ms();
+        for (size_t i = 0; i < workers_.size(); i++) {
+            Worker w = workers_[i];
+            if (w.pid > 0 || (!stopping_ && now < w.start_ms)) {
+                continue;
+            }
+            workers_.erase(workers_.begin() + i--);
+            if (!stopping_ && spawn(w.id) != COCO_SUCCESS) {
+                break;
+            }
+        }
+    }
+
+    cleanup();
+    coco_trace("master stopped. ret=%d", ret);
+    return ret;
+}
+
+int CocoMaster::spawn(int id) {
+    int ret = COCO_SUCCESS;
+
+    Worker w;
+    w.id = id;
+    w.retired = false;
+    w.start_ms = coco_master_now_ms();
+
+    if ((w.pid = fork()) < 0) {
+        ret = ERROR_MASTER_FORK;
+        coco_error("fork worker %d failed, errno=%d. ret=%d", id, errno, ret);
+
+        // retry later.
+        w.start_ms += COCO_MASTER_RESPAWN_MS;
+        workers_.push_back(w);
+        return ret;
+    }
+
+    if (w.pid == 0) {
+        worker_main(id);
+    }
+
+    coco_trace("start worker %d, pid=%d", id, (int)w.pid);
+    workers_.push_back(w);
+    return ret;
+}
+
+void CocoMaster::worker_main(int id) {
+    int ret = COCO_SUCCESS;
+
+    // the signals of worker are handled by CocoRun().
+    signal(SIGTERM, SIG_DFL);
+    signal(SIGINT, SIG_DFL);
+    signal(SIGHUP, SIG_DFL);
+    signal(SIGCHLD, SIG_DFL);
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigprocmask(SIG_SETMASK, &mask, NULL);
+
+#ifdef __linux__
+    // drain when the master is killed.
+    prctl(PR_SET_PDEATHSIG, SIGTERM);
+#endif
+
+    for (int i = 0; i < 2; i++) {
+        ::close(_coco_master_signal_pipe[i]);
+        _coco_master_signal_pipe[i] = -1;
+    }
+    for (int fd : {upgrade_fd_, old_master_fd_, new_master_fd_}) {
+        if (fd >= 0) {
+            ::close(fd);
+        }
+    }
+
+    // keep the socket of this worker, the others are held by master.
+    _coco_master_worker_id = id;
+    cur_pid = (int)getpid();
+    for (auto &l : listeners_) {
+        int index = id % (int)l.fds.size();
+        for (int i = 0; i < (int)l.fds.size(); i++) {
+            if (i == index) {
+                _coco_inherited_fds[coco_master_key(l.proto, l.ip, l.port)] = l.fds[i];
+            } else {
+                ::close(l.fds[i]);
+            }
+        }
+    }
+
+    if ((ret = CocoInit(io_backend_)) != COCO_SUCCESS) {
+        coco_error("worker %d init st failed. ret=%d", id, ret);
+        exit(1);
+    }
+    coco_trace("worker %d started, pid=%d", id, (int)getpid());
+
+    if ((ret = fn_(id)) != COCO_SUCCESS) {
+        coco_error("worker %d run failed. ret=%d", id, ret);
+        exit(1);
+    }
+
+    // keep the scheduler running for the coroutines started by fn, until shutdown.
+    if ((ret = CocoRun()) != COCO_SUCCESS) {
+        coco_warn("worker %d shutdown. ret=%d", id, ret);
+    }
+    exit(ret == COCO_SUCCESS ? 0 : 1);
+}
+
+void CocoMaster::reap() {
+    int status = 0;
+    pid_t pid;
+    while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+        for (auto it = workers_.begin(); it != workers_.end(); ++it) {
+            if (it->pid != pid) {
+                continue;
+            }
+
+            if (stopping_ || it->retired) {
+                coco_trace("worker %d exit, pid=%d, status=%d", it->id, (int)pid, status);
+                workers_.erase(it);
+                break;
+            }
+
+            // respawn later when it crashes right after started.
+            int64_t now = coco_master_now_ms();
+            coco_warn("worker %d crashed, pid=%d, status=%d, respawn", it->id, (int)pid, status);
+            it->pid = -1;
+            it->start_ms = now - it->start_ms < COCO_MASTER_RESPAWN_MS
+                               ? now + COCO_MASTER_RESPAWN_MS
+                               : now;
+            break;
+        }
+    }
+}
+
+void CocoMaster::signal_workers(int signo, bool retired) {
+    for (auto &w : workers_) {
+        if (w.pid > 0 && (!retired || w.retired)) {
+            kill(w.pid, signo);
+        }
+    }
+}
+
+void CocoMaster::restart() {
+    if (stopping_) {
+        return;
+    }
+
+    // the new workers accept on the same sockets, before the old ones stop accepting.
+    std::vector<Worker> olds;
+    for (auto &w : workers_) {
+        if (w.pid > 0) {
+            w.retired = true;
+            olds.push_back(w);
+        }
+    }
+    workers_ = olds;
+
+    for (int i = 0; i < nb_workers_; i++) {
+        spawn(i);
+    }
+    signal_workers(SIGTERM, true);
+}
+
+void CocoMaster::cleanup() {
+    for (auto &l : listeners_) {
+        for (auto fd : l.fds) {
+            ::close(fd);
+        }
+    }
+    listeners_.clear();
+
+    for (auto &it : taken_) {
+        for (auto fd : it.second) {
+            ::close(fd);
+        }
+    }
+    taken_.clear();
+
+    // the path is served by the new master when handed off.
+    if (upgrade_fd_ >= 0) {
+        ::close(upgrade_fd_);
+        unlink(upgrade_path_.c_str());
+        upgrade_fd_ = -1;
+    }
+    for (int *pfd : {&old_master_fd_, &new_master_fd_}) {
+        if (*pfd >= 0) {
+            ::close(*pfd);
+            *pfd = -1;
+        }
+    }
+
+    for (int i = 0; i < 2; i++) {
+        if (_coco_master_signal_pipe[i] >= 0) {
+            ::close(_coco_master_signal_pipe[i]);
+            _coco_master_signal_pipe[i] = -1;
+        }
+    }
+}
+
+int CocoMaster::WorkerId() { return _coco_master_worker_id; }
+
+int CocoMaster::InheritedFd(std::string proto, std::string local_ip, int local_port) {
+    auto it = _coco_inherited_fds.find(coco_master_key(proto, local_ip, local_port));
+    if (it == _coco_inherited_fds.end()) {
+        return -1;
+    }
+
+    // the listener closes its own fd, the inherited one is kept for the next.
+    return fcntl(it->second, F_DUPFD_CLOEXEC, 0);
+}
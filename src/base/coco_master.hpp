@@ -0,0 +1,149 @@
+#pragma once
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "coco_api.h"
+
+// the worker exits within it after started is crashed, respawn it after the interval.
+#define COCO_MASTER_RESPAWN_MS (1000)
+// the interval of master loop, to respawn the crashed workers.
+#define COCO_MASTER_TICK_MS (100)
+// the time for the new master to start its workers, or the old master keeps serving.
+#define COCO_UPGRADE_TIMEOUT_MS (30 * 1000)
+// the interval to serve the upgrade path again, when it is still held after a failed upgrade.
+#define COCO_UPGRADE_RETRY_MS (1000)
+
+// called in each worker process after its scheduler is initialized, with the id of worker.
+typedef std::function<int(int)> CocoMasterFunc;
+
+/**
+ * the pre-fork multi-process mode, for the process can't use threads.
+ * the master listens before forking, so the workers inherit the sockets, and the accept
+ * queues live as long as the master, never dropped when a worker crashes or restarts.
+ * the ListenTcp() and ListenUdp() in the worker return the inherited socket of the address,
+ * so HttpServer::ListenAndServe() just works.
+ * Usage:
+ *       CocoMaster master(4);
+ *       master.SetUpgradePath("/var/run/server.sock");  // take over the old master
+ *       master.ListenTcp("0.0.0.0", 8080);
+ *       return master.Run([&](int id) {
+ *           HttpServer *s = new HttpServer(false);
+ *           s->ListenAndServe("0.0.0.0", 8080, mux);  // the inherited socket
+ *           return s->Start();
+ *       });
+ * signals of master:
+ *       SIGTERM, SIGINT: stop the workers gracefully, see CocoRun(), and exit.
+ *       SIGHUP: rolling restart, start the new workers, then stop the old ones.
+ * hot upgrade: start the new binary with the same upgrade path, the old master passes the
+ *       listen sockets over the unix socket by SCM_RIGHTS, and stops its workers after the
+ *       workers of new master are started, so the sockets and queues are never closed.
+ * @remark the master never runs st, the scheduler is initialized in each worker after fork.
+ */
+class CocoMaster {
+ public:
+    /**
+     * @param nb_workers the number of worker processes, 0 to use the number of online cpus.
+     */
+    CocoMaster(int nb_workers = 0);
+    virtual ~CocoMaster();
+
+    /**
+     * each worker accepts on its own SO_REUSEPORT socket, so the kernel balances the
+     * connections and never wakes all workers, true by default on linux.
+     * @remark when disabled, the workers share one socket, and all are woken by a connection
+     *       while one gets it.
+     */
+    void SetReusePort(bool v) { reuse_port_ = v; }
+    // the io backend of each worker, see CocoInit().
+    void SetIoBackend(CocoIoBackend v) { io_backend_ = v; }
+    /**
+     * take over the listen sockets of the old master serving the path, and serve the path
+     * for the next master, must be called before listening.
+     * @remark the old master is absent when the path is not found or refused.
+     */
+    int SetUpgradePath(std::string path);
+
+    // listen in master, reuse the socket taken over from the old master when matched.
+    int ListenTcp(std::string local_ip, int local_port);
+    int ListenUdp(std::string local_ip, int local_port);
+
+    /**
+     * fork the workers, each calls CocoInit() and fn, then CocoRun() until shutdown.
+     * @return in master when all workers exit, never return in workers.
+     */
+    int Run(CocoMasterFunc fn);
+
+ public:
+    // the id of current worker process, -1 when not forked by master.
+    static int WorkerId();
+    /**
+     * the socket inherited from master of the address, for the ListenTcp() and ListenUdp().
+     * @param proto "tcp" or "udp".
+     * @return a dup of socket owned by the caller, -1 when not found.
+     */
+    static int InheritedFd(std::string proto, std::string local_ip, int local_port);
+
+ private:
+    struct Listener {
+        std::string proto;
+        std::string ip;
+        int port;
+        // one socket per worker when reuse port, or a socket shared by all.
+        std::vector<int> fds;
+    };
+
+    struct Worker {
+        int id;
+        pid_t pid;
+        int64_t start_ms;
+        // the worker is stopping by rolling restart, never respawn it.
+        bool retired;
+    };
+
+    int listen(std::string proto, std::string local_ip, int local_port);
+    int takeover();
+    int serve_upgrade();
+    // serve the upgrade path again after a failed upgrade, retry on the tick when failed.
+    void resume_upgrade();
+    // pass the listen sockets to the new master.
+    void handoff();
+    // the new master is ready or failed.
+    void on_handoff_done();
+
+    int spawn(int id);
+    void worker_main(int id);
+    void reap();
+    void signal_workers(int signo, bool retired);
+    void restart();
+    void cleanup();
+
+ private:
+    int nb_workers_;
+    bool reuse_port_;
+    CocoIoBackend io_backend_;
+    CocoMasterFunc fn_;
+
+    std::vector<Listener> listeners_;
+    // the sockets of old master by address, claimed by ListenTcp() and ListenUdp().
+    std::map<std::string, std::vector<int>> taken_;
+    std::vector<Worker> workers_;
+
+    std::string upgrade_path_;
+    // the unix socket to serve the next master.
+    int upgrade_fd_;
+    // the connection to the old master, to notify it when ready.
+    int old_master_fd_;
+    // the connection to the new master, waiting for it to be ready.
+    int new_master_fd_;
+    int64_t handoff_deadline_;
+    // the time to serve the upgrade path again, 0 when served or not needed.
+    int64_t upgrade_retry_ms_;
+
+    bool stopping_;
+};
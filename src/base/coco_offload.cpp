@@ -0,0 +1,312 @@
+#include "base/coco_offload.hpp"
+
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/eventfd.h>
+#endif
+
+#include "base/coroutine.hpp"
+#include "coco_api.h"
+#include "log/log.hpp"
+#include "utils/utils.hpp"
+
+static int _offload_nb_threads = 0;
+static OffloadPool *_offload_pool = nullptr;
+static std::mutex _offload_pool_mu;
+
+struct OffloadThreadArg {
+    OffloadPool *pool;
+    int index;
+};
+
+OffloadPool::OffloadPool(int nb_threads) : next_(0), pending_(0) {
+    stop_ = false;
+
+    for (int i = 0; i < nb_threads; i++) {
+        queues_.push_back(new Queue());
+    }
+    for (int i = 0; i < nb_threads; i++) {
+        pthread_t tid;
+        OffloadThreadArg *arg = new OffloadThreadArg();
+        arg->pool = this;
+        arg->index = i;
+        if (pthread_create(&tid, NULL, thread_main, arg) != 0) {
+            coco_error("create offload thread %d failed", i);
+            delete arg;
+            continue;
+        }
+        threads_.push_back(tid);
+    }
+    coco_trace("offload pool started, threads=%d", (int)threads_.size());
+}
+
+OffloadPool::~OffloadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mu_);
+        stop_ = true;
+    }
+    cv_.notify_all();
+
+    for (auto tid : threads_) {
+        pthread_join(tid, NULL);
+    }
+    for (auto q : queues_) {
+        coco_freep(q);
+    }
+}
+
+OffloadPool *OffloadPool::Instance() {
+    std::lock_guard<std::mutex> lock(_offload_pool_mu);
+    if (_offload_pool == nullptr) {
+        int nb_threads = _offload_nb_threads;
+        if (nb_threads <= 0) {
+            nb_threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+        }
+        _offload_pool = new OffloadPool(coco_max(nb_threads, 1));
+    }
+    return _offload_pool;
+}
+
+void OffloadPool::SetThreads(int v) { _offload_nb_threads = v; }
+
+void OffloadPool::Submit(OffloadJob *job) {
+    Queue *q = queues_[next_++ % queues_.size()];
+    {
+        std::lock_guard<std::mutex> lock(q->mu);
+        q->jobs.push_back(job);
+    }
+    pending_++;
+
+    // lock to avoid the lost wakeup, the thread checks pending_ in lock.
+    { std::lock_guard<std::mutex> lock(mu_); }
+    cv_.notify_one();
+}
+
+OffloadJob *OffloadPool::take(int index) {
+    int n = (int)queues_.size();
+    for (int i = 0; i < n; i++) {
+        Queue *q = queues_[(index + i) % n];
+        std::lock_guard<std::mutex> lock(q->mu);
+        if (q->jobs.empty()) {
+            continue;
+        }
+
+        // the owner takes the oldest job, the thieves take the newest.
+        OffloadJob *job = nullptr;
+        if (i == 0) {
+            job = q->jobs.front();
+            q->jobs.pop_front();
+        } else {
+            job = q->jobs.back();
+            q->jobs.pop_back();
+        }
+        pending_--;
+        return job;
+    }
+    return nullptr;
+}
+
+void *OffloadPool::thread_main(void *arg) {
+    OffloadThreadArg *targ = (OffloadThreadArg *)arg;
+    OffloadPool *pool = targ->pool;
+    int index = targ->index;
+    delete targ;
+
+    // the signals are handled by the schedulers.
+    sigset_t mask;
+    sigfillset(&mask);
+    pthread_sigmask(SIG_BLOCK, &mask, NULL);
+
+    while (true) {
+        OffloadJob *job = pool->take(index);
+        if (job) {
+            job->fn();
+            job->mailbox->Post(job);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(pool->mu_);
+        pool->cv_.wait(lock, [pool]() { return pool->stop_ || pool->pending_ > 0; });
+        if (pool->stop_) {
+            break;
+        }
+    }
+
+    return NULL;
+}
+
+class MailboxRoutine : public CoroutineHandler {
+ public:
+    MailboxRoutine(OffloadMailbox *mailbox) : mailbox_(mailbox) {
+        coroutine = new CoCoroutine("offload", this);
+    }
+    virtual ~MailboxRoutine() { coco_freep(coroutine); }
+
+    int Start() { return coroutine->start(); }
+    virtual int Cycle() {
+        char buf[512];
+        while (!ShouldTermCycle()) {
+            // eventfd reads the counter, pipe reads the bytes.
+            ssize_t nread = st_read(mailbox_->stfd_, buf, sizeof(buf), ST_UTIME_NO_TIMEOUT);
+            if (nread < 0 && errno == EINTR) {
+                break;
+            }
+            if (nread <= 0) {
+                continue;
+            }
+            mailbox_->dispatch();
+        }
+        return COCO_SUCCESS;
+    }
+
+ private:
+    OffloadMailbox *mailbox_;
+};
+
+thread_local OffloadMailbox *_offload_mailbox = nullptr;
+
+OffloadMailbox::OffloadMailbox() : notified_(false) {
+    rfd_ = wfd_ = -1;
+    stfd_ = nullptr;
+    routine_ = nullptr;
+}
+
+OffloadMailbox::~OffloadMailbox() {
+    coco_freep(routine_);
+
+    if (stfd_) {
+        st_netfd_close(stfd_);
+    } else if (rfd_ >= 0) {
+        ::close(rfd_);
+    }
+    if (wfd_ >= 0 && wfd_ != rfd_) {
+        ::close(wfd_);
+    }
+}
+
+OffloadMailbox *OffloadMailbox::Instance() {
+    if (_offload_mailbox == nullptr) {
+        OffloadMailbox *mailbox = new OffloadMailbox();
+        if (mailbox->Initialize() != COCO_SUCCESS) {
+            coco_freep(mailbox);
+            return nullptr;
+        }
+        _offload_mailbox = mailbox;
+    }
+    return _offload_mailbox;
+}
+
+int OffloadMailbox::Initialize() {
+    int ret = COCO_SUCCESS;
+
+#ifdef __linux__
+    if ((rfd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0) {
+        ret = ERROR_OFFLOAD_INIT;
+        coco_error("create offload eventfd failed. ret=%d", ret);
+        return ret;
+    }
+    wfd_ = rfd_;
+#else
+    int fds[2];
+    if (pipe(fds) < 0) {
+        ret = ERROR_OFFLOAD_INIT;
+        coco_error("create offload pipe failed. ret=%d", ret);
+        return ret;
+    }
+    rfd_ = fds[0];
+    wfd_ = fds[1];
+    // the pool threads never wait for the full pipe, the notify is coalesced.
+    fcntl(wfd_, F_SETFL, fcntl(wfd_, F_GETFL) | O_NONBLOCK);
+    fcntl(rfd_, F_SETFD, FD_CLOEXEC);
+    fcntl(wfd_, F_SETFD, FD_CLOEXEC);
+#endif
+
+    if ((stfd_ = st_netfd_open(rfd_)) == NULL) {
+        ret = ERROR_OFFLOAD_INIT;
+        coco_error("open offload fd %d failed. ret=%d", rfd_, ret);
+        return ret;
+    }
+
+    routine_ = new MailboxRoutine(this);
+    if ((ret = routine_->Start()) != COCO_SUCCESS) {
+        coco_error("start offload mailbox failed. ret=%d", ret);
+        return ret;
+    }
+
+    return ret;
+}
+
+void OffloadMailbox::Post(OffloadJob *job) {
+    {
+        std::lock_guard<std::mutex> lock(mu_);
+        done_.push_back(job);
+    }
+
+    if (notified_.exchange(true)) {
+        return;
+    }
+
+#ifdef __linux__
+    uint64_t v = 1;
+#else
+    char v = 1;
+#endif
+    if (::write(wfd_, &v, sizeof(v)) < 0 && errno != EAGAIN) {
+        coco_error("notify offload mailbox failed, errno=%d", errno);
+    }
+}
+
+void OffloadMailbox::dispatch() {
+    // clear before swap, so the jobs posted after swap notify again.
+    notified_ = false;
+
+    std::vector<OffloadJob *> jobs;
+    {
+        std::lock_guard<std::mutex> lock(mu_);
+        jobs.swap(done_);
+    }
+
+    for (auto job : jobs) {
+        job->done = true;
+        st_cond_signal(job->cond);
+    }
+}
+
+int CocoOffload(std::function<void()> fn) {
+    int ret = COCO_SUCCESS;
+
+    OffloadMailbox *mailbox = OffloadMailbox::Instance();
+    if (mailbox == nullptr) {
+        ret = ERROR_OFFLOAD_INIT;
+        coco_error("no offload mailbox, run in place. ret=%d", ret);
+        fn();
+        return ret;
+    }
+
+    OffloadJob job;
+    job.fn = std::move(fn);
+    job.mailbox = mailbox;
+    job.cond = st_cond_new();
+
+    OffloadPool::Instance()->Submit(&job);
+
+    // the job is on stack, so never return before done, even interrupted.
+    bool interrupted = false;
+    while (!job.done) {
+        if (st_cond_wait(job.cond) != 0) {
+            interrupted = true;
+        }
+    }
+    st_cond_destroy(job.cond);
+
+    if (interrupted) {
+        ret = ERROR_OFFLOAD_INTERRUPTED;
+        coco_warn("offload interrupted, the job is done. ret=%d", ret);
+    }
+    return ret;
+}
+
+void CocoSetOffloadThreads(int v) { OffloadPool::SetThreads(v); }
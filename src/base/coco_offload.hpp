@@ -0,0 +1,101 @@
+#pragma once
+
+#include <pthread.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+#include "st.h"
+
+class OffloadMailbox;
+class MailboxRoutine;
+
+// the job offloaded to the thread pool, owned by the waiting coroutine.
+struct OffloadJob {
+    std::function<void()> fn;
+    // the mailbox of the scheduler to resume the coroutine.
+    OffloadMailbox *mailbox = nullptr;
+    // set by the mailbox coroutine, never by the pool thread.
+    bool done = false;
+    st_cond_t cond = nullptr;
+};
+
+/**
+ * the work-stealing thread pool for cpu bound works, shared by all schedulers.
+ * each thread owns a queue, the submitted jobs are spread over the queues, and the
+ * idle threads steal from the others, so a long job never holds the jobs behind it.
+ */
+class OffloadPool {
+ public:
+    OffloadPool(int nb_threads);
+    virtual ~OffloadPool();
+
+    // the pool of process, started on first use.
+    static OffloadPool *Instance();
+    // the threads of pool, must be set before the first offload, 0 for the number of cpus.
+    static void SetThreads(int v);
+
+ public:
+    void Submit(OffloadJob *job);
+
+ private:
+    struct Queue {
+        std::mutex mu;
+        std::deque<OffloadJob *> jobs;
+    };
+
+    static void *thread_main(void *arg);
+    // pop the own queue first, then steal the others.
+    OffloadJob *take(int index);
+
+ private:
+    std::vector<Queue *> queues_;
+    std::vector<pthread_t> threads_;
+    std::atomic<unsigned> next_;
+    std::atomic<int> pending_;
+    bool stop_;
+    std::mutex mu_;
+    std::condition_variable cv_;
+};
+
+/**
+ * the completion mailbox of a scheduler, the pool threads post the done jobs and
+ * notify by eventfd (pipe when no eventfd), which is read by a coroutine.
+ * @remark st is not thread safe, so the pool threads never touch st, the coroutines
+ *       are resumed by the mailbox coroutine in the scheduler.
+ */
+class OffloadMailbox {
+ public:
+    OffloadMailbox();
+    virtual ~OffloadMailbox();
+
+    // the mailbox of current scheduler, nullptr when failed.
+    static OffloadMailbox *Instance();
+
+ public:
+    int Initialize();
+    // called by the pool threads.
+    void Post(OffloadJob *job);
+
+ private:
+    friend class MailboxRoutine;
+    // resume the coroutines of done jobs.
+    void dispatch();
+
+ private:
+    // read by the coroutine.
+    int rfd_;
+    // written by the pool threads, same as rfd_ for eventfd.
+    int wfd_;
+    st_netfd_t stfd_;
+    std::mutex mu_;
+    std::vector<OffloadJob *> done_;
+    // avoid to notify again before the coroutine reads.
+    std::atomic<bool> notified_;
+
+    MailboxRoutine *routine_;
+};
@@ -0,0 +1,195 @@
+#include "base/coco_profiler.hpp"
+
+#include <stdio.h>
+
+#include <algorithm>
+
+#include "base/coroutine_local.hpp"
+#include "common/error.hpp"
+#include "log/log.hpp"
+
+thread_local CoroutineProfiler *_coroutine_profiler = nullptr;
+
+CoroutineProfiler::CoroutineProfiler() { enabled_ = false; }
+
+CoroutineProfiler::~CoroutineProfiler() {
+    Stop();
+
+    for (auto it : stats_) {
+        delete it.second;
+    }
+    stats_.clear();
+}
+
+CoroutineProfiler *CoroutineProfiler::Instance() {
+    if (_coroutine_profiler == nullptr) {
+        _coroutine_profiler = new CoroutineProfiler();
+    }
+    return _coroutine_profiler;
+}
+
+int CoroutineProfiler::Start() {
+    int ret = COCO_SUCCESS;
+
+#ifdef COCO_ENABLE_PROFILER
+    if (enabled_) {
+        return ret;
+    }
+    enabled_ = true;
+
+    // the primordial coroutine never starts a cycle.
+    CoroutineLocalData *data = CoroutineLocalGet();
+    if (data && !data->prof.stats) {
+        Attach(data, "main");
+    }
+
+    st_set_switch_in_cb(on_switch_in);
+    st_set_switch_out_cb(on_switch_out);
+    coco_trace("coroutine profiler started");
+#else
+    ret = ERROR_PROFILER_DISABLED;
+    coco_warn("coroutine profiler disabled, build with COCO_ENABLE_PROFILER. ret=%d", ret);
+#endif
+
+    return ret;
+}
+
+void CoroutineProfiler::Stop() {
+#ifdef COCO_ENABLE_PROFILER
+    if (!enabled_) {
+        return;
+    }
+    enabled_ = false;
+
+    st_set_switch_in_cb(NULL);
+    st_set_switch_out_cb(NULL);
+#endif
+}
+
+void CoroutineProfiler::Reset() {
+    for (auto it : stats_) {
+        CoroutineProfileStats *s = it.second;
+        s->coroutines = s->alive;
+        s->switches = s->cpu_us = s->wait_us = s->max_slice_us = 0;
+    }
+}
+
+std::vector<CoroutineProfileStats> CoroutineProfiler::Stats() {
+    std::vector<CoroutineProfileStats> stats;
+    for (auto it : stats_) {
+        stats.push_back(*it.second);
+    }
+
+    std::sort(stats.begin(), stats.end(),
+              [](const CoroutineProfileStats &a, const CoroutineProfileStats &b) {
+                  return a.cpu_us > b.cpu_us;
+              });
+    return stats;
+}
+
+std::string CoroutineProfiler::Dump() {
+    std::string dump;
+    char buf[256];
+
+    snprintf(buf, sizeof(buf), "%-16s %10s %8s %12s %12s %12s %14s\n", "name", "coroutines",
+             "alive", "switches", "cpu_ms", "wait_ms", "max_slice_us");
+    dump += buf;
+
+    for (auto &s : Stats()) {
+        snprintf(buf, sizeof(buf), "%-16s %10llu %8d %12llu %12.3f %12.3f %14llu\n",
+                 s.name.c_str(), (unsigned long long)s.coroutines, s.alive,
+                 (unsigned long long)s.switches, s.cpu_us / 1000.0, s.wait_us / 1000.0,
+                 (unsigned long long)s.max_slice_us);
+        dump += buf;
+    }
+
+    return dump;
+}
+
+CoroutineProfile *CoroutineProfiler::Current() {
+#ifdef COCO_ENABLE_PROFILER
+    CoroutineLocalData *data = CoroutineLocalGet();
+    if (data && data->prof.stats) {
+        return &data->prof;
+    }
+#endif
+    return nullptr;
+}
+
+void CoroutineProfiler::Attach(CoroutineLocalData *data, const std::string &name) {
+#ifdef COCO_ENABLE_PROFILER
+    if (!enabled_) {
+        return;
+    }
+
+    CoroutineProfileStats *s = nullptr;
+    auto it = stats_.find(name);
+    if (it == stats_.end()) {
+        s = new CoroutineProfileStats();
+        s->name = name;
+        stats_[name] = s;
+    } else {
+        s = it->second;
+    }
+    s->coroutines++;
+    s->alive++;
+
+    data->prof = CoroutineProfile();
+    data->prof.stats = s;
+    // attached in the coroutine, it's running now.
+    data->prof.in_at = st_utime();
+#endif
+}
+
+void CoroutineProfiler::Detach(CoroutineLocalData *data) {
+#ifdef COCO_ENABLE_PROFILER
+    if (data->prof.stats) {
+        data->prof.stats->alive--;
+    }
+    data->prof = CoroutineProfile();
+#endif
+}
+
+void CoroutineProfiler::on_switch_in() {
+#ifdef COCO_ENABLE_PROFILER
+    CoroutineLocalData *data = CoroutineLocalGet();
+    if (!data || !data->prof.stats) {
+        return;
+    }
+
+    CoroutineProfile &p = data->prof;
+    st_utime_t now = st_utime();
+    if (p.out_at) {
+        uint64_t wait = now - p.out_at;
+        p.wait_us += wait;
+        p.stats->wait_us += wait;
+    }
+    p.in_at = now;
+#endif
+}
+
+void CoroutineProfiler::on_switch_out() {
+#ifdef COCO_ENABLE_PROFILER
+    CoroutineLocalData *data = CoroutineLocalGet();
+    if (!data || !data->prof.stats) {
+        return;
+    }
+
+    CoroutineProfile &p = data->prof;
+    st_utime_t now = st_utime();
+    uint64_t slice = p.in_at ? now - p.in_at : 0;
+    p.switches++;
+    p.cpu_us += slice;
+    p.out_at = now;
+
+    CoroutineProfileStats *s = p.stats;
+    s->switches++;
+    s->cpu_us += slice;
+    if (slice > s->max_slice_us) {
+        s->max_slice_us = slice;
+    }
+#endif
+}
+
+int CocoProfilerStart() { return CoroutineProfiler::Instance()->Start(); }
+std::string CocoProfilerDump() { return CoroutineProfiler::Instance()->Dump(); }
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "st.h"
+
+struct CoroutineLocalData;
+
+// the counters of coroutines with the same name.
+struct CoroutineProfileStats {
+    std::string name;
+    // the coroutines started, and in cycle now.
+    uint64_t coroutines = 0;
+    int alive = 0;
+    // the times of yield.
+    uint64_t switches = 0;
+    // the time between resume and yield.
+    uint64_t cpu_us = 0;
+    // the time between yield and resume, which is blocked or runnable.
+    uint64_t wait_us = 0;
+    // the longest time between resume and yield, which stalls the scheduler.
+    uint64_t max_slice_us = 0;
+};
+
+// the counters of one coroutine, in the coroutine local block.
+struct CoroutineProfile {
+    // the stats of the name, nullptr when not profiled.
+    CoroutineProfileStats *stats = nullptr;
+    uint64_t switches = 0;
+    uint64_t cpu_us = 0;
+    uint64_t wait_us = 0;
+    st_utime_t in_at = 0;
+    st_utime_t out_at = 0;
+};
+
+/**
+ * the profiler of coroutines, by the switch callbacks of st, which requires to build
+ * with COCO_ENABLE_PROFILER, and then st is built with ST_SWITCH_CB.
+ * the counters are aggregated by the name of coroutine, such as "conn" or "listen", so
+ * a hot handler or a busy connection stalls the scheduler can be found.
+ * @remark st never tells when a coroutine becomes runnable, so the wait time is the whole
+ *       off-cpu time, including the time blocked on io.
+ * @remark the profiler belongs to the st scheduler of current thread.
+ */
+class CoroutineProfiler {
+ public:
+    CoroutineProfiler();
+    virtual ~CoroutineProfiler();
+
+    // the profiler of current scheduler.
+    static CoroutineProfiler *Instance();
+
+ public:
+    // start to profile, ERROR_PROFILER_DISABLED when not built with COCO_ENABLE_PROFILER.
+    int Start();
+    void Stop();
+    bool Enabled() { return enabled_; }
+    // clear the counters, the alive coroutines are kept.
+    void Reset();
+    // the stats by name, sorted by cpu time.
+    std::vector<CoroutineProfileStats> Stats();
+    // the stats in text table.
+    std::string Dump();
+    // the counters of current coroutine, nullptr when not profiled.
+    CoroutineProfile *Current();
+
+ public:
+    // profile the coroutine by name, called when the cycle starts.
+    void Attach(CoroutineLocalData *data, const std::string &name);
+    // called when the cycle is done.
+    void Detach(CoroutineLocalData *data);
+
+ private:
+    static void on_switch_in();
+    static void on_switch_out();
+
+ private:
+    bool enabled_;
+    // the stats never move, the coroutines refer to them.
+    std::unordered_map<std::string, CoroutineProfileStats *> stats_;
+};
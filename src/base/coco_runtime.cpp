@@ -0,0 +1,132 @@
+#include "base/coco_runtime.hpp"
+
+#include <signal.h>
+#include <unistd.h>
+
+#include "coco_api.h"
+#include "common/error.hpp"
+#include "log/log.hpp"
+#include "net/coco_uring.hpp"
+#include "utils/utils.hpp"
+
+thread_local CocoWorker *_coco_worker = nullptr;
+
+CocoWorker::CocoWorker(CocoRuntime *runtime, int id) {
+    runtime_ = runtime;
+    id_ = id;
+}
+
+CocoWorker::~CocoWorker() {}
+
+CocoRuntime::CocoRuntime(int nb_workers) {
+    if (nb_workers <= 0) {
+        nb_workers = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    nb_workers = coco_max(nb_workers, 1);
+
+    for (int i = 0; i < nb_workers; i++) {
+        workers_.push_back(new CocoWorker(this, i));
+    }
+}
+
+CocoRuntime::~CocoRuntime() {
+    for (auto w : workers_) {
+        coco_freep(w);
+    }
+    workers_.clear();
+}
+
+int CocoRuntime::Start(CocoWorkerFunc fn) {
+    int ret = COCO_SUCCESS;
+
+    fn_ = fn;
+
+#ifdef __linux__
+    // the workers inherit the mask, the signals are read by signalfd in CocoRun().
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGTERM);
+    sigaddset(&mask, SIGINT);
+    pthread_sigmask(SIG_BLOCK, &mask, NULL);
+#endif
+
+    for (auto w : workers_) {
+        if (pthread_create(&w->tid_, NULL, worker_main, w) != 0) {
+            ret = ERROR_RUNTIME_THREAD_CREATE;
+            coco_error("create worker %d failed. ret=%d", w->id_, ret);
+            return ret;
+        }
+        w->started_ = true;
+    }
+    coco_trace("runtime started, workers=%d", (int)workers_.size());
+
+    return ret;
+}
+
+int CocoRuntime::Join() {
+    int ret = COCO_SUCCESS;
+
+    for (auto w : workers_) {
+        if (!w->started_) {
+            continue;
+        }
+        pthread_join(w->tid_, NULL);
+        w->started_ = false;
+        if (w->ret_ != COCO_SUCCESS) {
+            ret = w->ret_;
+        }
+    }
+
+    return ret;
+}
+
+CocoWorker *CocoRuntime::Current() { return _coco_worker; }
+
+void CocoRuntime::free_thread_resources() {
+#if defined(__linux__) && defined(COCO_ENABLE_IO_URING)
+    // the ring holds the fds, mapped rings and registered buffers of this thread.
+    UringRing::Destroy();
+#endif
+}
+
+void *CocoRuntime::worker_main(void *arg) {
+    CocoWorker *w = (CocoWorker *)arg;
+    CocoRuntime *rt = w->runtime_;
+
+#ifdef __linux__
+    if (rt->cpu_affinity_) {
+        long nb_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(w->id_ % nb_cpus, &cpus);
+        if (pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) != 0) {
+            coco_warn("worker %d set cpu affinity failed, ignore.", w->id_);
+        }
+    }
+#endif
+
+    if ((w->ret_ = CocoInit(rt->io_backend_)) != COCO_SUCCESS) {
+        coco_error("worker %d init st failed. ret=%d", w->id_, w->ret_);
+        return NULL;
+    }
+    _coco_worker = w;
+    w->manager_ = new ConnManager();
+    coco_trace("worker %d started", w->id_);
+
+    if ((w->ret_ = rt->fn_(w)) != COCO_SUCCESS) {
+        coco_error("worker %d run failed. ret=%d", w->id_, w->ret_);
+        // the conns belong to this scheduler, free them in this thread.
+        coco_freep(w->manager_);
+        _coco_worker = nullptr;
+        free_thread_resources();
+        return NULL;
+    }
+
+    // keep the scheduler running for the coroutines started by fn, until shutdown.
+    if ((w->ret_ = CocoRun()) != COCO_SUCCESS) {
+        coco_warn("worker %d shutdown. ret=%d", w->id_, w->ret_);
+    }
+
+    free_thread_resources();
+    return NULL;
+}
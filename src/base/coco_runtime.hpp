@@ -0,0 +1,89 @@
+#pragma once
+
+#include <pthread.h>
+
+#include <functional>
+#include <vector>
+
+#include "base/coroutine_mgr.hpp"
+#include "coco_api.h"
+
+class CocoRuntime;
+
+/**
+ * a worker is one os thread running its own st scheduler.
+ * everything created inside the worker function (listeners, servers, connections)
+ * belongs to that scheduler and must never be touched from another worker.
+ */
+class CocoWorker {
+ public:
+    CocoWorker(CocoRuntime *runtime, int id);
+    virtual ~CocoWorker();
+
+    int GetId() { return id_; }
+    // the connection manager shared by the routines of this worker.
+    ConnManager *GetConnManager() { return manager_; }
+    CocoRuntime *GetRuntime() { return runtime_; }
+
+ private:
+    friend class CocoRuntime;
+
+    CocoRuntime *runtime_;
+    int id_;
+    pthread_t tid_;
+    bool started_ = false;
+    ConnManager *manager_ = nullptr;
+    int ret_ = 0;
+};
+
+// called in each worker after its scheduler is initialized.
+typedef std::function<int(CocoWorker *)> CocoWorkerFunc;
+
+/**
+ * the multi-core runtime, starts N pthreads each with its own st scheduler.
+ * Usage:
+ *       CocoRuntime rt(0);  // one worker per cpu core
+ *       rt.Start([&](CocoWorker *w) {
+ *           HttpServer *s = new HttpServer(false);
+ *           s->ListenAndServe("0.0.0.0", 8080, mux);  // one SO_REUSEPORT shard per worker
+ *           return s->Start();
+ *       });
+ *       rt.Join();
+ * @remark st must be built with per-thread scheduler state, or the workers share the
+ *       scheduler globals and corrupt each other.
+ */
+class CocoRuntime {
+ public:
+    /**
+     * @param nb_workers the number of workers, 0 to use the number of online cpus.
+     */
+    CocoRuntime(int nb_workers = 0);
+    virtual ~CocoRuntime();
+
+    // pin each worker to the cpu of its id, linux only.
+    void SetCpuAffinity(bool v) { cpu_affinity_ = v; }
+    // the io backend of each worker, see CocoInit().
+    void SetIoBackend(CocoIoBackend v) { io_backend_ = v; }
+    int GetWorkerCount() { return (int)workers_.size(); }
+
+    /**
+     * start all workers, each calls CocoInit() and then fn in its own thread.
+     * the worker keeps its scheduler running after fn returns success.
+     */
+    int Start(CocoWorkerFunc fn);
+    // wait for all workers to exit.
+    int Join();
+
+    // the worker of current thread, nullptr when not in a runtime worker.
+    static CocoWorker *Current();
+
+ private:
+    static void *worker_main(void *arg);
+    // free the per-thread resources of the scheduler, when the worker exits.
+    static void free_thread_resources();
+
+    std::vector<CocoWorker *> workers_;
+    CocoWorkerFunc fn_;
+    bool cpu_affinity_ = false;
+    CocoIoBackend io_backend_ = CocoIoEpoll;
+};
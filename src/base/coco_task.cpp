@@ -0,0 +1,205 @@
+#include "base/coco_task.hpp"
+
+#include "base/coco_context.hpp"
+#include "base/coroutine.hpp"
+#include "coco_api.h"
+#include "log/log.hpp"
+#include "utils/utils.hpp"
+
+class TaskWorker : public CoroutineHandler {
+ public:
+    TaskWorker(TaskPool *pool) : pool_(pool) { coroutine = new CoCoroutine("task", this); }
+    virtual ~TaskWorker() { coco_freep(coroutine); }
+
+    int Start() { return coroutine->start(); }
+    virtual int Cycle() {
+        pool_->starting_--;
+
+        while (!ShouldTermCycle()) {
+            while (pool_->queue_.empty()) {
+                pool_->idle_++;
+                int r = st_cond_wait(pool_->not_empty_);
+                pool_->idle_--;
+
+                // interrupted when pool destroyed, ignore the interrupt of cancelled task.
+                if (r != 0 && ShouldTermCycle()) {
+                    return COCO_SUCCESS;
+                }
+            }
+
+            TaskItem task = std::move(pool_->queue_.front());
+            pool_->queue_.pop_front();
+            st_cond_signal(pool_->not_full_);
+
+            CocoContext::Switch(task.ctx);
+            task.fn();
+            CocoContext::Switch(nullptr);
+            if (task.ctx) {
+                task.ctx->Release();
+            }
+            pool_->completed_++;
+        }
+        return COCO_SUCCESS;
+    }
+
+ private:
+    TaskPool *pool_;
+};
+
+thread_local TaskPool *_task_pool = nullptr;
+
+TaskPool::TaskPool() {
+    min_workers_ = COCO_TASK_MIN_WORKERS;
+    max_workers_ = COCO_TASK_MAX_WORKERS;
+    max_queue_ = COCO_TASK_MAX_QUEUE;
+    idle_ = starting_ = 0;
+    not_empty_ = st_cond_new();
+    not_full_ = st_cond_new();
+    submitted_ = completed_ = rejected_ = blocked_ = 0;
+}
+
+TaskPool::~TaskPool() {
+    for (auto w : workers_) {
+        coco_freep(w);
+    }
+    workers_.clear();
+
+    for (auto &task : queue_) {
+        if (task.ctx) {
+            task.ctx->Release();
+        }
+    }
+    queue_.clear();
+
+    st_cond_destroy(not_empty_);
+    st_cond_destroy(not_full_);
+}
+
+TaskPool *TaskPool::Instance() {
+    if (_task_pool == nullptr) {
+        _task_pool = new TaskPool();
+    }
+    return _task_pool;
+}
+
+void TaskPool::SetLimits(int min_workers, int max_workers, int max_queue) {
+    max_workers_ = coco_max(1, max_workers);
+    min_workers_ = coco_min(coco_max(0, min_workers), max_workers_);
+    max_queue_ = coco_max(1, max_queue);
+}
+
+int TaskPool::Go(CocoTask task) {
+    int ret = COCO_SUCCESS;
+
+    // back-pressure, the producer waits for the workers.
+    if ((int)queue_.size() >= max_queue_) {
+        blocked_++;
+    }
+    while ((int)queue_.size() >= max_queue_) {
+        if (st_cond_wait(not_full_) != 0) {
+            ret = ERROR_TASK_INTERRUPTED;
+            coco_warn("go task interrupted, queued=%d. ret=%d", (int)queue_.size(), ret);
+            return ret;
+        }
+    }
+
+    enqueue(task);
+    return ret;
+}
+
+int TaskPool::TryGo(CocoTask task) {
+    int ret = COCO_SUCCESS;
+
+    if ((int)queue_.size() >= max_queue_) {
+        rejected_++;
+        ret = ERROR_TASK_QUEUE_FULL;
+        coco_warn("task queue full, queued=%d. ret=%d", (int)queue_.size(), ret);
+        return ret;
+    }
+
+    enqueue(task);
+    return ret;
+}
+
+void TaskPool::enqueue(CocoTask &task) {
+    // pre-start the min workers on the first task.
+    while ((int)workers_.size() < min_workers_) {
+        if (spawn() != COCO_SUCCESS) {
+            break;
+        }
+    }
+
+    TaskItem item;
+    item.fn = std::move(task);
+    if ((item.ctx = CocoContext::Current()) != nullptr) {
+        item.ctx->AddRef();
+    }
+    queue_.push_back(std::move(item));
+    submitted_++;
+
+    // start a new worker when the idle and starting workers are not enough for the queue.
+    if (idle_ + starting_ < (int)queue_.size() && (int)workers_.size() < max_workers_) {
+        spawn();
+    }
+    if (idle_ > 0) {
+        st_cond_signal(not_empty_);
+    }
+}
+
+int TaskPool::spawn() {
+    int ret = COCO_SUCCESS;
+
+    TaskWorker *w = new TaskWorker(this);
+    if ((ret = w->Start()) != COCO_SUCCESS) {
+        coco_error("start task worker failed, workers=%d. ret=%d", (int)workers_.size(), ret);
+        coco_freep(w);
+        return ret;
+    }
+    workers_.push_back(w);
+    starting_++;
+
+    return ret;
+}
+
+TaskPoolStats TaskPool::Stats() {
+    TaskPoolStats s;
+    s.workers = (int)workers_.size();
+    s.idle = idle_;
+    s.queued = (int)queue_.size();
+    s.submitted = submitted_;
+    s.completed = completed_;
+    s.rejected = rejected_;
+    s.blocked = blocked_;
+    return s;
+}
+
+CocoWaitGroup::CocoWaitGroup() {
+    count_ = 0;
+    cond_ = st_cond_new();
+}
+
+CocoWaitGroup::~CocoWaitGroup() { st_cond_destroy(cond_); }
+
+void CocoWaitGroup::Add(int n) { count_ += n; }
+
+void CocoWaitGroup::Done() {
+    if (--count_ <= 0) {
+        count_ = 0;
+        st_cond_broadcast(cond_);
+    }
+}
+
+int CocoWaitGroup::Wait() {
+    while (count_ > 0) {
+        if (st_cond_wait(cond_) != 0) {
+            return ERROR_TASK_INTERRUPTED;
+        }
+    }
+    return COCO_SUCCESS;
+}
+
+int CocoGo(std::function<void()> fn) { return TaskPool::Instance()->Go(std::move(fn)); }
+int CocoTryGo(std::function<void()> fn) { return TaskPool::Instance()->TryGo(std::move(fn)); }
+void CocoSetGoLimits(int min_workers, int max_workers, int max_queue) {
+    TaskPool::Instance()->SetLimits(min_workers, max_workers, max_queue);
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <deque>
+#include <functional>
+#include <vector>
+
+#include "st.h"
+
+class CoCoroutine;
+class CocoContext;
+class TaskWorker;
+
+typedef std::function<void()> CocoTask;
+
+// the queued task, which runs in the context of the submitter.
+struct TaskItem {
+    CocoTask fn;
+    CocoContext *ctx = nullptr;
+};
+
+// the default limits of task pool.
+#define COCO_TASK_MIN_WORKERS 4
+#define COCO_TASK_MAX_WORKERS 256
+#define COCO_TASK_MAX_QUEUE 4096
+
+struct TaskPoolStats {
+    int workers = 0;
+    // the workers wait for task.
+    int idle = 0;
+    int queued = 0;
+    uint64_t submitted = 0;
+    uint64_t completed = 0;
+    // rejected by TryGo when queue is full.
+    uint64_t rejected = 0;
+    // Go blocked when queue is full.
+    uint64_t blocked = 0;
+};
+
+/**
+ * the pool of worker coroutines to run short tasks, see CocoGo().
+ * the min workers are started on the first task, and more workers are started
+ * on demand up to the max workers, which then run the queued tasks one by one.
+ * @remark the task runs in the CocoContext of the submitter, so it's interrupted when
+ *       the submitter gives up.
+ * @remark the pool belongs to the st scheduler of current thread, and the workers
+ *       live as long as the scheduler.
+ */
+class TaskPool {
+ public:
+    TaskPool();
+    virtual ~TaskPool();
+
+    // the pool of current scheduler.
+    static TaskPool *Instance();
+
+ public:
+    // set the limits, the started workers are never stopped.
+    void SetLimits(int min_workers, int max_workers, int max_queue);
+    /**
+     * queue the task, wait when queue is full.
+     * @return ERROR_TASK_INTERRUPTED when interrupted in waiting.
+     */
+    int Go(CocoTask task);
+    /**
+     * queue the task, never wait.
+     * @return ERROR_TASK_QUEUE_FULL when queue is full.
+     */
+    int TryGo(CocoTask task);
+    TaskPoolStats Stats();
+
+ private:
+    friend class TaskWorker;
+    void enqueue(CocoTask &task);
+    int spawn();
+
+ private:
+    int min_workers_;
+    int max_workers_;
+    int max_queue_;
+
+    std::deque<TaskItem> queue_;
+    std::vector<TaskWorker *> workers_;
+    int idle_;
+    // the workers started but not run yet.
+    int starting_;
+    st_cond_t not_empty_;
+    st_cond_t not_full_;
+
+    uint64_t submitted_;
+    uint64_t completed_;
+    uint64_t rejected_;
+    uint64_t blocked_;
+};
+
+/**
+ * wait for a group of tasks to finish.
+ * Usage:
+ *       CocoWaitGroup wg;
+ *       for (auto &url : urls) {
+ *           wg.Add(1);
+ *           CocoGo([&wg, url]() { fetch(url); wg.Done(); });
+ *       }
+ *       wg.Wait();
+ */
+class CocoWaitGroup {
+ public:
+    CocoWaitGroup();
+    virtual ~CocoWaitGroup();
+
+    void Add(int n);
+    void Done();
+    // wait until the counter is zero, return error when interrupted.
+    int Wait();
+
+ private:
+    int count_;
+    st_cond_t cond_;
+};
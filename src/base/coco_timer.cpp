@@ -0,0 +1,245 @@
+#include "base/coco_timer.hpp"
+
+#include "base/coroutine.hpp"
+#include "coco_api.h"
+#include "log/log.hpp"
+#include "utils/utils.hpp"
+
+class TimerRoutine : public CoroutineHandler {
+ public:
+    TimerRoutine(TimerWheel *wheel) : wheel_(wheel) { coroutine = new CoCoroutine("timer", this); }
+    virtual ~TimerRoutine() { coco_freep(coroutine); }
+
+    int Start() { return coroutine->start(); }
+    virtual int Cycle() {
+        while (!ShouldTermCycle()) {
+            // no timers, wait for the first one.
+            if (wheel_->timers_.empty()) {
+                if (st_cond_wait(wheel_->cond_) != 0) {
+                    break;
+                }
+                continue;
+            }
+
+            if (st_usleep(COCO_TIMER_TICK_US) != 0) {
+                break;
+            }
+            wheel_->run_until(wheel_->current_tick());
+        }
+        return COCO_SUCCESS;
+    }
+
+ private:
+    TimerWheel *wheel_;
+};
+
+static void timer_list_init(TimerNode *head) { head->prev = head->next = head; }
+
+thread_local TimerWheel *_timer_wheel = nullptr;
+
+TimerWheel::TimerWheel() {
+    for (int i = 0; i < COCO_TIMER_ROOT_SIZE; i++) {
+        timer_list_init(&root_[i]);
+    }
+    for (int l = 0; l < COCO_TIMER_LEVELS - 1; l++) {
+        for (int i = 0; i < COCO_TIMER_LEVEL_SIZE; i++) {
+            timer_list_init(&levels_[l][i]);
+        }
+    }
+
+    start_ = st_utime();
+    tick_ = 0;
+    next_id_ = 1;
+    running_ = nullptr;
+    routine_ = nullptr;
+    cond_ = st_cond_new();
+}
+
+TimerWheel::~TimerWheel() {
+    coco_freep(routine_);
+
+    for (auto it : timers_) {
+        delete it.second;
+    }
+    timers_.clear();
+
+    st_cond_destroy(cond_);
+}
+
+TimerWheel *TimerWheel::Instance() {
+    if (_timer_wheel == nullptr) {
+        _timer_wheel = new TimerWheel();
+    }
+    return _timer_wheel;
+}
+
+TimerId TimerWheel::Add(uint64_t delay_ms, uint64_t interval_ms, std::function<void()> fn) {
+    if (routine_ == nullptr) {
+        routine_ = new TimerRoutine(this);
+        if (routine_->Start() != COCO_SUCCESS) {
+            coco_error("start timer routine failed");
+            coco_freep(routine_);
+            return 0;
+        }
+    }
+
+    // the wheel is empty, skip the idle ticks.
+    bool idle = timers_.empty();
+    if (idle) {
+        tick_ = current_tick();
+    }
+
+    TimerNode *node = new TimerNode();
+    node->id = next_id_++;
+    node->expires = coco_max(tick_, current_tick()) +
+                    (delay_ms * 1000 + COCO_TIMER_TICK_US - 1) / COCO_TIMER_TICK_US;
+    node->interval = (interval_ms * 1000 + COCO_TIMER_TICK_US - 1) / COCO_TIMER_TICK_US;
+    // the periodic timer fires at least once a tick.
+    if (interval_ms && !node->interval) {
+        node->interval = 1;
+    }
+    node->fn = std::move(fn);
+
+    link(node);
+    timers_[node->id] = node;
+
+    if (idle) {
+        st_cond_signal(cond_);
+    }
+    return node->id;
+}
+
+bool TimerWheel::Cancel(TimerId id) {
+    auto it = timers_.find(id);
+    if (it == timers_.end()) {
+        return false;
+    }
+
+    TimerNode *node = it->second;
+    timers_.erase(it);
+
+    // cancel itself in fn, freed after fn returns.
+    if (node == running_) {
+        node->cancelled = true;
+        return true;
+    }
+
+    unlink(node);
+    delete node;
+    return true;
+}
+
+uint64_t TimerWheel::current_tick() { return (st_utime() - start_) / COCO_TIMER_TICK_US; }
+
+void TimerWheel::link(TimerNode *node) {
+    TimerNode *head = nullptr;
+
+    // expired, fire in the next tick.
+    if (node->expires < tick_) {
+        head = &root_[tick_ & COCO_TIMER_ROOT_MASK];
+    } else if (node->expires - tick_ < COCO_TIMER_ROOT_SIZE) {
+        head = &root_[node->expires & COCO_TIMER_ROOT_MASK];
+    } else {
+        // too long, clamp to the max.
+        if (node->expires - tick_ >= COCO_TIMER_MAX_TICKS) {
+            node->expires = tick_ + COCO_TIMER_MAX_TICKS - 1;
+        }
+
+        uint64_t idx = node->expires - tick_;
+        for (int l = 0; l < COCO_TIMER_LEVELS - 1; l++) {
+            int shift = COCO_TIMER_ROOT_BITS + l * COCO_TIMER_LEVEL_BITS;
+            if (idx < ((uint64_t)1 << (shift + COCO_TIMER_LEVEL_BITS))) {
+                head = &levels_[l][(node->expires >> shift) & COCO_TIMER_LEVEL_MASK];
+                break;
+            }
+        }
+    }
+
+    // append to the tail of slot.
+    node->prev = head->prev;
+    node->next = head;
+    head->prev->next = node;
+    head->prev = node;
+}
+
+void TimerWheel::unlink(TimerNode *node) {
+    if (node->prev) {
+        node->prev->next = node->next;
+        node->next->prev = node->prev;
+    }
+    node->prev = node->next = nullptr;
+}
+
+int TimerWheel::cascade(int level, int index) {
+    TimerNode *head = &levels_[level][index];
+
+    // detach the slot, the timers are linked to the lower levels.
+    TimerNode *node = head->next;
+    timer_list_init(head);
+    while (node != head) {
+        TimerNode *next = node->next;
+        link(node);
+        node = next;
+    }
+
+    return index;
+}
+
+void TimerWheel::run_until(uint64_t tick) {
+    while (tick_ <= tick) {
+        int index = tick_ & COCO_TIMER_ROOT_MASK;
+
+        // the root wraps, cascade the upper levels.
+        if (!index) {
+            for (int l = 0; l < COCO_TIMER_LEVELS - 1; l++) {
+                int shift = COCO_TIMER_ROOT_BITS + l * COCO_TIMER_LEVEL_BITS;
+                if (cascade(l, (tick_ >> shift) & COCO_TIMER_LEVEL_MASK)) {
+                    break;
+                }
+            }
+        }
+        tick_++;
+
+        // detach the expired timers, the fn may add timers to the root.
+        TimerNode expired;
+        TimerNode *head = &root_[index];
+        if (head->next == head) {
+            continue;
+        }
+        expired.next = head->next;
+        expired.prev = head->prev;
+        expired.next->prev = &expired;
+        expired.prev->next = &expired;
+        timer_list_init(head);
+
+        while (expired.next != &expired) {
+            TimerNode *node = expired.next;
+            unlink(node);
+
+            running_ = node;
+            node->fn();
+            running_ = nullptr;
+
+            if (node->cancelled) {
+                delete node;
+                continue;
+            }
+            if (!node->interval) {
+                timers_.erase(node->id);
+                delete node;
+                continue;
+            }
+
+            node->expires += node->interval;
+            link(node);
+        }
+    }
+}
+
+TimerId CocoAfter(uint64_t ms, std::function<void()> fn) {
+    return TimerWheel::Instance()->Add(ms, 0, std::move(fn));
+}
+TimerId CocoEvery(uint64_t ms, std::function<void()> fn) {
+    return TimerWheel::Instance()->Add(ms, ms, std::move(fn));
+}
+bool CocoCancel(TimerId id) { return TimerWheel::Instance()->Cancel(id); }
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <functional>
+#include <unordered_map>
+
+#include "st.h"
+
+class CoCoroutine;
+class TimerRoutine;
+
+typedef uint64_t TimerId;
+
+// the tick of timer wheel, in us.
+#define COCO_TIMER_TICK_US (10 * 1000)
+
+// the slots of the first level, 8 bits.
+#define COCO_TIMER_ROOT_BITS 8
+#define COCO_TIMER_ROOT_SIZE (1 << COCO_TIMER_ROOT_BITS)
+#define COCO_TIMER_ROOT_MASK (COCO_TIMER_ROOT_SIZE - 1)
+// the slots of the upper levels, 6 bits each.
+#define COCO_TIMER_LEVEL_BITS 6
+#define COCO_TIMER_LEVEL_SIZE (1 << COCO_TIMER_LEVEL_BITS)
+#define COCO_TIMER_LEVEL_MASK (COCO_TIMER_LEVEL_SIZE - 1)
+#define COCO_TIMER_LEVELS 4
+// the max ticks of the wheel, longer timers are clamped, about 7.7 days for 10ms tick.
+#define COCO_TIMER_MAX_TICKS \
+    ((uint64_t)1 << (COCO_TIMER_ROOT_BITS + (COCO_TIMER_LEVELS - 1) * COCO_TIMER_LEVEL_BITS))
+
+struct TimerNode {
+    TimerId id = 0;
+    // the tick to fire.
+    uint64_t expires = 0;
+    // the ticks of periodic timer, 0 for one-shot.
+    uint64_t interval = 0;
+    bool cancelled = false;
+    std::function<void()> fn;
+
+    // linked in the slot, the slot head is a sentinel node.
+    TimerNode *prev = nullptr;
+    TimerNode *next = nullptr;
+};
+
+/**
+ * the hierarchical timer wheel, which fires all timers of scheduler in one coroutine.
+ * insert and cancel are O(1), and the upper levels cascade to the lower levels when
+ * the lower levels wrap, so each timer moves at most COCO_TIMER_LEVELS times.
+ * @remark the timer fn runs in the timer coroutine, so never block in fn, use CocoGo()
+ *       for blocking works.
+ * @remark the wheel belongs to the st scheduler of current thread.
+ */
+class TimerWheel {
+ public:
+    TimerWheel();
+    virtual ~TimerWheel();
+
+    // the wheel of current scheduler.
+    static TimerWheel *Instance();
+
+ public:
+    /**
+     * fire fn after delay ms, and every interval ms when interval is not 0.
+     * @return the id of timer, 0 when failed.
+     */
+    TimerId Add(uint64_t delay_ms, uint64_t interval_ms, std::function<void()> fn);
+    // cancel the timer, return false when not found or already fired.
+    bool Cancel(TimerId id);
+    // the number of pending timers.
+    int Size() { return (int)timers_.size(); }
+
+ private:
+    friend class TimerRoutine;
+    // the tick of now, by st clock.
+    uint64_t current_tick();
+    void link(TimerNode *node);
+    void unlink(TimerNode *node);
+    // move the timers of upper slot to lower levels, return the index of slot.
+    int cascade(int level, int index);
+    // fire all timers before the tick.
+    void run_until(uint64_t tick);
+
+ private:
+    TimerNode root_[COCO_TIMER_ROOT_SIZE];
+    TimerNode levels_[COCO_TIMER_LEVELS - 1][COCO_TIMER_LEVEL_SIZE];
+    // the next tick to process.
+    uint64_t tick_;
+    st_utime_t start_;
+    TimerId next_id_;
+    std::unordered_map<TimerId, TimerNode *> timers_;
+    // the timer in fn.
+    TimerNode *running_;
+
+    TimerRoutine *routine_;
+    st_cond_t cond_;
+};
@@ -2,40 +2,54 @@
 
 #include <assert.h>
 
+#include <atomic>
+
+#include "base/coco_context.hpp"
+#include "base/coco_lifecycle.hpp"
+#include "base/coco_profiler.hpp"
+#include "base/coroutine_pool.hpp"
+#include "base/coroutine_stack.hpp"
 #include "coco_api.h"
 #include "log/log.hpp"
+#include "net/coco_uring.hpp"
 
 int CoroutineHandler::GetCoroutineState() { return coroutine->pull(); };
 
-CoroutineContext *_st_context = new CoroutineContext();
+// each os thread runs its own st scheduler, so the context is per thread.
+thread_local CoroutineContext *_st_context = nullptr;
 int CoroutineContext::generate_id() {
-    static int id = 100;
+    // shared by all schedulers, so the id is unique in the process.
+    static std::atomic<int> id(100);
 
     int gid = id++;
-    cache_[st_thread_self()] = gid;
+    CoroutineLocalData *data = CoroutineLocalGet();
+    if (data) {
+        data->cid = gid;
+    }
     return gid;
 }
 
-int CoroutineContext::get_id() { return cache_[st_thread_self()]; }
+int CoroutineContext::get_id() {
+    CoroutineLocalData *data = CoroutineLocalGet();
+    return data ? data->cid : 0;
+}
 
 int CoroutineContext::set_id(int v) {
-    st_thread_t self = st_thread_self();
-
-    int ov = 0;
-    if (cache_.find(self) != cache_.end()) {
-        ov = cache_[self];
+    CoroutineLocalData *data = CoroutineLocalGet();
+    if (!data) {
+        return 0;
     }
 
-    cache_[self] = v;
+    int ov = data->cid;
+    data->cid = v;
 
     return ov;
 }
 
 void CoroutineContext::clear_cid() {
-    st_thread_t self = st_thread_self();
-    std::map<st_thread_t, int>::iterator it = cache_.find(self);
-    if (it != cache_.end()) {
-        cache_.erase(it);
+    CoroutineLocalData *data = CoroutineLocalGet();
+    if (data) {
+        data->cid = kInvalidContextId;
     }
 }
 
@@ -64,15 +78,59 @@ CoCoroutine::CoCoroutine(std::string n, CoroutineHandler *h, int32_t cid) {
     stack_size = 0;
 }
 
+CoCoroutine::CoCoroutine(std::string n, CoroutineHandler *h, bool pooled) : CoCoroutine(n, h) {
+    pooled_ = pooled;
+    if (pooled_) {
+        wake_ = st_cond_new();
+        done_ = st_cond_new();
+    }
+}
+
 CoCoroutine::~CoCoroutine() {
     stop();
 
+    // wakeup the parked st thread to exit.
+    if (pooled_ && trd_) {
+        exit_ = true;
+        st_cond_signal(wake_);
+        st_thread_join((st_thread_t)trd_, NULL);
+        trd_ = NULL;
+    }
+    if (wake_) {
+        st_cond_destroy(wake_);
+    }
+    if (done_) {
+        st_cond_destroy(done_);
+    }
+    set_context(nullptr);
+
     // TODO: FIXME: We must assert the cycle is done.
     // srs_freep(trd_err);
 }
 
+void CoCoroutine::reset(const std::string &n, CoroutineHandler *h) {
+    name = n;
+    handler = h;
+    trd_err_ = COCO_SUCCESS;
+    cid_ = kInvalidContextId;
+    started = interrupted = disposed = cycle_done = false;
+    set_context(nullptr);
+}
+
+bool CoCoroutine::reusable() { return pooled_ && trd_ && !running_ && !exit_; }
+
 void CoCoroutine::set_stack_size(int v) { stack_size = v; }
 
+void CoCoroutine::set_context(CocoContext *ctx) {
+    if (ctx) {
+        ctx->AddRef();
+    }
+    if (ctx_) {
+        ctx_->Release();
+    }
+    ctx_ = ctx;
+}
+
 int32_t CoCoroutine::start() {
     int ret = COCO_SUCCESS;
 
@@ -91,7 +149,17 @@ int32_t CoCoroutine::start() {
         return ERROR_THREAD_DISPOSED;
     }
 
-    if ((trd_ = st_thread_create(coroutine_fun, this, 1, stack_size)) == NULL) {
+    // the parked st thread of pooled coroutine, wakeup to run the new handler.
+    if (pooled_ && trd_) {
+        running_ = started = true;
+        st_cond_signal(wake_);
+        return ret;
+    }
+
+    running_ = pooled_;
+    if ((trd_ = st_thread_create(pooled_ ? pooled_fun : coroutine_fun, this, 1, stack_size)) ==
+        NULL) {
+        running_ = false;
         ret = ERROR_ST_CREATE_CYCLE_THREAD;
         coco_error("StCoroutine st_coroutine_create failed. ret=%d", ret);
         return ret;
@@ -110,8 +178,16 @@ void CoCoroutine::stop() {
 
     interrupt();
 
-    // When not started, the trd is NULL.
-    if (trd_) {
+    // the pooled st thread never exits after cycle, wait for it to park.
+    if (pooled_) {
+        while (running_) {
+            if (st_cond_wait(done_) != 0) {
+                coco_warn("coroutine %s stop interrupted", name.c_str());
+                break;
+            }
+        }
+    } else if (trd_) {
+        // When not started, the trd is NULL.
         void *res = NULL;
         int ret = st_thread_join((st_thread_t)trd_, &res);
         coco_trace("join ret is %d", ret);
@@ -137,6 +213,10 @@ void CoCoroutine::interrupt() {
     if (!started || interrupted || cycle_done) {
         return;
     }
+    // never interrupt the parked st thread of pooled coroutine.
+    if (pooled_ && !running_) {
+        return;
+    }
 
     interrupted = true;
     trd_err_ = ERROR_THREAD_INTERRUPED;
@@ -157,7 +237,27 @@ int CoCoroutine::cycle() {
         coco_trace("coroutine %s cycle start", name.c_str());
     }
 
+    // sample the stack usage of some cycles, to size the new coroutines, only when the
+    // stack size is known.
+    CoroutineStackPolicy *stack = CoroutineStackPolicy::Instance();
+    char entry;
+    char *bottom =
+        stack_size > 0 && stack->ShouldSample() ? stack->Fill(&entry, stack_size) : nullptr;
+
+    if (ctx_) {
+        CocoContext::Switch(ctx_);
+        set_context(nullptr);
+    }
+
+#ifdef COCO_ENABLE_PROFILER
+    CoroutineProfiler::Instance()->Attach(CoroutineLocalGet(), name);
+#endif
     int err = handler->Cycle();
+#ifdef COCO_ENABLE_PROFILER
+    CoroutineProfiler::Instance()->Detach(CoroutineLocalGet());
+#endif
+    CocoContext::Switch(nullptr);
+    stack->Report(name, &entry, bottom);
     if (err != COCO_SUCCESS) {
         return err;
     }
@@ -170,12 +270,12 @@ int CoCoroutine::cycle() {
 
 void *CoCoroutine::coroutine_fun(void *arg) {
     CoCoroutine *p = (CoCoroutine *)arg;
+    CoroutineLocalBind(&p->locals_);
 
     int err = p->cycle();
 
-    if (_st_context) {
-        _st_context->clear_cid();
-    }
+    // free the coroutine local values, and clear the cid.
+    CoroutineLocalClear(&p->locals_);
 
     if (err != COCO_SUCCESS) {
         p->trd_err_ = err;
@@ -184,11 +284,44 @@ void *CoCoroutine::coroutine_fun(void *arg) {
     return &p->trd_err_;
 }
 
+void *CoCoroutine::pooled_fun(void *arg) {
+    CoCoroutine *p = (CoCoroutine *)arg;
+    CoroutineLocalBind(&p->locals_);
+
+    while (true) {
+        int err = p->cycle();
+        CoroutineLocalClear(&p->locals_);
+        if (err != COCO_SUCCESS) {
+            p->trd_err_ = err;
+        }
+
+        // park the st thread and its stack, until the pool starts it again.
+        p->running_ = false;
+        st_cond_signal(p->done_);
+        while (!p->running_ && !p->exit_) {
+            // interrupted when parked, never reuse it.
+            if (st_cond_wait(p->wake_) != 0) {
+                p->exit_ = true;
+            }
+        }
+
+        if (p->exit_) {
+            break;
+        }
+    }
+
+    return &p->trd_err_;
+}
+
 #define SERVER_LISTEN_BACKLOG 512
 
-ListenRoutine::ListenRoutine() { coroutine = new CoCoroutine("listen", this); }
+ListenRoutine::ListenRoutine() {
+    coroutine = new CoCoroutine("listen", this);
+    CocoLifecycle::Instance()->AddListener(this);
+}
 
 ListenRoutine::~ListenRoutine() {
+    CocoLifecycle::Instance()->RemoveListener(this);
     coroutine->stop();
     if (coroutine) {
         delete coroutine;
@@ -196,9 +329,11 @@ ListenRoutine::~ListenRoutine() {
 }
 
 int ListenRoutine::Start() { return coroutine->start(); }
+void ListenRoutine::Stop() { coroutine->stop(); }
 
 ConnRoutine::ConnRoutine(ConnManager *manager) {
-    coroutine = new CoCoroutine("conn", this);
+    // reuse the parked st thread and stack of a finished connection.
+    coroutine = CoroutinePool::Instance()->Acquire("conn", this);
 
     assert(manager != nullptr);
     manager_ = manager;
@@ -207,15 +342,15 @@ ConnRoutine::ConnRoutine(ConnManager *manager) {
 }
 
 ConnRoutine::~ConnRoutine() {
-    coroutine->interrupt();
-
     if (coroutine != NULL) {
-        delete coroutine;
+        CoroutinePool::Instance()->Release(coroutine);
+        coroutine = NULL;
     }
 }
 
 int ConnRoutine::Start() { return coroutine->start(); }
 void ConnRoutine::Stop() { coroutine->stop(); }
+void ConnRoutine::Interrupt() { coroutine->interrupt(); }
 
 int ConnRoutine::Cycle() {
     coco_trace("[TRACE_ANCHOR] Connection, remote addr: %s", GetRemoteAddr().c_str());
@@ -270,7 +405,7 @@ bool st_kqueue_is_supported(void) {
 }
 #endif
 
-int CocoInit() {
+int CocoInit(CocoIoBackend backend) {
     int ret = COCO_SUCCESS;
 
 #ifdef __linux__
@@ -305,12 +440,29 @@ int CocoInit() {
         return ret;
     }
 
-    if (_st_context) {
-        auto cid_ = _st_context->generate_id();
-        _st_context->set_id(cid_);
-        coco_trace("set main routine id: %d", cid_);
+    // bind the coroutine local storage of the primordial coroutine.
+    if ((ret = CoroutineLocalInit()) != COCO_SUCCESS) {
+        return ret;
+    }
+
+    if (_st_context == nullptr) {
+        _st_context = new CoroutineContext();
     }
+    auto cid_ = _st_context->generate_id();
+    _st_context->set_id(cid_);
+    coco_trace("set main routine id: %d", cid_);
     coco_trace("st_init success, use %s", st_get_eventsys_name());
+
+    // the io_uring is optional, the sockets use st when not available.
+    if (backend == CocoIoUring) {
+#if defined(__linux__) && defined(COCO_ENABLE_IO_URING)
+        if (UringRing::Init() != COCO_SUCCESS) {
+            coco_warn("io_uring not available, use %s", st_get_eventsys_name());
+        }
+#else
+        coco_warn("io_uring not built, use %s", st_get_eventsys_name());
+#endif
+    }
     return ret;
 }
 
@@ -322,4 +474,4 @@ void CocoLoopMs(uint64_t dur) {
 }
 void CocoSleepMs(uint64_t durms) { st_usleep(durms * 1000); }
 void CocoSleep(uint32_t durs) { st_usleep(st_utime_t(durs) * 1000 * 1000); }
-int CocoGetCoroutineID() { return _st_context->get_id(); }
+int CocoGetCoroutineID() { return _st_context ? _st_context->get_id() : 0; }
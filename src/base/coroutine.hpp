@@ -1,16 +1,17 @@
 #pragma once
 
-#include <map>
 #include <string>
 
 #include "st.h"
 
+#include "base/coroutine_local.hpp"
 #include "base/coroutine_mgr.hpp"
 #include "common/error.hpp"
 
 const int32_t kInvalidContextId = -1;
 class CoroutineHandler;
 class CoCoroutine;
+class CocoContext;
 
 class CoroutineHandler {
  public:
@@ -25,6 +26,7 @@ class CoroutineHandler {
     CoCoroutine *coroutine;
 };
 
+// the id of coroutine, stored in the coroutine local block.
 class CoroutineContext {
  public:
     CoroutineContext() = default;
@@ -34,9 +36,6 @@ class CoroutineContext {
     virtual int get_id();
     virtual int set_id(int v);
     virtual void clear_cid();
-
- private:
-    std::map<st_thread_t, int> cache_;
 };
 
 class CoCoroutine {
@@ -46,28 +45,54 @@ class CoCoroutine {
     ~CoCoroutine();
 
     void set_stack_size(int v);
+    // run the cycle in ctx, so cancelling ctx interrupts it, see CocoContext.
+    void set_context(CocoContext *ctx);
     int32_t start();
     void stop();
     void interrupt();
     // 在handler cycle中，如果发现 coroutine err了，要退出cycle
     inline int32_t pull() { return trd_err_; }
     int32_t get_cid();
+    const std::string &get_name() { return name; }
 
  private:
+    friend class CoroutinePool;
+    // pooled coroutine, created by CoroutinePool, which parks its st thread and stack
+    // when the cycle is done, and runs the next handler without st_thread_create.
+    CoCoroutine(std::string n, CoroutineHandler *h, bool pooled);
+    // rebind a parked pooled coroutine to a new handler.
+    void reset(const std::string &n, CoroutineHandler *h);
+    // whether the parked st thread can run another handler.
+    bool reusable();
+
     int32_t cycle();
     static void *coroutine_fun(void *arg);
+    static void *pooled_fun(void *arg);
 
     std::string name;
     int stack_size;
     CoroutineHandler *handler;
     st_thread_t trd_;
+    // the coroutine local storage, bound when the coroutine starts.
+    CoroutineLocalData locals_;
     int trd_err_ = COCO_SUCCESS;
     int32_t cid_ = kInvalidContextId;
+    // the context to bind when cycle starts.
+    CocoContext *ctx_ = nullptr;
 
     bool started;
     bool interrupted;
     bool disposed;
     bool cycle_done;
+
+    // for pooled coroutine.
+    bool pooled_ = false;
+    // the handler is running, the st thread is not parked.
+    bool running_ = false;
+    // the parked st thread should exit.
+    bool exit_ = false;
+    st_cond_t wake_ = nullptr;
+    st_cond_t done_ = nullptr;
 };
 
 class ListenRoutine : public CoroutineHandler {
@@ -77,6 +102,8 @@ class ListenRoutine : public CoroutineHandler {
 
     virtual int Cycle() = 0;
     virtual int Start();
+    // stop accepting, called when shutdown.
+    virtual void Stop();
 };
 
 class ConnRoutine : public CoroutineHandler {
@@ -88,6 +115,10 @@ class ConnRoutine : public CoroutineHandler {
     virtual int Start();
     virtual int Cycle();
     virtual void Stop();
+    // interrupt the blocking io, the cycle should quit.
+    virtual void Interrupt();
+    // called when shutdown, quit when idle, or after the current request.
+    virtual void Drain() {}
     virtual std::string GetRemoteAddr() = 0;
 
  protected:
@@ -96,4 +127,15 @@ class ConnRoutine : public CoroutineHandler {
 
  private:
     int id;
+
+ private:
+    friend class ConnManager;
+    enum ConnState { ConnDetached, ConnAlive, ConnZombie };
+    // linked by the manager, no lookup when removed.
+    ConnState conn_state_ = ConnDetached;
+    ConnRoutine *conn_prev_ = nullptr;
+    ConnRoutine *conn_next_ = nullptr;
+    // the admission of conn, released when freed.
+    ConnQuota *conn_quota_ = nullptr;
+    int64_t conn_memory_ = 0;
 };
\ No newline at end of file
@@ -0,0 +1,85 @@
+#include "base/coroutine_local.hpp"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <atomic>
+
+#include "st.h"
+
+#include "base/coroutine.hpp"
+#include "common/error.hpp"
+#include "log/log.hpp"
+
+// the st key of the scheduler in current thread.
+thread_local int _coroutine_local_key = -1;
+// the block of the primordial coroutine, which is not a CoCoroutine.
+thread_local CoroutineLocalData _coroutine_local_main;
+
+static std::atomic<int> _coroutine_local_nb_slots(0);
+static CoroutineLocalDtor _coroutine_local_dtors[COROUTINE_LOCAL_SLOTS];
+
+CoroutineLocalData::CoroutineLocalData() {
+    cid = kInvalidContextId;
+    memset(slots, 0, sizeof(slots));
+    ctx = nullptr;
+}
+
+int CoroutineLocalInit() {
+    int ret = COCO_SUCCESS;
+
+    if (_coroutine_local_key >= 0) {
+        return ret;
+    }
+
+    // no destructor, the block is owned by the coroutine.
+    if (st_key_create(&_coroutine_local_key, NULL) != 0) {
+        ret = ERROR_ST_INITIALIZE;
+        coco_error("create coroutine local key failed. ret=%d", ret);
+        return ret;
+    }
+
+    CoroutineLocalBind(&_coroutine_local_main);
+
+    return ret;
+}
+
+void CoroutineLocalBind(CoroutineLocalData *data) {
+    if (_coroutine_local_key >= 0) {
+        st_thread_setspecific(_coroutine_local_key, data);
+    }
+}
+
+CoroutineLocalData *CoroutineLocalGet() {
+    if (_coroutine_local_key < 0) {
+        return nullptr;
+    }
+    return (CoroutineLocalData *)st_thread_getspecific(_coroutine_local_key);
+}
+
+void CoroutineLocalClear(CoroutineLocalData *data) {
+    int nb_slots = _coroutine_local_nb_slots;
+    for (int i = 0; i < nb_slots; i++) {
+        if (data->slots[i] && _coroutine_local_dtors[i]) {
+            _coroutine_local_dtors[i](data->slots[i]);
+        }
+        data->slots[i] = nullptr;
+    }
+    data->cid = kInvalidContextId;
+}
+
+int CoroutineLocalAllocSlot(CoroutineLocalDtor dtor) {
+    // never count the slot out of bound, which is scanned by CoroutineLocalClear().
+    int slot = _coroutine_local_nb_slots.load();
+    do {
+        if (slot >= COROUTINE_LOCAL_SLOTS) {
+            // increase COROUTINE_LOCAL_SLOTS when you need more, the variables are static, so
+            // there is no way to continue without the slot.
+            coco_error("no coroutine local slot, max=%d", COROUTINE_LOCAL_SLOTS);
+            abort();
+        }
+    } while (!_coroutine_local_nb_slots.compare_exchange_weak(slot, slot + 1));
+
+    _coroutine_local_dtors[slot] = dtor;
+    return slot;
+}
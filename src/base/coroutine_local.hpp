@@ -0,0 +1,88 @@
+#pragma once
+
+#include <stdint.h>
+
+#ifdef COCO_ENABLE_PROFILER
+#include "base/coco_profiler.hpp"
+#endif
+
+class CocoContext;
+
+// the max number of typed slots in the process.
+#define COROUTINE_LOCAL_SLOTS 8
+
+typedef void (*CoroutineLocalDtor)(void *);
+
+/**
+ * the storage block of one coroutine, bound by st thread specific data.
+ * the block is embedded in CoCoroutine, so there's no allocation per coroutine,
+ * and any field is reachable by one st_thread_getspecific and one dereference.
+ */
+struct CoroutineLocalData {
+    CoroutineLocalData();
+
+    int32_t cid;
+    void *slots[COROUTINE_LOCAL_SLOTS];
+    // the deadline and cancellation, see CocoContext.
+    CocoContext *ctx;
+#ifdef COCO_ENABLE_PROFILER
+    CoroutineProfile prof;
+#endif
+};
+
+// create the st key of current scheduler, called by CocoInit().
+extern int CoroutineLocalInit();
+// bind the block to current coroutine.
+extern void CoroutineLocalBind(CoroutineLocalData *data);
+// get the block of current coroutine, nullptr when not bound.
+extern CoroutineLocalData *CoroutineLocalGet();
+// free all slot values of the block, when the coroutine exits.
+extern void CoroutineLocalClear(CoroutineLocalData *data);
+// allocate a slot, the dtor frees the value when the coroutine exits.
+extern int CoroutineLocalAllocSlot(CoroutineLocalDtor dtor);
+
+/**
+ * the typed coroutine local variable, each coroutine sees its own value.
+ * Usage:
+ *       static CoroutineLocal<RequestContext> _req_ctx;
+ *       _req_ctx.set(new RequestContext());
+ *       RequestContext *ctx = _req_ctx.get();
+ * @remark define the variable as static, slots are never freed.
+ */
+template <class T>
+class CoroutineLocal {
+ public:
+    CoroutineLocal() { slot_ = CoroutineLocalAllocSlot(destroy); }
+    virtual ~CoroutineLocal() = default;
+
+    // get the value of current coroutine, nullptr if not set.
+    T *get() {
+        CoroutineLocalData *data = CoroutineLocalGet();
+        return data ? (T *)data->slots[slot_] : nullptr;
+    }
+    // set the value of current coroutine, which takes the ownership and frees the previous.
+    void set(T *v) {
+        CoroutineLocalData *data = CoroutineLocalGet();
+        if (!data) {
+            delete v;
+            return;
+        }
+        delete (T *)data->slots[slot_];
+        data->slots[slot_] = v;
+    }
+    // detach the value of current coroutine, the caller owns it.
+    T *release() {
+        CoroutineLocalData *data = CoroutineLocalGet();
+        if (!data) {
+            return nullptr;
+        }
+        T *v = (T *)data->slots[slot_];
+        data->slots[slot_] = nullptr;
+        return v;
+    }
+
+ private:
+    static void destroy(void *p) { delete (T *)p; }
+
+    int slot_;
+};
@@ -1,45 +1,332 @@
 #include "base/coroutine_mgr.hpp"
 #include "base/coroutine.hpp"
+#include "base/coco_lifecycle.hpp"
+#include "base/coroutine_stack.hpp"
 
 #include "common/error.hpp"
 #include "log/log.hpp"
+#include "utils/utils.hpp"
 
-#include <algorithm>
+#include <errno.h>
 
-ConnManager::~ConnManager() {
-    for (auto conn : conns) {
-        if (conn != nullptr) {
-            delete conn;
-            conn = nullptr;
+#include <atomic>
+#include <vector>
+
+// the admission of all managers, shared by all schedulers.
+static std::atomic<int> _coco_conns(0);
+static std::atomic<int64_t> _coco_conns_memory(0);
+static std::atomic<uint64_t> _coco_conns_rejected(0);
+static std::atomic<uint64_t> _coco_conns_paused(0);
+static std::atomic<int> _coco_max_conns(0);
+static std::atomic<int64_t> _coco_max_memory(0);
+static std::atomic<int64_t> _coco_conn_memory(0);
+
+// the estimated memory of a new connection.
+static int64_t coco_conn_memory() {
+    int64_t v = _coco_conn_memory;
+    if (v > 0) {
+        return v;
+    }
+
+    int stack = CoroutineStackPolicy::Instance()->StackSize("conn");
+    return COCO_CONN_BUFFER_SIZE + (stack > 0 ? stack : COCO_STACK_DEFAULT_SIZE);
+}
+
+// the coroutine to free the zombies of manager.
+class ConnReaper : public CoroutineHandler {
+ public:
+    ConnReaper(ConnManager *manager) : manager_(manager) {
+        coroutine = new CoCoroutine("reaper", this);
+    }
+    virtual ~ConnReaper() { coco_freep(coroutine); }
+
+    int Start() { return coroutine->start(); }
+    virtual int Cycle() {
+        while (!ShouldTermCycle()) {
+            manager_->reap();
+
+            // interrupted when manager destroyed.
+            if (st_cond_wait(manager_->reap_cond_) != 0) {
+                break;
+            }
         }
+        return COCO_SUCCESS;
+    }
+
+ private:
+    ConnManager *manager_;
+};
+
+ConnManager::ConnManager() {
+    conns_ = zombies_ = nullptr;
+    nb_conns_ = nb_zombies_ = 0;
+    nb_pushed_ = nb_reaped_ = 0;
+    visiting_ = 0;
+    reaper_ = nullptr;
+    reap_cond_ = nullptr;
+    admit_cond_ = nullptr;
+    admit_waiting_ = 0;
+
+    // drained when shutdown.
+    CocoLifecycle::Instance()->AddManager(this);
+}
+
+ConnManager::~ConnManager() {
+    CocoLifecycle::Instance()->RemoveManager(this);
+
+    // stop reaper first, we free all connections here.
+    coco_freep(reaper_);
+
+    // detach the connections in cycle, so their Remove is ignored when stopping.
+    ConnRoutine *conn = conns_;
+    conns_ = nullptr;
+    nb_conns_ = 0;
+    while (conn) {
+        ConnRoutine *next = conn->conn_next_;
+        conn->conn_prev_ = conn->conn_next_ = nullptr;
+        conn->conn_state_ = ConnRoutine::ConnDetached;
+        release(conn);
+        conn = next;
+    }
+
+    visiting_ = 0;
+    Destroy();
+
+    if (reap_cond_) {
+        st_cond_destroy(reap_cond_);
+    }
+    if (admit_cond_) {
+        st_cond_destroy(admit_cond_);
     }
 }
 
 void ConnManager::Push(ConnRoutine *conn) {
-    if (std::find(conns.begin(), conns.end(), conn) == conns.end()) {
-        conns.push_back(conn);
+    if (conn->conn_state_ != ConnRoutine::ConnDetached) {
+        return;
     }
+
+    conn->conn_prev_ = nullptr;
+    conn->conn_next_ = conns_;
+    if (conns_) {
+        conns_->conn_prev_ = conn;
+    }
+    conns_ = conn;
+    conn->conn_state_ = ConnRoutine::ConnAlive;
+
+    nb_conns_++;
+    nb_pushed_++;
+
+    // released when freed, for the zombie still holds the stack and buffers.
+    conn->conn_memory_ = coco_conn_memory();
+    _coco_conns++;
+    _coco_conns_memory += conn->conn_memory_;
 }
 
 void ConnManager::Remove(ConnRoutine *conn) {
-    auto it = std::find(conns.begin(), conns.end(), conn);
-
     // removed by destroy, ignore.
-    if (it == conns.end()) {
+    if (conn->conn_state_ != ConnRoutine::ConnAlive) {
         coco_warn("server moved connection, ignore.");
         return;
     }
 
-    conns.erase(it);
-    coco_info("conn removed. conns=%d", (int)conns.size());
-    zombies.push_back(conn);
+    if (conn->conn_prev_) {
+        conn->conn_prev_->conn_next_ = conn->conn_next_;
+    } else {
+        conns_ = conn->conn_next_;
+    }
+    if (conn->conn_next_) {
+        conn->conn_next_->conn_prev_ = conn->conn_prev_;
+    }
+    nb_conns_--;
+
+    conn->conn_prev_ = nullptr;
+    conn->conn_next_ = zombies_;
+    zombies_ = conn;
+    conn->conn_state_ = ConnRoutine::ConnZombie;
+    nb_zombies_++;
+    coco_info("conn removed. conns=%d, zombies=%d", nb_conns_, nb_zombies_);
+
+    // start the reaper in the coroutine of the first removed connection.
+    if (reaper_ == nullptr) {
+        reap_cond_ = st_cond_new();
+        reaper_ = new ConnReaper(this);
+        if (reaper_->Start() != COCO_SUCCESS) {
+            coco_error("start conn reaper failed, free zombies by Destroy()");
+        }
+        return;
+    }
+    st_cond_signal(reap_cond_);
+}
+
+void ConnManager::Destroy() { reap(); }
+
+void ConnManager::reap() {
+    // the visitor may hold the zombies.
+    if (visiting_ > 0) {
+        return;
+    }
+
+    while (zombies_) {
+        ConnRoutine *conn = zombies_;
+        zombies_ = conn->conn_next_;
+        nb_zombies_--;
+
+        conn->conn_next_ = nullptr;
+        conn->conn_state_ = ConnRoutine::ConnDetached;
+        release(conn);
+        nb_reaped_++;
+    }
+
+    // wakeup the paused listeners.
+    if (admit_waiting_ > 0) {
+        st_cond_broadcast(admit_cond_);
+    }
+}
+
+void ConnManager::release(ConnRoutine *conn) {
+    if (conn->conn_quota_) {
+        conn->conn_quota_->conns--;
+        conn->conn_quota_ = nullptr;
+    }
+
+    _coco_conns--;
+    _coco_conns_memory -= conn->conn_memory_;
+    conn->conn_memory_ = 0;
+
+    delete conn;
+}
+
+void ConnManager::ForEach(std::function<void(ConnRoutine *)> fn) {
+    // snapshot the connections, for the fn may yield and the list changes.
+    std::vector<ConnRoutine *> conns;
+    conns.reserve(nb_conns_);
+    for (ConnRoutine *conn = conns_; conn; conn = conn->conn_next_) {
+        conns.push_back(conn);
+    }
+
+    visiting_++;
+    for (auto conn : conns) {
+        if (conn->conn_state_ == ConnRoutine::ConnAlive) {
+            fn(conn);
+        }
+    }
+    visiting_--;
+
+    if (visiting_ == 0 && zombies_ && reap_cond_) {
+        st_cond_signal(reap_cond_);
+    }
+}
+
+ConnManagerStats ConnManager::Stats() {
+    ConnManagerStats s;
+    s.conns = nb_conns_;
+    s.zombies = nb_zombies_;
+    s.pushed = nb_pushed_;
+    s.reaped = nb_reaped_;
+    return s;
+}
+
+void ConnManager::SetLimits(int max_conns, int64_t max_memory) {
+    _coco_max_conns = coco_max(max_conns, 0);
+    _coco_max_memory = coco_max(max_memory, (int64_t)0);
+}
+
+void ConnManager::SetConnMemory(int64_t v) { _coco_conn_memory = coco_max(v, (int64_t)0); }
+
+ConnAdmissionStats ConnManager::AdmissionStats() {
+    ConnAdmissionStats s;
+    s.conns = _coco_conns;
+    s.memory = _coco_conns_memory;
+    s.max_conns = _coco_max_conns;
+    s.max_memory = _coco_max_memory;
+    s.rejected = _coco_conns_rejected;
+    s.paused = _coco_conns_paused;
+    return s;
+}
+
+bool ConnManager::Admit(ConnQuota *quota) {
+    if (quota && quota->max_conns > 0 && quota->conns >= quota->max_conns) {
+        return false;
+    }
+
+    int max_conns = _coco_max_conns;
+    if (max_conns > 0 && _coco_conns >= max_conns) {
+        return false;
+    }
+
+    int64_t max_memory = _coco_max_memory;
+    if (max_memory > 0 && _coco_conns_memory + coco_conn_memory() > max_memory) {
+        return false;
+    }
+
+    return true;
+}
+
+int ConnManager::WaitAdmit(ConnQuota *quota) {
+    int ret = COCO_SUCCESS;
+
+    if (Admit(quota)) {
+        return ret;
+    }
+
+    if (quota) {
+        quota->paused++;
+    }
+    _coco_conns_paused++;
+    coco_warn("conns over limits, pause accepting. conns=%d, memory=%dKB", (int)_coco_conns,
+              (int)(_coco_conns_memory / 1024));
+
+    if (admit_cond_ == nullptr) {
+        admit_cond_ = st_cond_new();
+    }
+
+    st_utime_t starttime = st_utime();
+    admit_waiting_++;
+    while (!Admit(quota)) {
+        // the global limits may be released by other schedulers, so never wait forever.
+        if (st_cond_timedwait(admit_cond_, COCO_ADMIT_RECHECK_US) != 0 && errno == EINTR) {
+            ret = ERROR_ADMIT_INTERRUPTED;
+            break;
+        }
+    }
+    admit_waiting_--;
+
+    if (quota) {
+        quota->paused_us += st_utime() - starttime;
+    }
+    return ret;
+}
+
+void ConnManager::Reject(ConnQuota *quota) {
+    if (quota) {
+        quota->rejected++;
+    }
+    _coco_conns_rejected++;
+}
+
+void ConnManager::Attach(ConnRoutine *conn, ConnQuota *quota) {
+    if (conn->conn_quota_ || conn->conn_state_ == ConnRoutine::ConnDetached) {
+        return;
+    }
+
+    conn->conn_quota_ = quota;
+    quota->conns++;
 }
 
-void ConnManager::Destroy() {
-    for (auto conn : zombies) {
-        if (conn) {
-            delete conn;
+void ConnManager::Detach(ConnQuota *quota) {
+    for (ConnRoutine *conn = conns_; conn; conn = conn->conn_next_) {
+        if (conn->conn_quota_ == quota) {
+            conn->conn_quota_ = nullptr;
+        }
+    }
+    for (ConnRoutine *conn = zombies_; conn; conn = conn->conn_next_) {
+        if (conn->conn_quota_ == quota) {
+            conn->conn_quota_ = nullptr;
         }
     }
-    zombies.clear();
-}
\ No newline at end of file
+    quota->conns = 0;
+}
+
+void CocoSetConnLimits(int max_conns, int64_t max_memory) {
+    ConnManager::SetLimits(max_conns, max_memory);
+}
@@ -1,18 +1,139 @@
 #pragma once
-#include <vector>
+#include <stdint.h>
+
+#include <functional>
+
+#include "st.h"
 
 class ConnRoutine;
+class ConnReaper;
+
+// the recv buffer of a connection, see FastBuffer.
+#define COCO_CONN_BUFFER_SIZE (128 * 1024)
+// the interval to recheck the limits when accepting is paused, which may be released
+// by the managers of other schedulers.
+#define COCO_ADMIT_RECHECK_US (100 * 1000)
+
+// what the listener does when the connections are over the limits.
+enum ConnOverloadPolicy {
+    // stop accepting until some connections are freed, the new ones wait in the backlog.
+    ConnOverloadPause,
+    // accept and close the new ones at once, with a quick rejection, for example http 503.
+    ConnOverloadReject,
+};
 
+// the admission limits and metrics of a listener.
+struct ConnQuota {
+    // the max connections of listener, 0 for unlimited.
+    int max_conns = 0;
+    ConnOverloadPolicy policy = ConnOverloadPause;
+    // the connections accepted and not freed.
+    int conns = 0;
+    // the connections rejected by the limits.
+    uint64_t rejected = 0;
+    // the times and the total duration in us of paused accepting.
+    uint64_t paused = 0;
+    uint64_t paused_us = 0;
+};
+
+// the process-wide admission of all managers.
+struct ConnAdmissionStats {
+    int conns = 0;
+    // the estimated memory of connections, in bytes.
+    int64_t memory = 0;
+    // the limits, 0 for unlimited.
+    int max_conns = 0;
+    int64_t max_memory = 0;
+    uint64_t rejected = 0;
+    uint64_t paused = 0;
+};
+
+struct ConnManagerStats {
+    // the connections in cycle.
+    int conns = 0;
+    // the finished connections, wait for the reaper to free.
+    int zombies = 0;
+    // the total connections pushed.
+    uint64_t pushed = 0;
+    // the total connections freed by reaper or Destroy().
+    uint64_t reaped = 0;
+};
+
+/**
+ * the registry of connections, which links the ConnRoutine intrusively,
+ * so Push and Remove are O(1) without lookup.
+ * the removed connections are freed by a reaper coroutine, which is started
+ * when the first connection is removed, and wakeup on each Remove.
+ */
 class ConnManager {
  public:
-    ConnManager() = default;
+    ConnManager();
     virtual ~ConnManager();
 
     virtual void Push(ConnRoutine *conn);
     virtual void Remove(ConnRoutine *conn);
+    // free all zombies now.
     virtual void Destroy();
 
+ public:
+    /**
+     * visit each connection in cycle, for example to broadcast.
+     * @remark the fn can yield, the connections removed during the visit are skipped,
+     *       and never freed until the visit is done.
+     */
+    void ForEach(std::function<void(ConnRoutine *)> fn);
+    int Size() { return nb_conns_; }
+    ConnManagerStats Stats();
+
+ public:
+    /**
+     * the process-wide limits of connections of all managers, 0 for unlimited.
+     * @param max_memory the memory budget, each connection is estimated by SetConnMemory.
+     */
+    static void SetLimits(int max_conns, int64_t max_memory);
+    // the estimated memory of each connection, 0 for the recv buffer plus the stack.
+    static void SetConnMemory(int64_t v);
+    static ConnAdmissionStats AdmissionStats();
+
+    /**
+     * whether a new connection is allowed by the limits, called before accept.
+     * @param quota the limits of listener, nullptr for none.
+     */
+    bool Admit(ConnQuota *quota);
+    /**
+     * pause until a new connection is allowed, wakeup when connections are freed.
+     * @return ERROR_ADMIT_INTERRUPTED when interrupted, for example the listener is stopped.
+     */
+    int WaitAdmit(ConnQuota *quota);
+    // the new connection is accepted and rejected by the limits.
+    void Reject(ConnQuota *quota);
+    // account the connection to the quota of listener, until freed.
+    void Attach(ConnRoutine *conn, ConnQuota *quota);
+    // the quota is freed with the listener, detach the connections.
+    void Detach(ConnQuota *quota);
+
  private:
-    std::vector<ConnRoutine *> conns;
-    std::vector<ConnRoutine *> zombies;
-};
\ No newline at end of file
+    friend class ConnReaper;
+    // free zombies, until the visits are done.
+    void reap();
+    // release the admission of conn and free it.
+    void release(ConnRoutine *conn);
+
+ private:
+    // the doubly-linked connections in cycle.
+    ConnRoutine *conns_;
+    int nb_conns_;
+    // the singly-linked finished connections.
+    ConnRoutine *zombies_;
+    int nb_zombies_;
+    uint64_t nb_pushed_;
+    uint64_t nb_reaped_;
+    // the number of ForEach in progress.
+    int visiting_;
+
+    ConnReaper *reaper_;
+    st_cond_t reap_cond_;
+    // the listeners paused by the limits.
+    st_cond_t admit_cond_;
+    int admit_waiting_;
+};
@@ -0,0 +1,88 @@
+#include "base/coroutine_pool.hpp"
+
+#include "base/coroutine.hpp"
+#include "base/coroutine_stack.hpp"
+#include "log/log.hpp"
+#include "utils/utils.hpp"
+
+thread_local CoroutinePool *_coroutine_pool = nullptr;
+
+// the stack size of st when 0 is unknown, assume the default.
+static int effective_stack_size(int v) { return v > 0 ? v : COCO_STACK_DEFAULT_SIZE; }
+
+CoroutinePool::CoroutinePool() { max_idle_ = COROUTINE_POOL_MAX_IDLE; }
+
+CoroutinePool::~CoroutinePool() {
+    for (auto co : idle_) {
+        coco_freep(co);
+    }
+    idle_.clear();
+}
+
+CoroutinePool *CoroutinePool::Instance() {
+    if (_coroutine_pool == nullptr) {
+        _coroutine_pool = new CoroutinePool();
+    }
+    return _coroutine_pool;
+}
+
+CoCoroutine *CoroutinePool::Acquire(const std::string &name, CoroutineHandler *handler) {
+    // the adaptive stack size by the samples of name.
+    int stack_size = CoroutineStackPolicy::Instance()->StackSize(name);
+
+    while (!idle_.empty()) {
+        CoCoroutine *co = idle_.back();
+        idle_.pop_back();
+
+        // interrupted when parked, the st thread is gone.
+        if (!co->reusable()) {
+            drops_++;
+            coco_freep(co);
+            continue;
+        }
+
+        // the stack is smaller than the observed usage, never reuse it.
+        if (effective_stack_size(co->stack_size) < effective_stack_size(stack_size)) {
+            drops_++;
+            coco_freep(co);
+            continue;
+        }
+
+        hits_++;
+        co->reset(name, handler);
+        return co;
+    }
+
+    misses_++;
+    CoCoroutine *co = new CoCoroutine(name, handler, true);
+    co->set_stack_size(stack_size);
+    return co;
+}
+
+void CoroutinePool::Release(CoCoroutine *co) {
+    if (co == nullptr) {
+        return;
+    }
+
+    // interrupt the running handler and wait for the st thread to park.
+    co->stop();
+
+    if (!co->reusable() || (int)idle_.size() >= max_idle_) {
+        drops_++;
+        coco_freep(co);
+        return;
+    }
+
+    idle_.push_back(co);
+    coco_dbg("coroutine parked, idle=%d", (int)idle_.size());
+}
+
+CoroutinePoolStats CoroutinePool::Stats() {
+    CoroutinePoolStats s;
+    s.idle = (int)idle_.size();
+    s.max_idle = max_idle_;
+    s.hits = hits_;
+    s.misses = misses_;
+    s.drops = drops_;
+    return s;
+}
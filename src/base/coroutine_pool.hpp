@@ -0,0 +1,63 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+class CoCoroutine;
+class CoroutineHandler;
+
+// the default max number of parked coroutines in pool.
+#define COROUTINE_POOL_MAX_IDLE 1024
+
+struct CoroutinePoolStats {
+    // the parked coroutines, each keeps its st thread and stack.
+    int idle = 0;
+    int max_idle = 0;
+    // acquired from the parked coroutines.
+    uint64_t hits = 0;
+    // created a new st thread and stack.
+    uint64_t misses = 0;
+    // released but freed, for pool is full or the coroutine is not reusable.
+    uint64_t drops = 0;
+
+    // the ratio of hits in all acquires, [0, 1].
+    double hit_rate() { return (hits + misses) ? (double)hits / (hits + misses) : 0; }
+};
+
+/**
+ * the pool of coroutines for connections, to avoid st_thread_create/join, the stack
+ * mmap/munmap and the CoCoroutine allocation for each accepted connection.
+ * a pooled coroutine never exits when the handler cycle is done, it parks the st thread
+ * on its stack, and runs the next handler when acquired again.
+ * @remark the pool belongs to the st scheduler of current thread.
+ */
+class CoroutinePool {
+ public:
+    CoroutinePool();
+    virtual ~CoroutinePool();
+
+    // the pool of current scheduler.
+    static CoroutinePool *Instance();
+
+ public:
+    void SetMaxIdle(int v) { max_idle_ = v; }
+    /**
+     * get a coroutine to run the handler, use start() to run it.
+     */
+    CoCoroutine *Acquire(const std::string &name, CoroutineHandler *handler);
+    /**
+     * stop the coroutine and park it for the next acquire, or free it when pool is full.
+     * @remark the coroutine must not be used after released.
+     */
+    void Release(CoCoroutine *co);
+    CoroutinePoolStats Stats();
+
+ private:
+    std::vector<CoCoroutine *> idle_;
+    int max_idle_;
+    uint64_t hits_ = 0;
+    uint64_t misses_ = 0;
+    uint64_t drops_ = 0;
+};
@@ -0,0 +1,159 @@
+#include "base/coroutine_stack.hpp"
+
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "log/log.hpp"
+#include "utils/utils.hpp"
+
+// the pattern of untouched stack.
+#define COCO_STACK_PATTERN 0xC0
+// the gap below the frame of Fill, for the frames of memset.
+#define COCO_STACK_FILL_GAP 1024
+
+thread_local CoroutineStackPolicy *_coroutine_stack_policy = nullptr;
+
+CoroutineStackPolicy::CoroutineStackPolicy() {
+    sample_rate_ = COCO_STACK_SAMPLE_RATE;
+    cycles_ = 0;
+    adaptive_ = false;
+    min_size_ = COCO_STACK_MIN_SIZE;
+    max_size_ = COCO_STACK_MAX_SIZE;
+    headroom_ = COCO_STACK_HEADROOM;
+}
+
+CoroutineStackPolicy::~CoroutineStackPolicy() {
+    for (auto it : stats_) {
+        delete it.second;
+    }
+    stats_.clear();
+}
+
+CoroutineStackPolicy *CoroutineStackPolicy::Instance() {
+    if (_coroutine_stack_policy == nullptr) {
+        _coroutine_stack_policy = new CoroutineStackPolicy();
+    }
+    return _coroutine_stack_policy;
+}
+
+void CoroutineStackPolicy::SetLimits(int min_size, int max_size, int headroom) {
+    min_size_ = min_size;
+    max_size_ = coco_max(min_size, max_size);
+    headroom_ = headroom;
+
+    for (auto it : stats_) {
+        update(it.second);
+    }
+}
+
+int CoroutineStackPolicy::StackSize(const std::string &name) {
+    if (!adaptive_) {
+        return 0;
+    }
+
+    // before enough samples, still create with an explicit size, or the stack is not sampled.
+    auto it = stats_.find(name);
+    if (it == stats_.end() || it->second->recommended <= 0) {
+        return COCO_STACK_DEFAULT_SIZE;
+    }
+    return it->second->recommended;
+}
+
+std::vector<CoroutineStackStats> CoroutineStackPolicy::Stats() {
+    std::vector<CoroutineStackStats> stats;
+    for (auto it : stats_) {
+        stats.push_back(*it.second);
+    }
+
+    std::sort(stats.begin(), stats.end(),
+              [](const CoroutineStackStats &a, const CoroutineStackStats &b) {
+                  return a.max_used > b.max_used;
+              });
+    return stats;
+}
+
+bool CoroutineStackPolicy::ShouldSample() {
+    return sample_rate_ > 0 && (cycles_++ % sample_rate_) == 0;
+}
+
+__attribute__((noinline)) char *CoroutineStackPolicy::Fill(char *entry, int size) {
+    // the size chosen by st is unknown, never guess it.
+    if (size <= 0) {
+        return nullptr;
+    }
+
+    // the stack grows down, the bottom is below the entry.
+    uintptr_t bottom = (uintptr_t)entry - (size - COCO_STACK_RESERVED);
+    bottom = (bottom + sizeof(uint64_t) - 1) & ~(uintptr_t)(sizeof(uint64_t) - 1);
+
+    // never fill the frame of ourself.
+    char here;
+    uintptr_t top = (uintptr_t)&here - COCO_STACK_FILL_GAP;
+    if (top <= bottom) {
+        return nullptr;
+    }
+
+    memset((void *)bottom, COCO_STACK_PATTERN, top - bottom);
+    return (char *)bottom;
+}
+
+void CoroutineStackPolicy::Report(const std::string &name, char *entry, char *bottom) {
+    if (bottom == nullptr) {
+        return;
+    }
+
+    // the first word touched from the bottom is the high watermark.
+    uint64_t pattern;
+    memset(&pattern, COCO_STACK_PATTERN, sizeof(pattern));
+    uint64_t *p = (uint64_t *)bottom;
+    while ((char *)p < entry && *p == pattern) {
+        p++;
+    }
+
+    CoroutineStackStats *s = stats_of(name);
+    int used = (int)(entry - (char *)p);
+    if ((char *)p == bottom) {
+        s->saturated++;
+        coco_warn("coroutine %s stack may overflow, used=%d", name.c_str(), used);
+    }
+
+    s->samples++;
+    s->total_used += used;
+    s->max_used = coco_max(s->max_used, used);
+    update(s);
+}
+
+CoroutineStackStats *CoroutineStackPolicy::stats_of(const std::string &name) {
+    auto it = stats_.find(name);
+    if (it != stats_.end()) {
+        return it->second;
+    }
+
+    CoroutineStackStats *s = new CoroutineStackStats();
+    s->name = name;
+    stats_[name] = s;
+    return s;
+}
+
+void CoroutineStackPolicy::update(CoroutineStackStats *s) {
+    if (s->samples < COCO_STACK_MIN_SAMPLES) {
+        s->recommended = 0;
+        return;
+    }
+
+    // the saturated sample never tells the real usage, use the max.
+    if (s->saturated) {
+        s->recommended = max_size_;
+        return;
+    }
+
+    // the high watermark plus half of it, at least the headroom, in pages.
+    int size = s->max_used + coco_max(s->max_used / 2, headroom_) + COCO_STACK_RESERVED;
+    int page = (int)sysconf(_SC_PAGESIZE);
+    size = (size + page - 1) / page * page;
+    s->recommended = coco_min(coco_max(size, min_size_), max_size_);
+}
+
+void CocoSetStackAdaptive(bool v) { CoroutineStackPolicy::Instance()->SetAdaptive(v); }
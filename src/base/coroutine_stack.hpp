@@ -0,0 +1,91 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// the stack size of adaptive coroutines before enough samples.
+#define COCO_STACK_DEFAULT_SIZE (64 * 1024)
+// the top of stack reserved by st and the entry frames, never filled.
+#define COCO_STACK_RESERVED (4 * 1024)
+// sample one of every N cycles, 0 to disable.
+#define COCO_STACK_SAMPLE_RATE 256
+// the samples required before adapting the stack size.
+#define COCO_STACK_MIN_SAMPLES 32
+#define COCO_STACK_MIN_SIZE (32 * 1024)
+#define COCO_STACK_MAX_SIZE (1024 * 1024)
+#define COCO_STACK_HEADROOM (16 * 1024)
+
+// the stack usage of coroutines with the same name.
+struct CoroutineStackStats {
+    std::string name;
+    uint64_t samples = 0;
+    // the high watermark of samples, in bytes.
+    int max_used = 0;
+    uint64_t total_used = 0;
+    // the samples used the whole filled stack, which may be overflow.
+    uint64_t saturated = 0;
+    // the stack size for new coroutines, 0 before enough samples.
+    int recommended = 0;
+};
+
+/**
+ * measure the stack usage of coroutines, and size the stack of new coroutines.
+ * a sampled cycle fills the free stack with a pattern, and scans the untouched pattern
+ * when the cycle is done, to get the high watermark, which is aggregated by name.
+ * when adaptive, the stack of new coroutine is the high watermark plus headroom.
+ * @remark only the coroutines with explicit stack size are sampled, so when adaptive, the
+ *       new coroutines use COCO_STACK_DEFAULT_SIZE before enough samples.
+ * @remark the fill touches the whole stack, which makes all pages resident, so only
+ *       one of every N cycles is sampled.
+ * @remark the policy belongs to the st scheduler of current thread.
+ */
+class CoroutineStackPolicy {
+ public:
+    CoroutineStackPolicy();
+    virtual ~CoroutineStackPolicy();
+
+    // the policy of current scheduler.
+    static CoroutineStackPolicy *Instance();
+
+ public:
+    // sample one of every n cycles, 0 to disable.
+    void SetSampleRate(int n) { sample_rate_ = n; }
+    // size the stack of new coroutines by the samples.
+    void SetAdaptive(bool v) { adaptive_ = v; }
+    void SetLimits(int min_size, int max_size, int headroom);
+    // the stack size for the new coroutine of name, 0 for st default when not adaptive.
+    int StackSize(const std::string &name);
+    // the stats by name.
+    std::vector<CoroutineStackStats> Stats();
+
+ public:
+    // whether to sample the cycle.
+    bool ShouldSample();
+    /**
+     * fill the free stack of current coroutine.
+     * @param entry the stack address when the cycle starts.
+     * @param size the stack size of coroutine, passed to st_thread_create.
+     * @return the bottom of the filled stack, nullptr when not filled.
+     * @remark only the coroutine with explicit stack size is filled, for the size chosen
+     *       by st when 0 is unknown.
+     */
+    char *Fill(char *entry, int size);
+    // scan the filled stack, and report the used bytes.
+    void Report(const std::string &name, char *entry, char *bottom);
+
+ private:
+    CoroutineStackStats *stats_of(const std::string &name);
+    void update(CoroutineStackStats *s);
+
+ private:
+    int sample_rate_;
+    uint64_t cycles_;
+    bool adaptive_;
+    int min_size_;
+    int max_size_;
+    int headroom_;
+    std::unordered_map<std::string, CoroutineStackStats *> stats_;
+};
@@ -1,19 +1,98 @@
 #pragma once
 #include <stdint.h>
 
+#include <functional>
+#include <string>
+
 class UdpConn;
 class UdpListener;
 class TcpListener;
 class TcpConn;
+struct SocketOptions;
 
-UdpListener *ListenUdp(std::string local_ip, int local_port);
+// reuse_port opens the socket with SO_REUSEPORT, so each CocoRuntime worker can bind its own shard.
+UdpListener *ListenUdp(std::string local_ip, int local_port, bool reuse_port = false);
 UdpConn *DialUdp(std::string dst_ip, int dst_port, int timeout);
+// with the options of socket, see SocketOptions.
+UdpListener *ListenUdp(std::string local_ip, int local_port, const SocketOptions &opts,
+                       bool reuse_port = false);
+UdpConn *DialUdp(std::string dst_ip, int dst_port, int timeout, const SocketOptions &opts);
 
-TcpListener *ListenTcp(std::string local_ip, int local_port);
+TcpListener *ListenTcp(std::string local_ip, int local_port, bool reuse_port = false);
 TcpConn *DialTcp(std::string dst_ip, int dst_port, int timeout);
+// with the options of socket, which the accepted connections inherit, see SocketOptions.
+// the options are set before listen, except the socket inherited from CocoMaster, which is
+// listening already, so its rcvbuf never changes the window scale of accepted connections.
+TcpListener *ListenTcp(std::string local_ip, int local_port, const SocketOptions &opts,
+                       bool reuse_port = false);
+TcpConn *DialTcp(std::string dst_ip, int dst_port, int timeout, const SocketOptions &opts);
+
+// the io backend of sockets, see CocoInit().
+enum CocoIoBackend {
+    CocoIoEpoll,
+    // io_uring on linux, requires to build with COCO_ENABLE_IO_URING, or fallback to epoll.
+    CocoIoUring,
+};
 
-int CocoInit();
+// initialize the st scheduler of current thread, and the io backend of sockets.
+int CocoInit(CocoIoBackend backend = CocoIoEpoll);
 int CocoGetCoroutineID();
 void CocoLoopMs(uint64_t dur);
+/**
+ * run the scheduler until shutdown, then stop the listeners, wait for the connections
+ * to finish the current request, and interrupt the stragglers at the deadline.
+ * the first scheduler in CocoRun() handles SIGTERM and SIGINT, the second signal
+ * shutdown without waiting.
+ * @return ERROR_SHUTDOWN_TIMEOUT when some connections are still alive.
+ */
+int CocoRun();
+// request all schedulers to shutdown, interrupt the connections after timeout_ms.
+void CocoShutdown(int64_t timeout_ms);
+// whether shutdown is requested, the connections should not keep alive.
+bool CocoIsDraining();
 void CocoSleepMs(uint64_t durms);
-void CocoSleep(uint32_t durs);
\ No newline at end of file
+void CocoSleep(uint32_t durs);
+
+/**
+ * run fn with a deadline after timeout_us, the socket io, dns and connect of fn, and the tasks
+ * of CocoGo() in fn, share the deadline, and are interrupted when fn returns.
+ * @remark the io fails with ERROR_CONTEXT_DEADLINE when the deadline is reached.
+ */
+int CocoWithTimeout(int64_t timeout_us, std::function<int()> fn);
+
+// run fn in a pooled worker coroutine, wait when the task queue is full.
+int CocoGo(std::function<void()> fn);
+// run fn in a pooled worker coroutine, return ERROR_TASK_QUEUE_FULL when the task queue is full.
+int CocoTryGo(std::function<void()> fn);
+// the limits of worker coroutines and queued tasks of current scheduler.
+void CocoSetGoLimits(int min_workers, int max_workers, int max_queue);
+
+// the id of timer, 0 is invalid.
+typedef uint64_t TimerId;
+// fire fn once after ms, in the timer coroutine, so never block in fn.
+TimerId CocoAfter(uint64_t ms, std::function<void()> fn);
+// fire fn every ms, in the timer coroutine, so never block in fn.
+TimerId CocoEvery(uint64_t ms, std::function<void()> fn);
+// cancel the timer, return false when not found or already fired.
+bool CocoCancel(TimerId id);
+
+/**
+ * run the cpu bound fn in the offload thread pool, and park the coroutine until done,
+ * so the scheduler keeps serving other coroutines.
+ * @remark fn runs in another thread, so never touch st or the objects of scheduler in fn.
+ * @return ERROR_OFFLOAD_INTERRUPTED when interrupted, but fn is always done.
+ */
+int CocoOffload(std::function<void()> fn);
+// the threads of offload pool, must be set before the first offload, 0 for the number of cpus.
+void CocoSetOffloadThreads(int v);
+
+// profile the coroutines of current scheduler, requires to build with COCO_ENABLE_PROFILER.
+int CocoProfilerStart();
+// the profile of coroutines by name, in text table.
+std::string CocoProfilerDump();
+
+// size the stack of new conn coroutines by the sampled high watermark of stack usage.
+void CocoSetStackAdaptive(bool v);
+
+// the process-wide limits of connections and their estimated memory in bytes, 0 for unlimited.
+void CocoSetConnLimits(int max_conns, int64_t max_memory);
@@ -77,6 +77,31 @@
 #define ERROR_SOCKET_SETREUSEADDR 1079
 #define ERROR_SOCKET_SETCLOSEEXEC 1080
 #define ERROR_SOCKET_ACCEPT 1081
+#define ERROR_SOCKET_SETREUSEPORT 1082
+#define ERROR_RUNTIME_THREAD_CREATE 1083
+#define ERROR_TASK_QUEUE_FULL 1084
+#define ERROR_TASK_INTERRUPTED 1085
+#define ERROR_CHANNEL_CLOSED 1086
+#define ERROR_CHANNEL_TIMEOUT 1087
+#define ERROR_CHANNEL_FULL 1088
+#define ERROR_CHANNEL_EMPTY 1089
+#define ERROR_CHANNEL_INTERRUPTED 1090
+#define ERROR_OFFLOAD_INIT 1091
+#define ERROR_OFFLOAD_INTERRUPTED 1092
+#define ERROR_PROFILER_DISABLED 1093
+#define ERROR_SHUTDOWN_SIGNAL 1094
+#define ERROR_SHUTDOWN_TIMEOUT 1095
+#define ERROR_ADMIT_INTERRUPTED 1096
+#define ERROR_CONTEXT_CANCELED 1097
+#define ERROR_CONTEXT_DEADLINE 1098
+#define ERROR_URING_INIT 1099
+#define ERROR_URING_SUBMIT 1100
+#define ERROR_MASTER_FORK 1101
+#define ERROR_MASTER_SIGNAL 1102
+#define ERROR_MASTER_UPGRADE 1103
+#define ERROR_SOCKET_SETOPT 1104
+#define ERROR_SOCKET_ZEROCOPY 1105
+#define ERROR_BUFFER_NO_ROOM 1106
 #ifdef SRS_SSL_CLIENT
 #define ERROR_ST_SSL_INIT 1060
 #define ERROR_ST_SSL_HANDSHAKE 1061
@@ -2,10 +2,10 @@
 
 #include <stdarg.h>
 #include <string.h>
-#include <sys/time.h>
 #include <sys/types.h>
 #include <unistd.h>
 
+#include "base/coco_clock.hpp"
 #include "coco_api.h"
 
 FILE *osf = stdout;
@@ -13,28 +13,8 @@ uint64_t debug_mask = 0;
 int log_level = log_trace;
 int cur_pid = getpid();
 
-std::string get_cur_time() {
-  bool utc = false;
-  struct timeval tv;
-  struct timezone tz;
-  gettimeofday(&tv, &tz);
-
-  struct tm local;
-  if (utc) {
-    if (gmtime_r(&tv.tv_sec, &local) == NULL) {
-      return std::string();
-    }
-  } else {
-    if (localtime_r(&tv.tv_sec, &local) == NULL) {
-      return std::string();
-    }
-  }
-  char buffer[128];
-  snprintf(buffer, sizeof(buffer), "%d-%02d-%02d %02d:%02d:%02d.%06lu",
-           1900 + local.tm_year, 1 + local.tm_mon, local.tm_mday, local.tm_hour,
-           local.tm_min, local.tm_sec, tv.tv_usec);
-  return std::string(buffer);
-}
+// the cached time, never format the time for each line.
+std::string get_cur_time() { return std::string(CocoClock::Instance()->LogTime()); }
 
 const char *basefile(const char *file) {
   const char *p = strrchr(file, '/');
@@ -73,7 +53,7 @@ std::string gen_log_header(int lvl, const char *basefile, int line,
                            const char *func) {
   char buffer[128];
   snprintf(buffer, sizeof(buffer), "[%s][%s:%s:%d][%d][%d]",
-           get_cur_time().c_str(), basefile, func, line, cur_pid,
+           CocoClock::Instance()->LogTime(), basefile, func, line, cur_pid,
            CocoGetCoroutineID());
 
   return std::string(buffer);
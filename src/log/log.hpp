@@ -33,6 +33,8 @@ enum LogLevel {
 extern FILE *osf;
 extern uint64_t debug_mask;
 extern int log_level;
+// the pid in log header, reset by the forked worker.
+extern int cur_pid;
 
 std::string get_cur_time();
 const char *basefile(const char *file);
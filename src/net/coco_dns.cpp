@@ -0,0 +1,226 @@
+#include "net/coco_dns.hpp"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <string.h>
+
+#include "base/coco_clock.hpp"
+#include "coco_api.h"
+#include "common/error.hpp"
+#include "log/log.hpp"
+#include "utils/utils.hpp"
+
+thread_local DnsResolver *_dns_resolver = nullptr;
+
+DnsResolver::DnsResolver() {
+    ttl_us_ = COCO_DNS_TTL_US;
+    negative_ttl_us_ = COCO_DNS_NEGATIVE_TTL_US;
+    hits_ = misses_ = numerics_ = coalesced_ = failures_ = 0;
+}
+
+DnsResolver::~DnsResolver() {
+    // the pendings are freed by the resolving coroutines.
+    cache_.clear();
+}
+
+DnsResolver *DnsResolver::Instance() {
+    if (_dns_resolver == nullptr) {
+        _dns_resolver = new DnsResolver();
+    }
+    return _dns_resolver;
+}
+
+int DnsResolver::Resolve(const std::string &host, int port, DnsAddr &addr) {
+    Entry entry;
+
+    // the ip never expires, and never needs the offload threads.
+    if (resolve_numeric(host, entry)) {
+        numerics_++;
+        return pick(host, entry, port, addr);
+    }
+
+    auto it = cache_.find(host);
+    if (it != cache_.end()) {
+        if (it->second.expires > CocoClock::Instance()->MonoUs()) {
+            hits_++;
+            return pick(host, it->second, port, addr);
+        }
+        cache_.erase(it);
+    }
+
+    // the host is in resolving, wait for it.
+    auto pit = pendings_.find(host);
+    if (pit != pendings_.end()) {
+        Pending *pending = pit->second;
+        pending->refs++;
+        coalesced_++;
+
+        while (!pending->done) {
+            if (st_cond_wait(pending->cond) != 0) {
+                break;
+            }
+        }
+        if (pending->done) {
+            entry = pending->result;
+        } else {
+            entry.error = ERROR_SYSTEM_IP_INVALID;
+        }
+
+        if (--pending->refs == 0) {
+            st_cond_destroy(pending->cond);
+            delete pending;
+        }
+        return pick(host, entry, port, addr);
+    }
+
+    misses_++;
+    Pending *pending = new Pending();
+    pending->cond = st_cond_new();
+    pending->refs = 1;
+    pendings_[host] = pending;
+
+    // getaddrinfo blocks the thread, resolve it in the offload threads.
+    CocoOffload([&host, &entry]() { resolve_blocking(host, entry); });
+
+    if (entry.error != COCO_SUCCESS) {
+        failures_++;
+    }
+    entry.expires = CocoClock::Instance()->MonoUs() + (entry.error == COCO_SUCCESS ? ttl_us_ : negative_ttl_us_);
+    shrink();
+    cache_[host] = entry;
+
+    pending->result = entry;
+    pending->done = true;
+    pendings_.erase(host);
+    st_cond_broadcast(pending->cond);
+    if (--pending->refs == 0) {
+        st_cond_destroy(pending->cond);
+        delete pending;
+    }
+
+    return pick(host, entry, port, addr);
+}
+
+void DnsResolver::SetTtl(int64_t ttl_us, int64_t negative_ttl_us) {
+    ttl_us_ = ttl_us;
+    negative_ttl_us_ = negative_ttl_us;
+}
+
+void DnsResolver::Flush(const std::string &host) {
+    if (host.empty()) {
+        cache_.clear();
+        return;
+    }
+    cache_.erase(host);
+}
+
+DnsResolverStats DnsResolver::Stats() {
+    DnsResolverStats s;
+    s.entries = (int)cache_.size();
+    s.hits = hits_;
+    s.misses = misses_;
+    s.numerics = numerics_;
+    s.coalesced = coalesced_;
+    s.failures = failures_;
+    return s;
+}
+
+bool DnsResolver::resolve_numeric(const std::string &host, Entry &entry) {
+    sockaddr_storage addr;
+    memset(&addr, 0, sizeof(addr));
+
+    sockaddr_in *addr4 = (sockaddr_in *)&addr;
+    if (inet_pton(AF_INET, host.c_str(), &addr4->sin_addr) == 1) {
+        addr4->sin_family = AF_INET;
+        entry.addrs.push_back(addr);
+        entry.lens.push_back(sizeof(sockaddr_in));
+        return true;
+    }
+
+    sockaddr_in6 *addr6 = (sockaddr_in6 *)&addr;
+    if (inet_pton(AF_INET6, host.c_str(), &addr6->sin6_addr) == 1) {
+        addr6->sin6_family = AF_INET6;
+        entry.addrs.push_back(addr);
+        entry.lens.push_back(sizeof(sockaddr_in6));
+        return true;
+    }
+
+    return false;
+}
+
+void DnsResolver::resolve_blocking(const std::string &host, Entry &entry) {
+    addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    // the addresses are same for tcp and udp, filter the duplicated.
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo *result = NULL;
+
+    if (getaddrinfo(host.c_str(), NULL, &hints, &result) != 0 || result == NULL) {
+        entry.error = ERROR_SYSTEM_IP_INVALID;
+        return;
+    }
+
+    for (addrinfo *ai = result; ai; ai = ai->ai_next) {
+        if (ai->ai_addrlen > sizeof(sockaddr_storage)) {
+            continue;
+        }
+        sockaddr_storage addr;
+        memset(&addr, 0, sizeof(addr));
+        memcpy(&addr, ai->ai_addr, ai->ai_addrlen);
+        entry.addrs.push_back(addr);
+        entry.lens.push_back(ai->ai_addrlen);
+    }
+    freeaddrinfo(result);
+
+    if (entry.addrs.empty()) {
+        entry.error = ERROR_SYSTEM_IP_INVALID;
+    }
+}
+
+int DnsResolver::pick(const std::string &host, Entry &entry, int port, DnsAddr &addr) {
+    int ret = COCO_SUCCESS;
+
+    if (entry.error != COCO_SUCCESS || entry.addrs.empty()) {
+        ret = ERROR_SYSTEM_IP_INVALID;
+        coco_error("dns resolve %s failed. ret=%d", host.c_str(), ret);
+        return ret;
+    }
+
+    addr.addr = entry.addrs[0];
+    addr.len = entry.lens[0];
+
+    char ip[64];
+    if (addr.addr.ss_family == AF_INET6) {
+        sockaddr_in6 *addr6 = (sockaddr_in6 *)&addr.addr;
+        addr6->sin6_port = htons(port);
+        inet_ntop(AF_INET6, &addr6->sin6_addr, ip, sizeof(ip));
+    } else {
+        sockaddr_in *addr4 = (sockaddr_in *)&addr.addr;
+        addr4->sin_port = htons(port);
+        inet_ntop(AF_INET, &addr4->sin_addr, ip, sizeof(ip));
+    }
+    addr.ip = ip;
+
+    return ret;
+}
+
+void DnsResolver::shrink() {
+    if (cache_.size() < COCO_DNS_MAX_ENTRIES) {
+        return;
+    }
+
+    int64_t now = CocoClock::Instance()->MonoUs();
+    for (auto it = cache_.begin(); it != cache_.end();) {
+        if (it->second.expires <= now) {
+            it = cache_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    // all alive, drop all to keep the memory bounded.
+    if (cache_.size() >= COCO_DNS_MAX_ENTRIES) {
+        cache_.clear();
+    }
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <netdb.h>
+#include <stdint.h>
+#include <sys/socket.h>
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "st.h"
+
+// the ttl of resolved address, getaddrinfo never returns the ttl of record.
+#define COCO_DNS_TTL_US (60 * 1000 * 1000LL)
+// the ttl of failed host, to avoid flooding the dns server.
+#define COCO_DNS_NEGATIVE_TTL_US (5 * 1000 * 1000LL)
+// the max number of cached hosts.
+#define COCO_DNS_MAX_ENTRIES 4096
+
+struct DnsAddr {
+    sockaddr_storage addr;
+    socklen_t len = 0;
+    // the numeric ip, v4 or v6.
+    std::string ip;
+};
+
+struct DnsResolverStats {
+    int entries = 0;
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    // resolved by the numeric fast path.
+    uint64_t numerics = 0;
+    // waited for the same host in resolving.
+    uint64_t coalesced = 0;
+    uint64_t failures = 0;
+};
+
+/**
+ * the dns resolver of scheduler, which never blocks the scheduler.
+ * the numeric host is parsed in place, the others are resolved by getaddrinfo in the
+ * offload threads, and cached with ttl, also the failures with a shorter ttl.
+ * the coroutines resolving the same host wait for the first one, so a host is only
+ * resolved once at a time.
+ * @remark the resolver belongs to the st scheduler of current thread.
+ */
+class DnsResolver {
+ public:
+    DnsResolver();
+    virtual ~DnsResolver();
+
+    // the resolver of current scheduler.
+    static DnsResolver *Instance();
+
+ public:
+    /**
+     * resolve the host to an address with port.
+     * @return ERROR_SYSTEM_IP_INVALID when resolve failed.
+     */
+    int Resolve(const std::string &host, int port, DnsAddr &addr);
+    // the ttl in us, for the resolved and failed hosts.
+    void SetTtl(int64_t ttl_us, int64_t negative_ttl_us);
+    // drop the cached host, or all hosts when empty.
+    void Flush(const std::string &host = "");
+    DnsResolverStats Stats();
+
+ private:
+    struct Entry {
+        // the addresses without port, empty when failed.
+        std::vector<sockaddr_storage> addrs;
+        std::vector<socklen_t> lens;
+        // the expire time by the cached monotonic clock.
+        int64_t expires = 0;
+        int error = 0;
+    };
+    // the host in resolving, shared by the first coroutine and the waiters.
+    struct Pending {
+        st_cond_t cond = nullptr;
+        bool done = false;
+        Entry result;
+        // freed by the last one.
+        int refs = 0;
+    };
+
+    // parse the numeric host in place, return false when not numeric.
+    bool resolve_numeric(const std::string &host, Entry &entry);
+    // resolve the host by getaddrinfo, in offload thread.
+    static void resolve_blocking(const std::string &host, Entry &entry);
+    int pick(const std::string &host, Entry &entry, int port, DnsAddr &addr);
+    // drop the expired hosts when cache is full.
+    void shrink();
+
+ private:
+    int64_t ttl_us_;
+    int64_t negative_ttl_us_;
+    std::unordered_map<std::string, Entry> cache_;
+    std::unordered_map<std::string, Pending *> pendings_;
+
+    uint64_t hits_;
+    uint64_t misses_;
+    uint64_t numerics_;
+    uint64_t coalesced_;
+    uint64_t failures_;
+};
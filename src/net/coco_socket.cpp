@@ -1,16 +1,254 @@
 #include "net/coco_socket.hpp"
 
 #include <assert.h>
+#include <limits.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/socket.h>
 
+#ifdef __linux__
+#include <sys/sendfile.h>
+#endif
+
+#if defined(__linux__) && defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY)
+#include <linux/errqueue.h>
+#define COCO_HAVE_ZEROCOPY
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+#include "base/coco_context.hpp"
 #include "common/error.hpp"
 #include "log/log.hpp"
+#include "net/coco_uring.hpp"
+
+// read by io_uring when enabled, the sockets fallback to st when EAGAIN.
+static ssize_t coco_read(st_netfd_t stfd, void *buf, size_t size, int64_t timeout) {
+#if defined(__linux__) && defined(COCO_ENABLE_IO_URING)
+    UringRing *ring = UringRing::Instance();
+    if (ring) {
+        ssize_t n = ring->Recv(st_netfd_fileno(stfd), buf, size, timeout);
+        if (n >= 0 || errno != EAGAIN) {
+            return n;
+        }
+    }
+#endif
+    return st_read(stfd, buf, size, timeout);
+}
+
+// write all bytes like st_write, by io_uring when enabled.
+static ssize_t coco_write(st_netfd_t stfd, void *buf, size_t size, int64_t timeout) {
+#if defined(__linux__) && defined(COCO_ENABLE_IO_URING)
+    UringRing *ring = UringRing::Instance();
+    if (ring) {
+        char *p = (char *)buf;
+        size_t left = size;
+        while (left > 0) {
+            ssize_t n = ring->Send(st_netfd_fileno(stfd), p, left, timeout);
+            if (n < 0 && errno == EAGAIN) {
+                return st_write(stfd, p, left, timeout) < 0 ? -1 : (ssize_t)size;
+            }
+            if (n < 0) {
+                return -1;
+            }
+            p += n;
+            left -= n;
+        }
+        return (ssize_t)size;
+    }
+#endif
+    return st_write(stfd, buf, size, timeout);
+}
+
+// write all iovs like st_writev, by io_uring when enabled.
+static ssize_t coco_writev(st_netfd_t stfd, const iovec *iov, int iov_size, int64_t timeout) {
+#if defined(__linux__) && defined(COCO_ENABLE_IO_URING)
+    UringRing *ring = UringRing::Instance();
+    if (ring) {
+        ssize_t total = 0;
+        for (int i = 0; i < iov_size; i++) {
+            total += iov[i].iov_len;
+        }
+
+        // copy the iovs only when partially sent.
+        std::vector<iovec> rest;
+        msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = (iovec *)iov;
+        msg.msg_iovlen = iov_size;
+
+        ssize_t sent = 0;
+        while (sent < total) {
+            ssize_t n = ring->Sendmsg(st_netfd_fileno(stfd), &msg, timeout);
+            if (n < 0 && errno == EAGAIN) {
+                return st_writev(stfd, msg.msg_iov, (int)msg.msg_iovlen, timeout) < 0 ? -1 : total;
+            }
+            if (n < 0) {
+                return -1;
+            }
+
+            sent += n;
+            if (sent >= total) {
+                break;
+            }
+            if (rest.empty()) {
+                rest.assign(iov, iov + iov_size);
+                msg.msg_iov = rest.data();
+            }
+            // skip the sent iovs.
+            while (n > 0 || msg.msg_iov->iov_len == 0) {
+                size_t nn = coco_min((size_t)n, msg.msg_iov->iov_len);
+                msg.msg_iov->iov_base = (char *)msg.msg_iov->iov_base + nn;
+                msg.msg_iov->iov_len -= nn;
+                n -= nn;
+                if (msg.msg_iov->iov_len == 0) {
+                    msg.msg_iov++;
+                    msg.msg_iovlen--;
+                }
+            }
+        }
+        return total;
+    }
+#endif
+    return st_writev(stfd, iov, iov_size, timeout);
+}
 
 CocoSocket::CocoSocket(st_netfd_t client_stfd) {
     stfd = client_stfd;
     send_timeout = recv_timeout = ST_UTIME_NO_TIMEOUT;
     recv_bytes = send_bytes = 0;
+    zerocopy = false;
+    zerocopy_threshold = COCO_ZEROCOPY_THRESHOLD;
+    zerocopy_seq = 0;
+    write_buffer_size = 0;
+    write_busy = false;
+    write_cond = nullptr;
+    flush_scheduled = false;
+}
+
+/**
+ * the coroutine to flush the write buffers of current tick, which is signalled by the first
+ * buffered write, and runs after the runnable coroutines, so the writes of a tick are sent by
+ * one syscall, and never wait for a read of the socket.
+ * @remark the switch callback of st can not do io, so the flush is done by a coroutine.
+ */
+class CocoWriteFlusher : public CoroutineHandler {
+ public:
+    CocoWriteFlusher() {
+        cond_ = st_cond_new();
+        coroutine = new CoCoroutine("flusher", this);
+    }
+    virtual ~CocoWriteFlusher() {
+        coco_freep(coroutine);
+        st_cond_destroy(cond_);
+    }
+
+    // the flusher of current thread, nullptr when failed to start.
+    static CocoWriteFlusher *Instance();
+
+    void Schedule(CocoSocket *skt) {
+        pending_.push_back(skt);
+        if (pending_.size() == 1) {
+            st_cond_signal(cond_);
+        }
+    }
+    // the socket is freed, never flush it.
+    void Cancel(CocoSocket *skt) {
+        std::replace(pending_.begin(), pending_.end(), skt, (CocoSocket *)nullptr);
+        std::replace(flushing_.begin(), flushing_.end(), skt, (CocoSocket *)nullptr);
+    }
+
+    virtual int Cycle() {
+        while (!ShouldTermCycle()) {
+            if (pending_.empty() && st_cond_wait(cond_) != 0) {
+                break;
+            }
+
+            // the flush may yield, and the sockets of next tick are scheduled to pending.
+            flushing_.swap(pending_);
+            for (size_t i = 0; i < flushing_.size(); i++) {
+                CocoSocket *skt = flushing_[i];
+                if (skt == nullptr) {
+                    continue;
+                }
+                // the error is reported by the next io of socket. the busy one is never waited,
+                // for the socket may be freed, and the sender drains the buffer anyway.
+                skt->flush_scheduled = false;
+                if (!skt->write_busy) {
+                    skt->Flush();
+                }
+            }
+            flushing_.clear();
+        }
+        return COCO_SUCCESS;
+    }
+
+ private:
+    st_cond_t cond_;
+    std::vector<CocoSocket *> pending_;
+    std::vector<CocoSocket *> flushing_;
+};
+
+thread_local CocoWriteFlusher *_coco_write_flusher = nullptr;
+thread_local bool _coco_write_flusher_failed = false;
+
+CocoWriteFlusher *CocoWriteFlusher::Instance() {
+    if (_coco_write_flusher == nullptr && !_coco_write_flusher_failed) {
+        CocoWriteFlusher *flusher = new CocoWriteFlusher();
+        if (flusher->coroutine->start() != COCO_SUCCESS) {
+            coco_warn("start write flusher failed, flush by reads only");
+            coco_freep(flusher);
+            _coco_write_flusher_failed = true;
+            return nullptr;
+        }
+        _coco_write_flusher = flusher;
+    }
+    return _coco_write_flusher;
 }
 
+// the zero copy buffers leaked by all sockets.
+static std::atomic<uint64_t> _coco_zerocopy_abandoned(0);
+
+CocoSocket::~CocoSocket() {
+    // the last chance to send the buffered bytes, the socket is closed after us, and never
+    // free the buffer which other coroutine is sending.
+    wait_write_idle(false);
+    if (flush_scheduled) {
+        CocoWriteFlusher::Instance()->Cancel(this);
+    }
+    if (!write_buffer.empty() && Flush() != COCO_SUCCESS) {
+        coco_warn("drop the buffered bytes, fd=%d", get_osfd());
+    }
+    if (write_cond) {
+        st_cond_destroy(write_cond);
+    }
+
+    if (zerocopy_pendings.empty()) {
+        return;
+    }
+
+    // the last chance, the socket is closed after us, so wait a while for the kernel.
+    if (WaitZeroCopy(COCO_ZEROCOPY_CLOSE_WAIT_US) == COCO_SUCCESS) {
+        return;
+    }
+
+    // the kernel may still read the buffers to transmit, never release them, leak instead.
+    int nb_leaked = (int)zerocopy_pendings.size();
+    zerocopy_stats.abandoned += nb_leaked;
+    _coco_zerocopy_abandoned += nb_leaked;
+    coco_warn("leak %d zero copy buffers not completed, fd=%d", nb_leaked, get_osfd());
+    for (auto &p : zerocopy_pendings) {
+        // the release may own the buffer, so it is never destroyed either.
+        new std::function<void()>(std::move(p.release));
+    }
+    zerocopy_pendings.clear();
+}
+
+uint64_t CocoSocket::GetZeroCopyAbandoned() { return _coco_zerocopy_abandoned; }
+
 bool CocoSocket::is_never_timeout(int64_t timeout_us) {
     return timeout_us == (int64_t)ST_UTIME_NO_TIMEOUT;
 }
@@ -32,7 +270,26 @@ int CocoSocket::get_osfd() { return st_netfd_fileno(stfd); }
 int CocoSocket::Read(void *buf, size_t size, ssize_t *nread) {
     int ret = COCO_SUCCESS;
 
-    ssize_t nb_read = st_read(stfd, buf, size, recv_timeout);
+    // the peer never responds to the request left in buffer.
+    if ((ret = Flush()) != COCO_SUCCESS) {
+        return ret;
+    }
+
+    // the io is limited by the deadline of coroutine context.
+    int64_t timeout;
+    if ((ret = CocoContext::IoTimeout(recv_timeout, &timeout)) != COCO_SUCCESS) {
+        return ret;
+    }
+
+    ssize_t nb_read = 0;
+    if (reaping()) {
+        iovec iov;
+        iov.iov_base = buf;
+        iov.iov_len = size;
+        nb_read = readv_reaping(&iov, 1, timeout);
+    } else {
+        nb_read = coco_read(stfd, buf, size, timeout);
+    }
     if (nread) {
         *nread = nb_read;
     }
@@ -44,14 +301,50 @@ int CocoSocket::Read(void *buf, size_t size, ssize_t *nread) {
     if (nb_read <= 0) {
         // @see https://github.com/ossrs/srs/issues/200
         if (nb_read < 0 && errno == ETIME) {
-            return ERROR_SOCKET_TIMEOUT;
+            return CocoContext::IoError(ERROR_SOCKET_TIMEOUT);
+        }
+
+        if (nb_read == 0) {
+            errno = ECONNRESET;
+        }
+
+        return CocoContext::IoError(ERROR_SOCKET_READ);
+    }
+
+    recv_bytes += nb_read;
+
+    return ret;
+}
+
+int CocoSocket::Readv(const iovec *iov, int iov_size, ssize_t *nread) {
+    int ret = COCO_SUCCESS;
+
+    if ((ret = Flush()) != COCO_SUCCESS) {
+        return ret;
+    }
+
+    int64_t timeout;
+    if ((ret = CocoContext::IoTimeout(recv_timeout, &timeout)) != COCO_SUCCESS) {
+        return ret;
+    }
+
+    ssize_t nb_read = reaping() ? readv_reaping(iov, iov_size, timeout)
+                                : st_readv(stfd, iov, iov_size, timeout);
+    if (nread) {
+        *nread = nb_read;
+    }
+
+    if (nb_read <= 0) {
+        // @see https://github.com/ossrs/srs/issues/200
+        if (nb_read < 0 && errno == ETIME) {
+            return CocoContext::IoError(ERROR_SOCKET_TIMEOUT);
         }
 
         if (nb_read == 0) {
             errno = ECONNRESET;
         }
 
-        return ERROR_SOCKET_READ;
+        return CocoContext::IoError(ERROR_SOCKET_READ);
     }
 
     recv_bytes += nb_read;
@@ -62,7 +355,32 @@ int CocoSocket::Read(void *buf, size_t size, ssize_t *nread) {
 int CocoSocket::ReadFully(void *buf, size_t size, ssize_t *nread) {
     int ret = COCO_SUCCESS;
 
-    ssize_t nb_read = st_read_fully(stfd, buf, size, recv_timeout);
+    if ((ret = Flush()) != COCO_SUCCESS) {
+        return ret;
+    }
+
+    int64_t timeout;
+    if ((ret = CocoContext::IoTimeout(recv_timeout, &timeout)) != COCO_SUCCESS) {
+        return ret;
+    }
+
+    ssize_t nb_read = 0;
+    if (reaping()) {
+        // read until full or eof, like st_read_fully.
+        while (nb_read < (ssize_t)size) {
+            iovec iov;
+            iov.iov_base = (char *)buf + nb_read;
+            iov.iov_len = size - nb_read;
+            ssize_t n = readv_reaping(&iov, 1, timeout);
+            if (n <= 0) {
+                nb_read = n < 0 ? n : nb_read;
+                break;
+            }
+            nb_read += n;
+        }
+    } else {
+        nb_read = st_read_fully(stfd, buf, size, timeout);
+    }
     if (nread) {
         *nread = nb_read;
     }
@@ -74,14 +392,14 @@ int CocoSocket::ReadFully(void *buf, size_t size, ssize_t *nread) {
     if (nb_read != (ssize_t)size) {
         // @see https://github.com/ossrs/srs/issues/200
         if (nb_read < 0 && errno == ETIME) {
-            return ERROR_SOCKET_TIMEOUT;
+            return CocoContext::IoError(ERROR_SOCKET_TIMEOUT);
         }
 
         if (nb_read >= 0) {
             errno = ECONNRESET;
         }
 
-        return ERROR_SOCKET_READ_FULLY;
+        return CocoContext::IoError(ERROR_SOCKET_READ_FULLY);
     }
 
     recv_bytes += nb_read;
@@ -90,9 +408,168 @@ int CocoSocket::ReadFully(void *buf, size_t size, ssize_t *nread) {
 }
 
 int CocoSocket::Write(void *buf, size_t size, ssize_t *nwrite) {
+    if (write_buffer_size > 0) {
+        iovec iov;
+        iov.iov_base = buf;
+        iov.iov_len = size;
+        return write_buffered(&iov, 1, nwrite);
+    }
+    return write_direct(buf, size, nwrite);
+}
+
+int CocoSocket::Writev(const iovec *iov, int iov_size, ssize_t *nwrite) {
+    if (write_buffer_size > 0) {
+        return write_buffered(iov, iov_size, nwrite);
+    }
+    return writev_direct(iov, iov_size, nwrite);
+}
+
+int CocoSocket::EnableWriteBuffer(size_t size) {
+    int ret = COCO_SUCCESS;
+
+    if (size == 0) {
+        ret = Flush();
+        write_buffer_size = 0;
+        std::vector<char>().swap(write_buffer);
+        return ret;
+    }
+
+    write_buffer_size = size;
+    write_buffer.reserve(size);
+    write_sending.reserve(size);
+    if (write_cond == nullptr) {
+        write_cond = st_cond_new();
+    }
+    return ret;
+}
+
+int CocoSocket::Flush() {
     int ret = COCO_SUCCESS;
 
-    ssize_t nb_write = st_write(stfd, buf, size, send_timeout);
+    // the bytes being sent by other coroutine go ahead, so the writes after are in order.
+    if ((ret = wait_write_idle(true)) != COCO_SUCCESS) {
+        return ret;
+    }
+    if (write_buffer.empty()) {
+        return ret;
+    }
+
+    write_busy = true;
+    ret = drain_write_buffer();
+    write_busy = false;
+    st_cond_broadcast(write_cond);
+
+    return ret;
+}
+
+int CocoSocket::drain_write_buffer() {
+    int ret = COCO_SUCCESS;
+
+    // the writes may yield, and the other coroutines append to the fresh buffer.
+    while (ret == COCO_SUCCESS && !write_buffer.empty()) {
+        write_sending.swap(write_buffer);
+        ret = write_direct(write_sending.data(), write_sending.size(), nullptr);
+        write_sending.clear();
+    }
+
+    // the buffer is dropped when failed, the connection is broken.
+    write_buffer.clear();
+    return ret;
+}
+
+int CocoSocket::wait_write_idle(bool interruptible) {
+    while (write_busy) {
+        if (st_cond_wait(write_cond) != 0 && interruptible) {
+            return CocoContext::IoError(ERROR_SOCKET_WRITE);
+        }
+    }
+    return COCO_SUCCESS;
+}
+
+int CocoSocket::write_buffered(const iovec *iov, int iov_size, ssize_t *nwrite) {
+    int ret = COCO_SUCCESS;
+
+    size_t size = 0;
+    for (int i = 0; i < iov_size; i++) {
+        size += iov[i].iov_len;
+    }
+
+    // the other coroutine is sending, append to the buffer, which it sends next in order.
+    if (write_busy || write_buffer.size() + size < write_buffer_size) {
+        for (int i = 0; i < iov_size; i++) {
+            const char *p = (const char *)iov[i].iov_base;
+            write_buffer.insert(write_buffer.end(), p, p + iov[i].iov_len);
+        }
+        // flush at the end of tick, without waiting for a read of the socket.
+        if (!flush_scheduled && !write_busy) {
+            CocoWriteFlusher *flusher = CocoWriteFlusher::Instance();
+            flush_scheduled = flusher != nullptr;
+            if (flusher) {
+                flusher->Schedule(this);
+            }
+        }
+        if (nwrite) {
+            *nwrite = (ssize_t)size;
+        }
+        return ret;
+    }
+
+    write_busy = true;
+
+    if (iov_size >= IOV_MAX) {
+        // too many iovs to prepend the buffer, send it first.
+        if ((ret = drain_write_buffer()) == COCO_SUCCESS) {
+            ret = writev_direct(iov, iov_size, nullptr);
+        }
+    } else {
+        // the buffered bytes go ahead of the large write, by one syscall.
+        write_sending.swap(write_buffer);
+        write_iovs.clear();
+        if (!write_sending.empty()) {
+            iovec head;
+            head.iov_base = write_sending.data();
+            head.iov_len = write_sending.size();
+            write_iovs.push_back(head);
+        }
+        write_iovs.insert(write_iovs.end(), iov, iov + iov_size);
+
+        ret = writev_direct(write_iovs.data(), (int)write_iovs.size(), nullptr);
+        write_sending.clear();
+    }
+
+    // the bytes appended by others while sending.
+    if (ret == COCO_SUCCESS) {
+        ret = drain_write_buffer();
+    } else {
+        write_buffer.clear();
+    }
+
+    write_busy = false;
+    st_cond_broadcast(write_cond);
+
+    if (ret == COCO_SUCCESS && nwrite) {
+        *nwrite = (ssize_t)size;
+    }
+    return ret;
+}
+
+int CocoSocket::write_direct(void *buf, size_t size, ssize_t *nwrite) {
+    int ret = COCO_SUCCESS;
+
+    int64_t timeout;
+    if ((ret = CocoContext::IoTimeout(send_timeout, &timeout)) != COCO_SUCCESS) {
+        return ret;
+    }
+
+    ssize_t nb_write = 0;
+    if (reaping()) {
+        iovec iov;
+        iov.iov_base = buf;
+        iov.iov_len = size;
+        nb_write = writev_reaping(&iov, 1, timeout);
+    } else {
+        nb_write = coco_write(stfd, buf, size, timeout);
+    }
     if (nwrite) {
         *nwrite = nb_write;
     }
@@ -103,10 +580,10 @@ int CocoSocket::Write(void *buf, size_t size, ssize_t *nwrite) {
     if (nb_write <= 0) {
         // @see https://github.com/ossrs/srs/issues/200
         if (nb_write < 0 && errno == ETIME) {
-            return ERROR_SOCKET_TIMEOUT;
+            return CocoContext::IoError(ERROR_SOCKET_TIMEOUT);
         }
 
-        return ERROR_SOCKET_WRITE;
+        return CocoContext::IoError(ERROR_SOCKET_WRITE);
     }
 
     send_bytes += nb_write;
@@ -114,10 +591,16 @@ int CocoSocket::Write(void *buf, size_t size, ssize_t *nwrite) {
     return ret;
 }
 
-int CocoSocket::Writev(const iovec *iov, int iov_size, ssize_t *nwrite) {
+int CocoSocket::writev_direct(const iovec *iov, int iov_size, ssize_t *nwrite) {
     int ret = COCO_SUCCESS;
 
-    ssize_t nb_write = st_writev(stfd, iov, iov_size, send_timeout);
+    int64_t timeout;
+    if ((ret = CocoContext::IoTimeout(send_timeout, &timeout)) != COCO_SUCCESS) {
+        return ret;
+    }
+
+    ssize_t nb_write = reaping() ? writev_reaping(iov, iov_size, timeout)
+                                 : coco_writev(stfd, iov, iov_size, timeout);
     if (nwrite) {
         *nwrite = nb_write;
     }
@@ -128,21 +611,86 @@ int CocoSocket::Writev(const iovec *iov, int iov_size, ssize_t *nwrite) {
     if (nb_write <= 0) {
         // @see https://github.com/ossrs/srs/issues/200
         if (nb_write < 0 && errno == ETIME) {
-            return ERROR_SOCKET_TIMEOUT;
+            return CocoContext::IoError(ERROR_SOCKET_TIMEOUT);
         }
 
-        return ERROR_SOCKET_WRITE;
+        return CocoContext::IoError(ERROR_SOCKET_WRITE);
+    }
+
+    send_bytes += nb_write;
+
+    return ret;
+}
+
+int CocoSocket::SendFile(int fd, off_t offset, size_t size, ssize_t *nwrite) {
+    int ret = COCO_SUCCESS;
+
+    // the file follows the buffered bytes.
+    if ((ret = Flush()) != COCO_SUCCESS) {
+        return ret;
+    }
+
+#ifndef __linux__
+    return IoWriter::SendFile(fd, offset, size, nwrite);
+#else
+    int64_t timeout;
+    if ((ret = CocoContext::IoTimeout(send_timeout, &timeout)) != COCO_SUCCESS) {
+        return ret;
     }
 
+    // the socket of st is non-blocking, wait for writable when the send buffer is full.
+    int osfd = get_osfd();
+    size_t left = size;
+    while (left > 0) {
+        ssize_t n = ::sendfile(osfd, fd, &offset, left);
+        if (n > 0) {
+            left -= n;
+            continue;
+        }
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0 && errno == EAGAIN) {
+            if (st_netfd_poll(stfd, POLLOUT, timeout) < 0) {
+                break;
+            }
+            reap_zerocopy();
+            continue;
+        }
+        // the file is truncated, never block on it.
+        if (n == 0) {
+            errno = EIO;
+        }
+        break;
+    }
+
+    ssize_t nb_write = (ssize_t)(size - left);
+    if (nwrite) {
+        *nwrite = nb_write;
+    }
     send_bytes += nb_write;
 
+    if (left > 0) {
+        // @see https://github.com/ossrs/srs/issues/200
+        if (errno == ETIME) {
+            return CocoContext::IoError(ERROR_SOCKET_TIMEOUT);
+        }
+        return CocoContext::IoError(ERROR_SOCKET_WRITE);
+    }
+
     return ret;
+#endif
 }
 
 int CocoSocket::recvfrom(void *buf, int size, ssize_t *nread, struct sockaddr *from, int *fromlen) {
     int ret = COCO_SUCCESS;
 
-    ssize_t nb_read = st_recvfrom(stfd, buf, size, from, fromlen, recv_timeout);
+    int64_t timeout;
+    if ((ret = CocoContext::IoTimeout(recv_timeout, &timeout)) != COCO_SUCCESS) {
+        return ret;
+    }
+
+    ssize_t nb_read = st_recvfrom(stfd, buf, size, from, fromlen, timeout);
     if (nread) {
         *nread = nb_read;
     }
@@ -154,14 +702,14 @@ int CocoSocket::recvfrom(void *buf, int size, ssize_t *nread, struct sockaddr *f
     if (nb_read <= 0) {
         // @see https://github.com/ossrs/srs/issues/200
         if (nb_read < 0 && errno == ETIME) {
-            return ERROR_SOCKET_TIMEOUT;
+            return CocoContext::IoError(ERROR_SOCKET_TIMEOUT);
         }
 
         if (nb_read == 0) {
             errno = ECONNRESET;
         }
 
-        return ERROR_SOCKET_READ;
+        return CocoContext::IoError(ERROR_SOCKET_READ);
     }
 
     recv_bytes += nb_read;
@@ -172,7 +720,12 @@ int CocoSocket::recvfrom(void *buf, int size, ssize_t *nread, struct sockaddr *f
 int CocoSocket::sendto(void *buf, int size, ssize_t *nwrite, struct sockaddr *to, int tolen) {
     int ret = COCO_SUCCESS;
 
-    ssize_t nb_write = st_sendto(stfd, buf, size, to, tolen, send_timeout);
+    int64_t timeout;
+    if ((ret = CocoContext::IoTimeout(send_timeout, &timeout)) != COCO_SUCCESS) {
+        return ret;
+    }
+
+    ssize_t nb_write = st_sendto(stfd, buf, size, to, tolen, timeout);
     if (nwrite) {
         *nwrite = nb_write;
     }
@@ -183,10 +736,10 @@ int CocoSocket::sendto(void *buf, int size, ssize_t *nwrite, struct sockaddr *to
     if (nb_write <= 0) {
         // @see https://github.com/ossrs/srs/issues/200
         if (nb_write < 0 && errno == ETIME) {
-            return ERROR_SOCKET_TIMEOUT;
+            return CocoContext::IoError(ERROR_SOCKET_TIMEOUT);
         }
 
-        return ERROR_SOCKET_WRITE;
+        return CocoContext::IoError(ERROR_SOCKET_WRITE);
     }
 
     send_bytes += nb_write;
@@ -197,7 +750,12 @@ int CocoSocket::sendto(void *buf, int size, ssize_t *nwrite, struct sockaddr *to
 int CocoSocket::recvmsg(ssize_t *nread, struct msghdr *msg, int flags) {
     int ret = COCO_SUCCESS;
 
-    ssize_t nb_read = st_recvmsg(stfd, msg, flags, recv_timeout);
+    int64_t timeout;
+    if ((ret = CocoContext::IoTimeout(recv_timeout, &timeout)) != COCO_SUCCESS) {
+        return ret;
+    }
+
+    ssize_t nb_read = st_recvmsg(stfd, msg, flags, timeout);
     if (nread) {
         *nread = nb_read;
     }
@@ -209,14 +767,14 @@ int CocoSocket::recvmsg(ssize_t *nread, struct msghdr *msg, int flags) {
     if (nb_read <= 0) {
         // @see https://github.com/ossrs/srs/issues/200
         if (nb_read < 0 && errno == ETIME) {
-            return ERROR_SOCKET_TIMEOUT;
+            return CocoContext::IoError(ERROR_SOCKET_TIMEOUT);
         }
 
         if (nb_read == 0) {
             errno = ECONNRESET;
         }
 
-        return ERROR_SOCKET_READ;
+        return CocoContext::IoError(ERROR_SOCKET_READ);
     }
 
     recv_bytes += nb_read;
@@ -227,7 +785,12 @@ int CocoSocket::recvmsg(ssize_t *nread, struct msghdr *msg, int flags) {
 int CocoSocket::sendmsg(ssize_t *nwrite, struct msghdr *msg, int flags) {
     int ret = COCO_SUCCESS;
 
-    ssize_t nb_write = st_sendmsg(stfd, msg, flags, send_timeout);
+    int64_t timeout;
+    if ((ret = CocoContext::IoTimeout(send_timeout, &timeout)) != COCO_SUCCESS) {
+        return ret;
+    }
+
+    ssize_t nb_write = st_sendmsg(stfd, msg, flags, timeout);
     if (nwrite) {
         *nwrite = nb_write;
     }
@@ -238,13 +801,302 @@ int CocoSocket::sendmsg(ssize_t *nwrite, struct msghdr *msg, int flags) {
     if (nb_write <= 0) {
         // @see https://github.com/ossrs/srs/issues/200
         if (nb_write < 0 && errno == ETIME) {
-            return ERROR_SOCKET_TIMEOUT;
+            return CocoContext::IoError(ERROR_SOCKET_TIMEOUT);
         }
 
-        return ERROR_SOCKET_WRITE;
+        return CocoContext::IoError(ERROR_SOCKET_WRITE);
     }
 
     send_bytes += nb_write;
 
     return ret;
-}
\ No newline at end of file
+}
+int CocoSocket::EnableZeroCopy(size_t threshold) {
+    int ret = COCO_SUCCESS;
+
+    zerocopy_threshold = threshold;
+    if (zerocopy) {
+        return ret;
+    }
+
+#ifdef COCO_HAVE_ZEROCOPY
+    int v = 1;
+    if (setsockopt(get_osfd(), SOL_SOCKET, SO_ZEROCOPY, &v, sizeof(v)) == -1) {
+        ret = ERROR_SOCKET_ZEROCOPY;
+        coco_warn("enable zero copy failed, errno=%d. ret=%d", errno, ret);
+        return ret;
+    }
+    zerocopy = true;
+#else
+    ret = ERROR_SOCKET_ZEROCOPY;
+#endif
+    return ret;
+}
+
+int CocoSocket::WriteZeroCopy(const void *buf, size_t size, std::function<void()> release,
+                              ssize_t *nwrite) {
+    int ret = COCO_SUCCESS;
+
+    reap_zerocopy();
+
+    if (!zerocopy || size < zerocopy_threshold) {
+        zerocopy_stats.fallbacks++;
+        ret = Write((void *)buf, size, nwrite);
+        if (release) {
+            release();
+        }
+        return ret;
+    }
+
+#ifdef COCO_HAVE_ZEROCOPY
+    int64_t timeout;
+    if ((ret = Flush()) != COCO_SUCCESS ||
+        (ret = CocoContext::IoTimeout(send_timeout, &timeout)) != COCO_SUCCESS) {
+        if (release) {
+            release();
+        }
+        return ret;
+    }
+
+    int fd = get_osfd();
+    const char *p = (const char *)buf;
+    size_t left = size;
+    uint64_t lo = zerocopy_seq;
+    while (left > 0) {
+        ssize_t n = ::send(fd, p, left, MSG_ZEROCOPY | MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (n > 0) {
+            zerocopy_seq++;
+            p += n;
+            left -= n;
+            continue;
+        }
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0 && errno == EAGAIN) {
+            if (st_netfd_poll(stfd, POLLOUT, timeout) < 0) {
+                break;
+            }
+            // the wake may be POLLERR of the completions, reap them or it never sleeps.
+            reap_zerocopy();
+            continue;
+        }
+        // the optmem of notifications is used up, copy the rest.
+        if (n < 0 && errno == ENOBUFS) {
+            zerocopy_stats.fallbacks++;
+            iovec iov;
+            iov.iov_base = (void *)p;
+            iov.iov_len = left;
+            if (writev_reaping(&iov, 1, timeout) == (ssize_t)left) {
+                p += left;
+                left = 0;
+            }
+        }
+        break;
+    }
+
+    ssize_t nb_write = (ssize_t)(size - left);
+    if (nwrite) {
+        *nwrite = nb_write;
+    }
+    send_bytes += nb_write;
+
+    // the buffer is referenced by the sent skbs, even when failed later.
+    if (zerocopy_seq > lo) {
+        ZeroCopyPending pending;
+        pending.lo = lo;
+        pending.hi = zerocopy_seq - 1;
+        pending.remain = zerocopy_seq - lo;
+        pending.release = release;
+        zerocopy_pendings.push_back(pending);
+        zerocopy_stats.hits++;
+    } else if (release) {
+        release();
+    }
+
+    if (left > 0) {
+        // @see https://github.com/ossrs/srs/issues/200
+        if (errno == ETIME) {
+            return CocoContext::IoError(ERROR_SOCKET_TIMEOUT);
+        }
+        return CocoContext::IoError(ERROR_SOCKET_WRITE);
+    }
+#endif
+    return ret;
+}
+
+int CocoSocket::WaitZeroCopy(int64_t timeout_us) {
+    int ret = COCO_SUCCESS;
+
+    // the error queue is not polled by st, so check it in interval.
+    st_utime_t deadline = timeout_us < 0 ? 0 : st_utime() + (st_utime_t)timeout_us;
+    while (true) {
+        reap_zerocopy();
+        if (zerocopy_pendings.empty()) {
+            break;
+        }
+
+        if (deadline && st_utime() >= deadline) {
+            ret = ERROR_SOCKET_TIMEOUT;
+            break;
+        }
+        if (st_usleep(COCO_ZEROCOPY_WAIT_US) != 0) {
+            ret = CocoContext::IoError(ERROR_SOCKET_WRITE);
+            break;
+        }
+    }
+    return ret;
+}
+
+ZeroCopyStats CocoSocket::GetZeroCopyStats() {
+    ZeroCopyStats s = zerocopy_stats;
+    s.pending = (int)zerocopy_pendings.size();
+    return s;
+}
+
+void CocoSocket::reap_zerocopy() {
+#ifdef COCO_HAVE_ZEROCOPY
+    int fd = get_osfd();
+    while (!zerocopy_pendings.empty()) {
+        char control[128];
+        msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+
+        if (::recvmsg(fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) {
+            break;
+        }
+
+        for (cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+            bool recverr = (cmsg->cmsg_level == SOL_IP && cmsg->cmsg_type == IP_RECVERR) ||
+                           (cmsg->cmsg_level == SOL_IPV6 && cmsg->cmsg_type == IPV6_RECVERR);
+            if (!recverr) {
+                continue;
+            }
+
+            sock_extended_err serr;
+            memcpy(&serr, CMSG_DATA(cmsg), sizeof(serr));
+            if (serr.ee_errno != 0 || serr.ee_origin != SO_EE_ORIGIN_ZEROCOPY) {
+                continue;
+            }
+
+            // the ids are 32 bits, and the pendings are never 2^31 behind.
+            uint32_t seq = (uint32_t)zerocopy_seq;
+            uint64_t lo = zerocopy_seq - (uint32_t)(seq - serr.ee_info);
+            uint64_t hi = zerocopy_seq - (uint32_t)(seq - serr.ee_data);
+            // the route never sends from user pages, for example loopback, copy directly,
+            // which is cheaper than the deferred copy and notification.
+            if (serr.ee_code & SO_EE_CODE_ZEROCOPY_COPIED) {
+                zerocopy_stats.copied += hi - lo + 1;
+                zerocopy = false;
+            }
+            complete_zerocopy(lo, hi);
+        }
+    }
+#endif
+}
+
+ssize_t CocoSocket::readv_reaping(const iovec *iov, int iov_size, int64_t timeout) {
+    int fd = get_osfd();
+    while (true) {
+        ssize_t n = ::readv(fd, iov, iov_size);
+        if (n >= 0) {
+            return n;
+        }
+        if (errno == EINTR) {
+            continue;
+        }
+        if (errno != EAGAIN) {
+            return -1;
+        }
+
+        // the POLLERR of completions wakes the poll too, which is cleared by reaping.
+        if (st_netfd_poll(stfd, POLLIN, timeout) < 0) {
+            return -1;
+        }
+        reap_zerocopy();
+    }
+}
+
+ssize_t CocoSocket::writev_reaping(const iovec *iov, int iov_size, int64_t timeout) {
+    int fd = get_osfd();
+
+    ssize_t total = 0;
+    for (int i = 0; i < iov_size; i++) {
+        total += iov[i].iov_len;
+    }
+
+    // copy the iovs only when partially sent.
+    std::vector<iovec> rest;
+    const iovec *piov = iov;
+    int nb_iovs = iov_size;
+
+    ssize_t sent = 0;
+    while (sent < total) {
+        ssize_t n = ::writev(fd, piov, coco_min(nb_iovs, IOV_MAX));
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0 && errno == EAGAIN) {
+            if (st_netfd_poll(stfd, POLLOUT, timeout) < 0) {
+                return -1;
+            }
+            reap_zerocopy();
+            continue;
+        }
+        if (n < 0) {
+            return -1;
+        }
+
+        sent += n;
+        if (sent >= total) {
+            break;
+        }
+        if (rest.empty()) {
+            rest.assign(iov, iov + iov_size);
+            piov = rest.data();
+        }
+        // skip the sent iovs.
+        iovec *p = (iovec *)piov;
+        while (n > 0 || p->iov_len == 0) {
+            size_t nn = coco_min((size_t)n, p->iov_len);
+            p->iov_base = (char *)p->iov_base + nn;
+            p->iov_len -= nn;
+            n -= nn;
+            if (p->iov_len == 0) {
+                p++;
+                nb_iovs--;
+            }
+        }
+        piov = p;
+    }
+
+    return total;
+}
+
+void CocoSocket::complete_zerocopy(uint64_t lo, uint64_t hi) {
+    // the ranges may be out of order, so check all pendings.
+    std::vector<std::function<void()>> releases;
+    for (auto it = zerocopy_pendings.begin(); it != zerocopy_pendings.end();) {
+        uint64_t a = coco_max(lo, it->lo);
+        uint64_t b = coco_min(hi, it->hi);
+        if (a <= b) {
+            it->remain -= coco_min(b - a + 1, it->remain);
+        }
+
+        if (it->remain == 0) {
+            releases.push_back(it->release);
+            it = zerocopy_pendings.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    // the release may yield, never touch the pendings after.
+    for (auto &release : releases) {
+        if (release) {
+            release();
+        }
+    }
+}
@@ -1,14 +1,42 @@
 #pragma once
 
+#include <deque>
+#include <functional>
+#include <vector>
+
 #include "st.h"
 
 #include "base/coroutine.hpp"
 #include "utils/utils.hpp"
 
+// the min bytes to write by MSG_ZEROCOPY, the pinning and notification cost more for less.
+#define COCO_ZEROCOPY_THRESHOLD (16 * 1024)
+// the interval to check the completions of zero copy when waiting.
+#define COCO_ZEROCOPY_WAIT_US (1 * 1000)
+// the max time to wait for the completions of zero copy when the socket is freed.
+#define COCO_ZEROCOPY_CLOSE_WAIT_US (200 * 1000)
+// the bytes to coalesce the small writes, about the mss of a few segments.
+#define COCO_WRITE_BUFFER_SIZE (16 * 1024)
+
+struct ZeroCopyStats {
+    // the writes sent by MSG_ZEROCOPY.
+    uint64_t hits = 0;
+    // the writes copied, for less than the threshold, not enabled or ENOBUFS.
+    uint64_t fallbacks = 0;
+    // the zero copy sends copied by kernel anyway, for example to loopback, then the
+    // socket stops zero copy.
+    uint64_t copied = 0;
+    // the buffers never released, for not completed when the socket is freed, the kernel may
+    // still read them, so they are leaked.
+    uint64_t abandoned = 0;
+    // the buffers waiting for completion.
+    int pending = 0;
+};
+
 class CocoSocket : public IoReaderWriter {
  public:
     CocoSocket(st_netfd_t client_stfd);
-    virtual ~CocoSocket() = default;
+    virtual ~CocoSocket();
 
     virtual bool is_never_timeout(int64_t timeout_us);
     virtual void set_recv_timeout(int64_t timeout_us);
@@ -21,18 +49,115 @@ class CocoSocket : public IoReaderWriter {
 
     virtual int Read(void *buf, size_t size, ssize_t *nread);
     virtual int ReadFully(void *buf, size_t size, ssize_t *nread);
+    // read once to the iovs, for example the blocks of IoBuf.
+    virtual int Readv(const iovec *iov, int iov_size, ssize_t *nread);
     virtual int Write(void *buf, size_t size, ssize_t *nwrite);
     virtual int Writev(const iovec *iov, int iov_size, ssize_t *nwrite);
+    // write the file by sendfile on linux, the pages are never copied to user space.
+    virtual int SendFile(int fd, off_t offset, size_t size, ssize_t *nwrite);
 
     virtual int recvfrom(void *buf, int size, ssize_t *nread, struct sockaddr *from, int *fromlen);
     virtual int sendto(void *buf, int size, ssize_t *nwrite, struct sockaddr *to, int tolen);
     virtual int recvmsg(ssize_t *nread, struct msghdr *msg, int flags);
     virtual int sendmsg(ssize_t *nwrite, struct msghdr *msg, int flags);
 
+ public:
+    /**
+     * enable SO_ZEROCOPY, so WriteZeroCopy() sends the buffers not less than threshold from
+     * the user pages without copying, linux 4.14+ only.
+     * @return ERROR_SOCKET_ZEROCOPY when not supported, and the writes are copied.
+     */
+    virtual int EnableZeroCopy(size_t threshold = COCO_ZEROCOPY_THRESHOLD);
+    /**
+     * write all bytes like Write(), by MSG_ZEROCOPY when enabled and not less than threshold.
+     * the kernel reads buf after returned, so buf must not be changed or freed until release
+     * is called, when the kernel notifies the completion by the error queue, or right away
+     * when buf is copied.
+     * @remark the completions are reaped by the next writes, or WaitZeroCopy(). when the socket
+     *      is freed, it waits for them a while, then leaks the buffers not completed.
+     */
+    virtual int WriteZeroCopy(const void *buf, size_t size, std::function<void()> release,
+                              ssize_t *nwrite);
+    // wait for the completions of all zero copy buffers, for example before closing.
+    virtual int WaitZeroCopy(int64_t timeout_us);
+    ZeroCopyStats GetZeroCopyStats();
+    // the buffers leaked by the freed sockets of all threads, see ZeroCopyStats::abandoned.
+    static uint64_t GetZeroCopyAbandoned();
+
+ public:
+    /**
+     * coalesce the writes less than size in buffer, which is sent with the next large write by
+     * one writev, when full, before reading or Flush(), 0 to disable and flush. the writes of
+     * current tick are flushed after the runnable coroutines, so the small writes are never
+     * stuck when the socket is not read, for example a sender or a proxy.
+     * @remark the buffer is flushed when freed, but the error is lost, so Flush() before close
+     *      to know whether the data is sent.
+     * @remark safe for a reader and a sender coroutine of the socket, the bytes are sent in the
+     *      order of writes, never interleaved.
+     */
+    virtual int EnableWriteBuffer(size_t size = COCO_WRITE_BUFFER_SIZE);
+    // send all bytes in write buffer.
+    virtual int Flush();
+
+ private:
+    // write to stfd, never by the write buffer.
+    int write_direct(void *buf, size_t size, ssize_t *nwrite);
+    int writev_direct(const iovec *iov, int iov_size, ssize_t *nwrite);
+    // copy to the write buffer, or send with the buffered bytes.
+    int write_buffered(const iovec *iov, int iov_size, ssize_t *nwrite);
+    // send the write buffer until empty, by the coroutine which set write_busy.
+    int drain_write_buffer();
+    // wait for the coroutine sending the write buffer, fail when interrupted if interruptible.
+    int wait_write_idle(bool interruptible);
+
+ private:
+    // reap the completions from the error queue, and release the completed buffers.
+    void reap_zerocopy();
+    void complete_zerocopy(uint64_t lo, uint64_t hi);
+    // whether the completions may wake the io by POLLERR, see readv_reaping().
+    bool reaping() const { return zerocopy || !zerocopy_pendings.empty(); }
+    /**
+     * the io of st loops on EAGAIN and poll, which spins when the completions of zero copy are
+     * in the error queue, for POLLERR is level triggered. so read once and write all like st,
+     * and reap the completions on each wake.
+     */
+    ssize_t readv_reaping(const iovec *iov, int iov_size, int64_t timeout);
+    ssize_t writev_reaping(const iovec *iov, int iov_size, int64_t timeout);
+
  private:
     int64_t recv_timeout;
     int64_t send_timeout;
     int64_t recv_bytes;
     int64_t send_bytes;
     st_netfd_t stfd;
+
+    struct ZeroCopyPending {
+        // the ids of the sends, each send by MSG_ZEROCOPY is notified by its id.
+        uint64_t lo;
+        uint64_t hi;
+        // the ids not completed.
+        uint64_t remain;
+        std::function<void()> release;
+    };
+    bool zerocopy;
+    size_t zerocopy_threshold;
+    // the id of next send, the kernel notifies the low 32 bits.
+    uint64_t zerocopy_seq;
+    std::deque<ZeroCopyPending> zerocopy_pendings;
+    ZeroCopyStats zerocopy_stats;
+
+    // the size to coalesce the writes, 0 when disabled.
+    size_t write_buffer_size;
+    std::vector<char> write_buffer;
+    // the bytes being sent, swapped from write buffer, so the writes during sending go to the
+    // fresh buffer, and sent after them in order.
+    std::vector<char> write_sending;
+    // a coroutine is sending the buffer, the others append to the buffer or wait for it.
+    bool write_busy;
+    st_cond_t write_cond;
+    // the buffer is scheduled to flush by CocoWriteFlusher.
+    bool flush_scheduled;
+    friend class CocoWriteFlusher;
+    // the iovs of the buffered bytes and the large write.
+    std::vector<iovec> write_iovs;
 };
\ No newline at end of file
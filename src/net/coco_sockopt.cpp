@@ -0,0 +1,190 @@
+#include "net/coco_sockopt.hpp"
+
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+#include <sstream>
+
+#include "common/error.hpp"
+#include "log/log.hpp"
+
+// the idle time of keepalive is TCP_KEEPALIVE on macOS.
+#if !defined(TCP_KEEPIDLE) && defined(TCP_KEEPALIVE)
+#define TCP_KEEPIDLE TCP_KEEPALIVE
+#endif
+
+// the option not supported by system.
+#define COCO_SOCKOPT_UNSUPPORTED (-1)
+
+#ifdef TCP_KEEPIDLE
+#define COCO_TCP_KEEPIDLE TCP_KEEPIDLE
+#else
+#define COCO_TCP_KEEPIDLE COCO_SOCKOPT_UNSUPPORTED
+#endif
+#ifdef TCP_KEEPINTVL
+#define COCO_TCP_KEEPINTVL TCP_KEEPINTVL
+#else
+#define COCO_TCP_KEEPINTVL COCO_SOCKOPT_UNSUPPORTED
+#endif
+#ifdef TCP_KEEPCNT
+#define COCO_TCP_KEEPCNT TCP_KEEPCNT
+#else
+#define COCO_TCP_KEEPCNT COCO_SOCKOPT_UNSUPPORTED
+#endif
+#ifdef TCP_DEFER_ACCEPT
+#define COCO_TCP_DEFER_ACCEPT TCP_DEFER_ACCEPT
+#else
+#define COCO_TCP_DEFER_ACCEPT COCO_SOCKOPT_UNSUPPORTED
+#endif
+#ifdef TCP_QUICKACK
+#define COCO_TCP_QUICKACK TCP_QUICKACK
+#else
+#define COCO_TCP_QUICKACK COCO_SOCKOPT_UNSUPPORTED
+#endif
+#ifdef TCP_NOTSENT_LOWAT
+#define COCO_TCP_NOTSENT_LOWAT TCP_NOTSENT_LOWAT
+#else
+#define COCO_TCP_NOTSENT_LOWAT COCO_SOCKOPT_UNSUPPORTED
+#endif
+#ifdef SO_BUSY_POLL
+#define COCO_SO_BUSY_POLL SO_BUSY_POLL
+#else
+#define COCO_SO_BUSY_POLL COCO_SOCKOPT_UNSUPPORTED
+#endif
+
+// how to verify the value got from kernel.
+enum CocoSockoptCompare {
+    CocoSockoptEqual,
+    // the flag may be any non-zero value.
+    CocoSockoptFlag,
+    // the kernel may round up the value, for example doubles the buffers.
+    CocoSockoptAtLeast,
+};
+
+struct CocoSockopt {
+    const char *name;
+    int level;
+    int opt;
+    int SocketOptions::*field;
+    CocoSockoptCompare compare;
+    bool tcp;
+    // the option of listener only, never for the connections.
+    bool listener;
+};
+
+#define COCO_SOCKOPT(name, level, opt, compare, tcp, listener) \
+    { #name, level, opt, &SocketOptions::name, compare, tcp, listener }
+
+static const CocoSockopt _coco_sockopts[] = {
+    COCO_SOCKOPT(nodelay, IPPROTO_TCP, TCP_NODELAY, CocoSockoptFlag, true, false),
+    COCO_SOCKOPT(sndbuf, SOL_SOCKET, SO_SNDBUF, CocoSockoptAtLeast, false, false),
+    COCO_SOCKOPT(rcvbuf, SOL_SOCKET, SO_RCVBUF, CocoSockoptAtLeast, false, false),
+    COCO_SOCKOPT(keepalive, SOL_SOCKET, SO_KEEPALIVE, CocoSockoptFlag, true, false),
+    COCO_SOCKOPT(keepidle, IPPROTO_TCP, COCO_TCP_KEEPIDLE, CocoSockoptEqual, true, false),
+    COCO_SOCKOPT(keepintvl, IPPROTO_TCP, COCO_TCP_KEEPINTVL, CocoSockoptEqual, true, false),
+    COCO_SOCKOPT(keepcnt, IPPROTO_TCP, COCO_TCP_KEEPCNT, CocoSockoptEqual, true, false),
+    // the kernel converts the seconds to the retransmits, and rounds up.
+    COCO_SOCKOPT(defer_accept, IPPROTO_TCP, COCO_TCP_DEFER_ACCEPT, CocoSockoptAtLeast, true,
+                 true),
+    COCO_SOCKOPT(quickack, IPPROTO_TCP, COCO_TCP_QUICKACK, CocoSockoptFlag, true, false),
+    COCO_SOCKOPT(notsent_lowat, IPPROTO_TCP, COCO_TCP_NOTSENT_LOWAT, CocoSockoptEqual, true,
+                 false),
+    COCO_SOCKOPT(busy_poll, SOL_SOCKET, COCO_SO_BUSY_POLL, CocoSockoptEqual, false, false),
+};
+
+SocketOptions SocketOptions::LowLatency() {
+    SocketOptions opts;
+    opts.nodelay = 1;
+    opts.quickack = 1;
+    // the unsent bytes in kernel are small, so the latest response is never queued long.
+    opts.notsent_lowat = 16 * 1024;
+    opts.keepalive = 1;
+    return opts;
+}
+
+SocketOptions SocketOptions::Bulk() {
+    SocketOptions opts;
+    // the buffers are left to the autotuning, which grows larger than a fixed one.
+    opts.nodelay = 0;
+    opts.keepalive = 1;
+    opts.keepidle = 60;
+    opts.keepintvl = 10;
+    opts.keepcnt = 6;
+    return opts;
+}
+
+std::string SocketOptions::String() const {
+    std::stringstream ss;
+    for (auto &o : _coco_sockopts) {
+        int v = this->*o.field;
+        if (v != COCO_SOCKOPT_DEFAULT) {
+            ss << (ss.tellp() > 0 ? ", " : "") << o.name << "=" << v;
+        }
+    }
+    return ss.str();
+}
+
+// whether the value in effect is the wanted one, the rounded up value is matched unless exact.
+static bool coco_sockopt_matched(const CocoSockopt &o, int want, int got, bool exact) {
+    if (o.compare == CocoSockoptFlag) {
+        return (got != 0) == (want != 0);
+    }
+    if (o.compare == CocoSockoptAtLeast && !exact) {
+        return got >= want;
+    }
+    return got == want;
+}
+
+int ApplySocketOptions(int fd, const SocketOptions &opts, int socktype, SocketRole role) {
+    int ret = COCO_SUCCESS;
+
+    for (auto &o : _coco_sockopts) {
+        int want = opts.*o.field;
+        if (want == COCO_SOCKOPT_DEFAULT) {
+            continue;
+        }
+        if ((o.tcp && socktype != SOCK_STREAM) || (o.listener && role != SocketListener)) {
+            continue;
+        }
+        if (o.opt == COCO_SOCKOPT_UNSUPPORTED) {
+            coco_warn("socket option %s not supported, ignore. fd=%d", o.name, fd);
+            continue;
+        }
+
+        // the accepted socket inherits most options of the listener, never set again. the
+        // value must be exactly the same, or the smaller one than in effect is never set.
+        int got = 0;
+        socklen_t len = sizeof(got);
+        if (getsockopt(fd, o.level, o.opt, &got, &len) == 0 &&
+            coco_sockopt_matched(o, want, got, true)) {
+            continue;
+        }
+
+        if (setsockopt(fd, o.level, o.opt, &want, sizeof(want)) == -1) {
+            ret = ERROR_SOCKET_SETOPT;
+            coco_error("setsockopt %s=%d failed, fd=%d, errno=%d. ret=%d", o.name, want, fd, errno,
+                       ret);
+            return ret;
+        }
+
+        len = sizeof(got);
+        if (getsockopt(fd, o.level, o.opt, &got, &len) == -1) {
+            ret = ERROR_SOCKET_SETOPT;
+            coco_error("getsockopt %s failed, fd=%d, errno=%d. ret=%d", o.name, fd, errno, ret);
+            return ret;
+        }
+        if (!coco_sockopt_matched(o, want, got, false)) {
+            // the kernel clamps the value, for example the buffers by wmem_max.
+            if (opts.strict) {
+                ret = ERROR_SOCKET_SETOPT;
+                coco_error("socket option %s=%d is %d, fd=%d. ret=%d", o.name, want, got, fd, ret);
+                return ret;
+            }
+            coco_warn("socket option %s=%d is %d, fd=%d", o.name, want, got, fd);
+        }
+    }
+
+    return ret;
+}
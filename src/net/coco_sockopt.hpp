@@ -0,0 +1,64 @@
+#pragma once
+
+#include <string>
+
+// the value to keep the default of system.
+#define COCO_SOCKOPT_DEFAULT (-1)
+
+/**
+ * the options of socket, for ListenTcp(), DialTcp(), ListenUdp() and DialUdp(), and the
+ * connections accepted by the listener inherit the options.
+ * each option is COCO_SOCKOPT_DEFAULT to keep the default of system, and the options of tcp
+ * are ignored by udp, and the options not supported by the system are ignored with warning.
+ * each option is verified by getsockopt after set, and the option already in effect, for
+ * example inherited from the listener by the kernel, is never set again.
+ * Usage:
+ *       TcpListener *l = ListenTcp("0.0.0.0", 8080, SocketOptions::LowLatency());
+ *       TcpConn *c = DialTcp("10.0.0.1", 8080, 3000 * 1000, SocketOptions::Bulk());
+ */
+struct SocketOptions {
+    // TCP_NODELAY, 1 to send the small segments without waiting for the ack.
+    int nodelay = COCO_SOCKOPT_DEFAULT;
+    // SO_SNDBUF and SO_RCVBUF in bytes, which disable the autotuning of linux.
+    int sndbuf = COCO_SOCKOPT_DEFAULT;
+    int rcvbuf = COCO_SOCKOPT_DEFAULT;
+    // SO_KEEPALIVE, and the idle seconds, interval seconds and count of probes.
+    int keepalive = COCO_SOCKOPT_DEFAULT;
+    int keepidle = COCO_SOCKOPT_DEFAULT;
+    int keepintvl = COCO_SOCKOPT_DEFAULT;
+    int keepcnt = COCO_SOCKOPT_DEFAULT;
+    // TCP_DEFER_ACCEPT in seconds of listener, linux only, wakeup when the data arrives.
+    int defer_accept = COCO_SOCKOPT_DEFAULT;
+    // TCP_QUICKACK, linux only, 1 to ack immediately.
+    int quickack = COCO_SOCKOPT_DEFAULT;
+    // TCP_NOTSENT_LOWAT in bytes, limit the unsent bytes in kernel, so the writer is
+    // blocked before the data is stale.
+    int notsent_lowat = COCO_SOCKOPT_DEFAULT;
+    // SO_BUSY_POLL in us, linux only, poll the device queue when reading.
+    int busy_poll = COCO_SOCKOPT_DEFAULT;
+    // fail when the option is set but the kernel clamps it, or only warn.
+    bool strict = false;
+
+ public:
+    // for the small request and response of rpc, flush each write and ack immediately.
+    static SocketOptions LowLatency();
+    // for the long streams of bulk data, batch the segments and keep the autotuning buffers.
+    static SocketOptions Bulk();
+
+    // the options not default, for logging.
+    std::string String() const;
+};
+
+// the role of socket, some options apply only to the listener.
+enum SocketRole {
+    SocketListener,
+    SocketAccepted,
+    SocketDialed,
+};
+
+/**
+ * apply the options to the socket, and verify each option by getsockopt.
+ * @param socktype SOCK_STREAM or SOCK_DGRAM, the options of tcp are ignored by udp.
+ * @return ERROR_SOCKET_SETOPT when setsockopt failed, or the option is clamped when strict.
+ */
+int ApplySocketOptions(int fd, const SocketOptions &opts, int socktype, SocketRole role);
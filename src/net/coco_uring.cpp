@@ -0,0 +1,516 @@
+#include "net/coco_uring.hpp"
+
+#if defined(__linux__) && defined(COCO_ENABLE_IO_URING)
+
+#include <errno.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "base/coroutine.hpp"
+#include "common/error.hpp"
+#include "log/log.hpp"
+#include "utils/utils.hpp"
+
+// the cq ring overflowed, since linux 5.8.
+#ifndef IORING_SQ_CQ_OVERFLOW
+#define IORING_SQ_CQ_OVERFLOW (1U << 1)
+#endif
+
+static int coco_uring_setup(unsigned entries, io_uring_params *p) {
+    return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int coco_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static int coco_uring_register(int fd, unsigned opcode, const void *arg, unsigned nr_args) {
+    return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+// the coroutine to submit the sqes of current tick in one io_uring_enter.
+class UringSubmitter : public CoroutineHandler {
+ public:
+    UringSubmitter(UringRing *ring) : ring_(ring) { coroutine = new CoCoroutine("uring", this); }
+    virtual ~UringSubmitter() { coco_freep(coroutine); }
+
+    int Start() { return coroutine->start(); }
+    virtual int Cycle() {
+        while (!ShouldTermCycle()) {
+            // signalled by the first sqe, and run after the runnable coroutines.
+            if (ring_->sqe_tail_ == ring_->sqe_submitted_ &&
+                st_cond_wait(ring_->flush_cond_) != 0) {
+                break;
+            }
+            if (ring_->flush() != COCO_SUCCESS) {
+                st_usleep(COCO_URING_RETRY_US);
+            }
+        }
+        return COCO_SUCCESS;
+    }
+
+ private:
+    UringRing *ring_;
+};
+
+// the coroutine to wakeup the coroutines of cqes, notified by eventfd.
+class UringReaper : public CoroutineHandler {
+ public:
+    UringReaper(UringRing *ring) : ring_(ring) { coroutine = new CoCoroutine("uring", this); }
+    virtual ~UringReaper() { coco_freep(coroutine); }
+
+    int Start() { return coroutine->start(); }
+    virtual int Cycle() {
+        while (!ShouldTermCycle()) {
+            uint64_t v;
+            if (st_read(ring_->event_stfd_, &v, sizeof(v), ST_UTIME_NO_TIMEOUT) < 0 &&
+                errno == EINTR) {
+                break;
+            }
+            ring_->reap();
+        }
+        return COCO_SUCCESS;
+    }
+
+ private:
+    UringRing *ring_;
+};
+
+thread_local UringRing *_uring_ring = nullptr;
+
+UringRing::UringRing() {
+    ring_fd_ = event_fd_ = -1;
+    event_stfd_ = nullptr;
+    sq_ptr_ = cq_ptr_ = nullptr;
+    sq_size_ = cq_size_ = sqes_size_ = 0;
+    sqes_ = nullptr;
+    sq_head_ = sq_tail_ = sq_flags_ = sq_array_ = cq_head_ = cq_tail_ = nullptr;
+    sq_mask_ = sq_entries_ = cq_mask_ = 0;
+    cqes_ = nullptr;
+    sqe_tail_ = sqe_submitted_ = 0;
+    submitter_ = nullptr;
+    reaper_ = nullptr;
+    flush_cond_ = nullptr;
+    flushing_ = false;
+    nb_ops_ = nb_enters_ = nb_fallbacks_ = 0;
+}
+
+UringRing::~UringRing() {
+    coco_freep(submitter_);
+    coco_freep(reaper_);
+    if (flush_cond_) {
+        st_cond_destroy(flush_cond_);
+    }
+    for (auto cond : conds_) {
+        st_cond_destroy(cond);
+    }
+
+    if (event_stfd_) {
+        st_netfd_close(event_stfd_);
+    } else if (event_fd_ >= 0) {
+        ::close(event_fd_);
+    }
+
+    if (sqes_) {
+        munmap(sqes_, sqes_size_);
+    }
+    if (cq_ptr_ && cq_ptr_ != sq_ptr_) {
+        munmap(cq_ptr_, cq_size_);
+    }
+    if (sq_ptr_) {
+        munmap(sq_ptr_, sq_size_);
+    }
+    if (ring_fd_ >= 0) {
+        ::close(ring_fd_);
+    }
+
+    for (auto p : fixed_) {
+        free(p);
+    }
+}
+
+int UringRing::Init() {
+    int ret = COCO_SUCCESS;
+
+    if (_uring_ring) {
+        return ret;
+    }
+
+    UringRing *ring = new UringRing();
+    if ((ret = ring->initialize()) != COCO_SUCCESS) {
+        delete ring;
+        return ret;
+    }
+
+    _uring_ring = ring;
+    return ret;
+}
+
+UringRing *UringRing::Instance() { return _uring_ring; }
+
+void UringRing::Destroy() { coco_freep(_uring_ring); }
+
+int UringRing::initialize() {
+    int ret = COCO_SUCCESS;
+
+    io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    if ((ring_fd_ = coco_uring_setup(COCO_URING_ENTRIES, &p)) < 0) {
+        ret = ERROR_URING_INIT;
+        coco_error("io_uring_setup failed, errno=%d. ret=%d", errno, ret);
+        return ret;
+    }
+
+    // map the rings, which is one mmap for new kernels.
+    sq_size_ = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    cq_size_ = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        sq_size_ = cq_size_ = coco_max(sq_size_, cq_size_);
+    }
+
+    sq_ptr_ = mmap(NULL, sq_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_,
+                   IORING_OFF_SQ_RING);
+    if (sq_ptr_ == MAP_FAILED) {
+        sq_ptr_ = nullptr;
+        ret = ERROR_URING_INIT;
+        coco_error("mmap io_uring sq failed, errno=%d. ret=%d", errno, ret);
+        return ret;
+    }
+
+    cq_ptr_ = sq_ptr_;
+    if (!(p.features & IORING_FEAT_SINGLE_MMAP)) {
+        cq_ptr_ = mmap(NULL, cq_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                       ring_fd_, IORING_OFF_CQ_RING);
+        if (cq_ptr_ == MAP_FAILED) {
+            cq_ptr_ = nullptr;
+            ret = ERROR_URING_INIT;
+            coco_error("mmap io_uring cq failed, errno=%d. ret=%d", errno, ret);
+            return ret;
+        }
+    }
+
+    sqes_size_ = p.sq_entries * sizeof(io_uring_sqe);
+    sqes_ = (io_uring_sqe *)mmap(NULL, sqes_size_, PROT_READ | PROT_WRITE,
+                                 MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQES);
+    if (sqes_ == MAP_FAILED) {
+        sqes_ = nullptr;
+        ret = ERROR_URING_INIT;
+        coco_error("mmap io_uring sqes failed, errno=%d. ret=%d", errno, ret);
+        return ret;
+    }
+
+    char *sq = (char *)sq_ptr_;
+    sq_head_ = (unsigned *)(sq + p.sq_off.head);
+    sq_tail_ = (unsigned *)(sq + p.sq_off.tail);
+    sq_flags_ = (unsigned *)(sq + p.sq_off.flags);
+    sq_mask_ = *(unsigned *)(sq + p.sq_off.ring_mask);
+    sq_entries_ = *(unsigned *)(sq + p.sq_off.ring_entries);
+    sq_array_ = (unsigned *)(sq + p.sq_off.array);
+    char *cq = (char *)cq_ptr_;
+    cq_head_ = (unsigned *)(cq + p.cq_off.head);
+    cq_tail_ = (unsigned *)(cq + p.cq_off.tail);
+    cq_mask_ = *(unsigned *)(cq + p.cq_off.ring_mask);
+    cqes_ = (io_uring_cqe *)(cq + p.cq_off.cqes);
+    sqe_tail_ = sqe_submitted_ = *sq_tail_;
+
+    // the completions notify the eventfd, which is polled by st.
+    if ((event_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0) {
+        ret = ERROR_URING_INIT;
+        coco_error("create io_uring eventfd failed, errno=%d. ret=%d", errno, ret);
+        return ret;
+    }
+    if (coco_uring_register(ring_fd_, IORING_REGISTER_EVENTFD, &event_fd_, 1) < 0) {
+        ret = ERROR_URING_INIT;
+        coco_error("register io_uring eventfd failed, errno=%d. ret=%d", errno, ret);
+        return ret;
+    }
+    if ((event_stfd_ = st_netfd_open(event_fd_)) == NULL) {
+        ret = ERROR_URING_INIT;
+        coco_error("open io_uring eventfd failed. ret=%d", ret);
+        return ret;
+    }
+
+    // the registered buffers are optional, for the memlock limit may be small.
+    std::vector<iovec> iovs;
+    for (int i = 0; i < COCO_URING_FIXED_BUFFERS; i++) {
+        char *buf = (char *)malloc(COCO_URING_FIXED_SIZE);
+        iovec iov;
+        iov.iov_base = buf;
+        iov.iov_len = COCO_URING_FIXED_SIZE;
+        iovs.push_back(iov);
+        fixed_.push_back(buf);
+    }
+    if (coco_uring_register(ring_fd_, IORING_REGISTER_BUFFERS, iovs.data(), iovs.size()) < 0) {
+        coco_warn("register io_uring buffers failed, errno=%d, ignore", errno);
+        for (auto buf : fixed_) {
+            free(buf);
+        }
+        fixed_.clear();
+    }
+    for (int i = (int)fixed_.size() - 1; i >= 0; i--) {
+        fixed_free_.push_back(i);
+    }
+
+    flush_cond_ = st_cond_new();
+    submitter_ = new UringSubmitter(this);
+    reaper_ = new UringReaper(this);
+    if ((ret = submitter_->Start()) != COCO_SUCCESS || (ret = reaper_->Start()) != COCO_SUCCESS) {
+        coco_error("start io_uring coroutines failed. ret=%d", ret);
+        return ret;
+    }
+
+    coco_trace("io_uring ready, entries=%u, features=%#x, fixed=%d", sq_entries_, p.features,
+               (int)fixed_.size());
+    return ret;
+}
+
+ssize_t UringRing::Recv(int fd, void *buf, size_t size, int64_t timeout_us) {
+    Op op;
+    io_uring_sqe *sqe = get_sqe();
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)(uintptr_t)buf;
+    sqe->len = (uint32_t)size;
+    return submit(&op, sqe, timeout_us);
+}
+
+ssize_t UringRing::Send(int fd, const void *buf, size_t size, int64_t timeout_us) {
+    Op op;
+    io_uring_sqe *sqe = get_sqe();
+    sqe->opcode = IORING_OP_SEND;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)(uintptr_t)buf;
+    sqe->len = (uint32_t)size;
+    sqe->msg_flags = MSG_NOSIGNAL;
+    return submit(&op, sqe, timeout_us);
+}
+
+ssize_t UringRing::Sendmsg(int fd, const msghdr *msg, int64_t timeout_us) {
+    Op op;
+    io_uring_sqe *sqe = get_sqe();
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)(uintptr_t)msg;
+    sqe->len = 1;
+    sqe->msg_flags = MSG_NOSIGNAL;
+    return submit(&op, sqe, timeout_us);
+}
+
+int UringRing::Accept(int fd, sockaddr *addr, socklen_t *addrlen, int64_t timeout_us) {
+    Op op;
+    io_uring_sqe *sqe = get_sqe();
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)(uintptr_t)addr;
+    sqe->addr2 = (uint64_t)(uintptr_t)addrlen;
+    sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+    return submit(&op, sqe, timeout_us);
+}
+
+int UringRing::Connect(int fd, const sockaddr *addr, socklen_t addrlen, int64_t timeout_us) {
+    Op op;
+    io_uring_sqe *sqe = get_sqe();
+    sqe->opcode = IORING_OP_CONNECT;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)(uintptr_t)addr;
+    sqe->off = addrlen;
+    return submit(&op, sqe, timeout_us);
+}
+
+char *UringRing::AcquireFixed(int *index) {
+    if (fixed_free_.empty()) {
+        return nullptr;
+    }
+
+    *index = fixed_free_.back();
+    fixed_free_.pop_back();
+    return fixed_[*index];
+}
+
+void UringRing::ReleaseFixed(int index) { fixed_free_.push_back(index); }
+
+ssize_t UringRing::ReadFixed(int fd, int index, size_t size, int64_t timeout_us) {
+    Op op;
+    io_uring_sqe *sqe = get_sqe();
+    sqe->opcode = IORING_OP_READ_FIXED;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)(uintptr_t)fixed_[index];
+    sqe->len = (uint32_t)coco_min(size, (size_t)COCO_URING_FIXED_SIZE);
+    sqe->buf_index = (uint16_t)index;
+    return submit(&op, sqe, timeout_us);
+}
+
+ssize_t UringRing::WriteFixed(int fd, int index, size_t size, int64_t timeout_us) {
+    Op op;
+    io_uring_sqe *sqe = get_sqe();
+    sqe->opcode = IORING_OP_WRITE_FIXED;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)(uintptr_t)fixed_[index];
+    sqe->len = (uint32_t)coco_min(size, (size_t)COCO_URING_FIXED_SIZE);
+    sqe->buf_index = (uint16_t)index;
+    return submit(&op, sqe, timeout_us);
+}
+
+UringStats UringRing::Stats() {
+    UringStats s;
+    s.ops = nb_ops_;
+    s.enters = nb_enters_;
+    s.fallbacks = nb_fallbacks_;
+    s.fixed_used = (int)(fixed_.size() - fixed_free_.size());
+    return s;
+}
+
+io_uring_sqe *UringRing::get_sqe() {
+    // the op and its linked timeout must be in the same batch.
+    while (sqe_tail_ + 2 - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE) > sq_entries_) {
+        if (flush() != COCO_SUCCESS) {
+            st_usleep(COCO_URING_RETRY_US);
+        }
+    }
+    return next_sqe();
+}
+
+io_uring_sqe *UringRing::next_sqe() {
+    unsigned index = sqe_tail_ & sq_mask_;
+    io_uring_sqe *sqe = &sqes_[index];
+    memset(sqe, 0, sizeof(io_uring_sqe));
+    sq_array_[index] = index;
+    sqe_tail_++;
+    return sqe;
+}
+
+int UringRing::submit(Op *op, io_uring_sqe *sqe, int64_t timeout_us) {
+    sqe->user_data = (uint64_t)(uintptr_t)op;
+
+    if (timeout_us >= 0) {
+        op->ts.tv_sec = timeout_us / 1000000;
+        op->ts.tv_nsec = (timeout_us % 1000000) * 1000;
+        sqe->flags |= IOSQE_IO_LINK;
+
+        io_uring_sqe *t = next_sqe();
+        t->opcode = IORING_OP_LINK_TIMEOUT;
+        t->fd = -1;
+        t->addr = (uint64_t)(uintptr_t)&op->ts;
+        t->len = 1;
+        // the cqe of timeout is ignored.
+        t->user_data = 0;
+    }
+
+    if (conds_.empty()) {
+        op->cond = st_cond_new();
+    } else {
+        op->cond = conds_.back();
+        conds_.pop_back();
+    }
+
+    // the submitter runs after the runnable coroutines, to submit them in a batch.
+    if (!flushing_) {
+        flushing_ = true;
+        st_cond_signal(flush_cond_);
+    }
+
+    // the kernel owns the buffer until the cqe, so never return before done.
+    bool interrupted = false;
+    while (!op->done) {
+        if (st_cond_wait(op->cond) != 0 && !interrupted) {
+            interrupted = true;
+            cancel(op);
+        }
+    }
+    conds_.push_back(op->cond);
+
+    int res = op->res;
+    if (res >= 0) {
+        return res;
+    }
+
+    if (interrupted) {
+        errno = EINTR;
+    } else if (res == -ECANCELED) {
+        // cancelled by the linked timeout.
+        errno = ETIME;
+    } else {
+        errno = -res;
+        if (res == -EAGAIN) {
+            nb_fallbacks_++;
+        }
+    }
+    return -1;
+}
+
+void UringRing::cancel(Op *op) {
+    io_uring_sqe *sqe = get_sqe();
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->addr = (uint64_t)(uintptr_t)op;
+    sqe->user_data = 0;
+
+    if (!flushing_) {
+        flushing_ = true;
+        st_cond_signal(flush_cond_);
+    }
+}
+
+int UringRing::flush() {
+    int ret = COCO_SUCCESS;
+
+    flushing_ = false;
+
+    unsigned n = sqe_tail_ - sqe_submitted_;
+    if (n == 0) {
+        return ret;
+    }
+
+    __atomic_store_n(sq_tail_, sqe_tail_, __ATOMIC_RELEASE);
+    int r = coco_uring_enter(ring_fd_, n, 0, 0);
+    nb_enters_++;
+    if (r < 0) {
+        // the kernel consumes the sqes it got, retry the others later.
+        ret = ERROR_URING_SUBMIT;
+        coco_warn("io_uring_enter failed, pending=%u, errno=%d. ret=%d", n, errno, ret);
+        sqe_submitted_ = __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+    } else {
+        sqe_submitted_ += (unsigned)r;
+    }
+
+    // some operations are done inline, never wait for the eventfd.
+    reap();
+    return ret;
+}
+
+void UringRing::reap() {
+    while (true) {
+        unsigned head = *cq_head_;
+        unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+
+        while (head != tail) {
+            io_uring_cqe *cqe = &cqes_[head & cq_mask_];
+            Op *op = (Op *)(uintptr_t)cqe->user_data;
+            if (op) {
+                op->res = cqe->res;
+                op->done = true;
+                st_cond_signal(op->cond);
+                nb_ops_++;
+            }
+            head++;
+        }
+
+        __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+
+        // the kernel keeps the cqes when the cq ring is full, and only moves them to the ring
+        // in io_uring_enter, so the coroutines of them hang when there is nothing to submit.
+        if (!(__atomic_load_n(sq_flags_, __ATOMIC_ACQUIRE) & IORING_SQ_CQ_OVERFLOW)) {
+            break;
+        }
+        nb_enters_++;
+        if (coco_uring_enter(ring_fd_, 0, 0, IORING_ENTER_GETEVENTS) < 0) {
+            coco_warn("io_uring_enter flush overflow failed, errno=%d", errno);
+            break;
+        }
+    }
+}
+
+#endif
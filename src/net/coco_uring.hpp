@@ -0,0 +1,145 @@
+#pragma once
+
+#include <stdint.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#include <vector>
+
+#include "st.h"
+
+#if defined(__linux__) && defined(COCO_ENABLE_IO_URING)
+#include <linux/io_uring.h>
+
+class UringSubmitter;
+class UringReaper;
+
+// the entries of submission queue, the completion queue is twice.
+#define COCO_URING_ENTRIES 1024
+// the registered buffers, see UringRing::AcquireFixed().
+#define COCO_URING_FIXED_BUFFERS 64
+#define COCO_URING_FIXED_SIZE (16 * 1024)
+// the interval to retry when io_uring_enter failed, for example EAGAIN or EBUSY.
+#define COCO_URING_RETRY_US (1 * 1000)
+
+struct UringStats {
+    // the operations completed by the ring.
+    uint64_t ops = 0;
+    // the io_uring_enter to submit, each submits a batch of operations.
+    uint64_t enters = 0;
+    // the operations returned EAGAIN, which the caller retries by st.
+    uint64_t fallbacks = 0;
+    // the registered buffers in use.
+    int fixed_used = 0;
+};
+
+/**
+ * the io_uring backend of the socket io, see CocoInit(CocoIoUring).
+ * the coroutine prepares the sqe and parks on a cond, the submitter coroutine submits
+ * all sqes in one io_uring_enter, which runs after the runnable coroutines of current
+ * tick, so the sqes of a tick are batched. the ring notifies an eventfd polled by st,
+ * and the reaper coroutine wakes the coroutines of the cqes.
+ * the timeout is a linked timeout sqe, and the interrupted operation is cancelled, but
+ * the coroutine always waits for the cqe, for the kernel owns the buffer until done.
+ * @remark the ring belongs to the st scheduler of current thread.
+ * @remark all functions return like the syscall, -1 with errno when failed, and ETIME
+ *       when timeout.
+ */
+class UringRing {
+ public:
+    UringRing();
+    virtual ~UringRing();
+
+    // create the ring of current scheduler, by CocoInit.
+    static int Init();
+    // the ring of current scheduler, nullptr when use epoll.
+    static UringRing *Instance();
+    // free the ring of current scheduler, when the worker thread exits.
+    static void Destroy();
+
+ public:
+    ssize_t Recv(int fd, void *buf, size_t size, int64_t timeout_us);
+    ssize_t Send(int fd, const void *buf, size_t size, int64_t timeout_us);
+    ssize_t Sendmsg(int fd, const msghdr *msg, int64_t timeout_us);
+    // return the accepted fd.
+    int Accept(int fd, sockaddr *addr, socklen_t *addrlen, int64_t timeout_us);
+    int Connect(int fd, const sockaddr *addr, socklen_t addrlen, int64_t timeout_us);
+
+    /**
+     * lease a registered buffer, which the kernel never maps again for each io.
+     * @return the buffer of COCO_URING_FIXED_SIZE bytes, nullptr when all are used.
+     */
+    char *AcquireFixed(int *index);
+    void ReleaseFixed(int index);
+    // read or write by the registered buffer of index.
+    ssize_t ReadFixed(int fd, int index, size_t size, int64_t timeout_us);
+    ssize_t WriteFixed(int fd, int index, size_t size, int64_t timeout_us);
+
+    UringStats Stats();
+
+ private:
+    struct Op {
+        int res = 0;
+        bool done = false;
+        st_cond_t cond = nullptr;
+        __kernel_timespec ts;
+    };
+
+    int initialize();
+    // get a sqe with a free sqe after it, for the linked timeout.
+    io_uring_sqe *get_sqe();
+    io_uring_sqe *next_sqe();
+    // submit the sqe, and park until the cqe.
+    int submit(Op *op, io_uring_sqe *sqe, int64_t timeout_us);
+    void cancel(Op *op);
+    // submit the queued sqes.
+    int flush();
+    // wakeup the coroutines of cqes.
+    void reap();
+
+ private:
+    friend class UringSubmitter;
+    friend class UringReaper;
+
+    int ring_fd_;
+    int event_fd_;
+    st_netfd_t event_stfd_;
+
+    // the rings mapped from kernel.
+    void *sq_ptr_;
+    size_t sq_size_;
+    void *cq_ptr_;
+    size_t cq_size_;
+    io_uring_sqe *sqes_;
+    size_t sqes_size_;
+    unsigned *sq_head_;
+    unsigned *sq_tail_;
+    unsigned *sq_flags_;
+    unsigned sq_mask_;
+    unsigned sq_entries_;
+    unsigned *sq_array_;
+    unsigned *cq_head_;
+    unsigned *cq_tail_;
+    unsigned cq_mask_;
+    io_uring_cqe *cqes_;
+    // the tail of sqes prepared, and submitted.
+    unsigned sqe_tail_;
+    unsigned sqe_submitted_;
+
+    std::vector<char *> fixed_;
+    std::vector<int> fixed_free_;
+    // the conds of finished operations, for reuse.
+    std::vector<st_cond_t> conds_;
+
+    UringSubmitter *submitter_;
+    UringReaper *reaper_;
+    st_cond_t flush_cond_;
+    bool flushing_;
+
+    uint64_t nb_ops_;
+    uint64_t nb_enters_;
+    uint64_t nb_fallbacks_;
+};
+
+#endif
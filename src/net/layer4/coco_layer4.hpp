@@ -16,7 +16,7 @@ class Layer4Conn {
         coco_dbg("destruct layer4conn");
         if (skt_) {
             coco_dbg("free skt_");
-            free(skt_);
+            delete skt_;
             skt_ = nullptr;
         }
 
@@ -32,7 +32,7 @@ class Layer4Conn {
         stfd_ = nullptr;
         if (skt_) {
             coco_dbg("free skt_");
-            free(skt_);
+            delete skt_;
             skt_ = nullptr;
         }
     }
@@ -64,17 +64,40 @@ class StreamConn : public Layer4Conn, public IoReaderWriter {
     virtual int Read(void *buf, size_t size, ssize_t *nread) {
         return skt_->Read(buf, size, nread);
     }
+    virtual int Readv(const iovec *iov, int iov_size, ssize_t *nread) {
+        return skt_->Readv(iov, iov_size, nread);
+    }
     virtual int Write(void *buf, size_t size, ssize_t *nwrite) {
         return skt_->Write(buf, size, nwrite);
     }
     virtual int Writev(const iovec *iov, int iov_size, ssize_t *nwrite) {
         return skt_->Writev(iov, iov_size, nwrite);
     }
+    virtual int SendFile(int fd, off_t offset, size_t size, ssize_t *nwrite) {
+        return skt_->SendFile(fd, offset, size, nwrite);
+    }
 
     virtual int ReadFully(void *buf, size_t size, ssize_t *nread) {
         return skt_->ReadFully(buf, size, nread);
     }
     virtual std::string RemoteAddr() = 0;
+
+    // the opt-in zero copy writes of large buffers, see CocoSocket::WriteZeroCopy().
+    int EnableZeroCopy(size_t threshold = COCO_ZEROCOPY_THRESHOLD) {
+        return skt_->EnableZeroCopy(threshold);
+    }
+    virtual int WriteZeroCopy(const void *buf, size_t size, std::function<void()> release,
+                              ssize_t *nwrite) {
+        return skt_->WriteZeroCopy(buf, size, release, nwrite);
+    }
+    int WaitZeroCopy(int64_t timeout_us) { return skt_->WaitZeroCopy(timeout_us); }
+    ZeroCopyStats GetZeroCopyStats() { return skt_->GetZeroCopyStats(); }
+
+    // the opt-in coalescing of small writes, see CocoSocket::EnableWriteBuffer().
+    int EnableWriteBuffer(size_t size = COCO_WRITE_BUFFER_SIZE) {
+        return skt_->EnableWriteBuffer(size);
+    }
+    virtual int Flush() { return skt_->Flush(); }
 };
 
 class DatagramConn : public Layer4Conn {
@@ -86,6 +86,10 @@ int SslConn::Read(void* plaintext, size_t nn_plaintext, ssize_t* nread) {
     }
 }
 
+int SslConn::Readv(const iovec* iov, int iov_size, ssize_t* nread) {
+    return IoReader::Readv(iov, iov_size, nread);
+}
+
 int SslConn::Write(void* plaintext, size_t nn_plaintext, ssize_t* nwrite) {
     int err = COCO_SUCCESS;
 
@@ -119,6 +123,19 @@ int SslConn::Write(void* plaintext, size_t nn_plaintext, ssize_t* nwrite) {
     return err;
 }
 
+int SslConn::WriteZeroCopy(const void* buf, size_t size, std::function<void()> release,
+                           ssize_t* nwrite) {
+    int err = Write((void*)buf, size, nwrite);
+    if (release) {
+        release();
+    }
+    return err;
+}
+
+int SslConn::SendFile(int fd, off_t offset, size_t size, ssize_t* nwrite) {
+    return IoWriter::SendFile(fd, offset, size, nwrite);
+}
+
 int SslConn::Writev(const iovec* iov, int iov_size, ssize_t* nwrite) {
     int err = COCO_SUCCESS;
 
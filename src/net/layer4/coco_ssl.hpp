@@ -12,9 +12,16 @@ class SslConn : public StreamConn {
     virtual ~SslConn();
 
     int Read(void* buf, size_t size, ssize_t* nread);
+    // the plaintext is decrypted to the first iov, never by readv of socket.
+    int Readv(const iovec* iov, int iov_size, ssize_t* nread);
     int Write(void* buf, size_t size, ssize_t* nwrite);
     int Writev(const iovec* iov, int iov_size, ssize_t* nwrite);
     int ReadFully(void* buf, size_t size, ssize_t* nread);
+    // the plaintext is copied by the encryption, so never by zero copy.
+    int WriteZeroCopy(const void* buf, size_t size, std::function<void()> release,
+                      ssize_t* nwrite);
+    // the file is encrypted in user space, so read and written, never by sendfile.
+    int SendFile(int fd, off_t offset, size_t size, ssize_t* nwrite);
     std::string RemoteAddr();
 
  protected:
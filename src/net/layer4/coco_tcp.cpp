@@ -1,22 +1,37 @@
 #include "net/layer4/coco_tcp.hpp"
 
 #include <assert.h>
+#include <fcntl.h>
 #include <netdb.h>
+#include <poll.h>
 #include <string.h>
 #include <algorithm>
 
+#include "base/coco_context.hpp"
+#include "base/coco_master.hpp"
 #include "coco_api.h"
 #include "common/error.hpp"
 #include "log/log.hpp"
+#include "net/coco_dns.hpp"
+#include "net/coco_uring.hpp"
 #include "utils/utils.hpp"
 
 #define SERVER_LISTEN_BACKLOG 512
 
 TcpConn::TcpConn(st_netfd_t stfd) : StreamConn(stfd) {}
 
+TcpConn::TcpConn(st_netfd_t stfd, const sockaddr *addr, socklen_t addrlen) : StreamConn(stfd) {
+    if (addr && addrlen > 0 && addrlen <= (socklen_t)sizeof(peer_)) {
+        memcpy(&peer_, addr, addrlen);
+        has_peer_ = true;
+    }
+}
+
 std::string TcpConn::RemoteAddr() {
-    auto fd = skt_->get_osfd();
-    return GetRemoteAddr(fd);
+    if (remote_addr_.empty()) {
+        remote_addr_ = has_peer_ ? GetRemoteAddr((sockaddr *)&peer_) : GetRemoteAddr(skt_->get_osfd());
+    }
+    return remote_addr_;
 }
 
 /* TcpListener */
@@ -26,34 +41,179 @@ TcpListener::TcpListener(TcpConn *conn) {
 }
 
 TcpListener::~TcpListener() {
+    for (auto conn : ready_) {
+        delete conn;
+    }
+    ready_.clear();
+
     if (conn_) {
         delete conn_;
     }
 }
 
+// connect by io_uring when enabled, fallback to st when the socket is not ready.
+static int coco_connect(st_netfd_t stfd, const sockaddr *addr, socklen_t len, int64_t timeout) {
+#if defined(__linux__) && defined(COCO_ENABLE_IO_URING)
+    UringRing *ring = UringRing::Instance();
+    if (ring) {
+        int fd = st_netfd_fileno(stfd);
+        int r = ring->Connect(fd, addr, len, timeout);
+        if (r == 0 || (errno != EAGAIN && errno != EINPROGRESS && errno != EALREADY)) {
+            return r;
+        }
+
+        // the connect is in progress, wait for it by st.
+        if (errno != EAGAIN) {
+            if (st_netfd_poll(stfd, POLLOUT, timeout) < 0) {
+                return -1;
+            }
+            int err = 0;
+            socklen_t n = sizeof(err);
+            if (getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &n) < 0 || err != 0) {
+                errno = err ? err : errno;
+                return -1;
+            }
+            return 0;
+        }
+    }
+#endif
+    return st_connect(stfd, addr, len, timeout);
+}
+
 TcpConn *TcpListener::Accept() {
+    accepting_++;
+    TcpConn *conn = accept_one();
+    accepting_--;
+    return conn;
+}
+
+TcpConn *TcpListener::PopReady() {
+    if (ready_.empty()) {
+        return nullptr;
+    }
+    TcpConn *conn = ready_.front();
+    ready_.pop_front();
+    return conn;
+}
+
+TcpConn *TcpListener::accept_one() {
     st_netfd_t stfd = GetStfd();
-    st_netfd_t client_stfd = st_accept(stfd, NULL, NULL, ST_UTIME_NO_TIMEOUT);
-    if (client_stfd == NULL) {
-        // ignore error.
-        if (errno != EINTR) {
-            coco_error("ignore accept thread stoppped for accept client error");
+
+#if defined(__linux__) && defined(COCO_ENABLE_IO_URING)
+    // the ring accepts one by one, and parks until the connection arrives.
+    UringRing *ring = UringRing::Instance();
+    if (ring && ready_.empty()) {
+        sockaddr_storage addr;
+        socklen_t addrlen = sizeof(addr);
+        int fd = ring->Accept(st_netfd_fileno(stfd), (sockaddr *)&addr, &addrlen,
+                              ST_UTIME_NO_TIMEOUT);
+        if (fd >= 0) {
+            if (apply_options(fd) != COCO_SUCCESS) {
+                ::close(fd);
+                return NULL;
+            }
+            st_netfd_t client_stfd = st_netfd_open_socket(fd);
+            if (client_stfd == NULL) {
+                ::close(fd);
+                return NULL;
+            }
+            stats_.accepted++;
+            return new TcpConn(client_stfd, (sockaddr *)&addr, addrlen);
         }
-        return NULL;
+        if (errno != EAGAIN) {
+            return NULL;
+        }
+    }
+#endif
+
+    while (ready_.empty()) {
+        // accept before wait, the backlog is not empty in a connection storm.
+        if (drain() > 0) {
+            break;
+        }
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            coco_error("accept client failed, errno=%d", errno);
+            return NULL;
+        }
+
+        // the acceptors wait for the readiness together, the first drains the backlog.
+        if (st_netfd_poll(stfd, POLLIN, ST_UTIME_NO_TIMEOUT) < 0) {
+            return NULL;
+        }
+        stats_.wakeups++;
     }
-    auto fd = st_netfd_fileno(client_stfd);
-    coco_trace("get a client. fd=%d, remote addr: %s", fd, GetRemoteAddr(fd).c_str());
-    return new TcpConn(client_stfd);
+
+    TcpConn *conn = ready_.front();
+    ready_.pop_front();
+    return conn;
+}
+
+int TcpListener::drain() {
+    int lfd = st_netfd_fileno(GetStfd());
+
+    // never more than the acceptors take right away, the queued ones are not served.
+    int max = std::min(batch_, std::max(1, accepting_ - (int)ready_.size()));
+
+    int n = 0;
+    while (n < max) {
+        sockaddr_storage addr;
+        socklen_t addrlen = sizeof(addr);
+#ifdef __linux__
+        int fd = accept4(lfd, (sockaddr *)&addr, &addrlen, SOCK_NONBLOCK | SOCK_CLOEXEC);
+#else
+        int fd = accept(lfd, (sockaddr *)&addr, &addrlen);
+        if (fd >= 0) {
+            fcntl(fd, F_SETFD, FD_CLOEXEC);
+        }
+#endif
+        if (fd < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+
+        if (apply_options(fd) != COCO_SUCCESS) {
+            ::close(fd);
+            continue;
+        }
+
+        st_netfd_t stfd = st_netfd_open_socket(fd);
+        if (stfd == NULL) {
+            coco_error("open client fd %d failed", fd);
+            ::close(fd);
+            continue;
+        }
+
+        ready_.push_back(new TcpConn(stfd, (sockaddr *)&addr, addrlen));
+        coco_info("accept client fd=%d", fd);
+        n++;
+    }
+
+    stats_.accepted += n;
+    stats_.max_batch = std::max(stats_.max_batch, n);
+    return n;
+}
+
+int TcpListener::apply_options(int fd) {
+    if (!has_opts_) {
+        return COCO_SUCCESS;
+    }
+    return ApplySocketOptions(fd, opts_, SOCK_STREAM, SocketAccepted);
 }
 
 std::string TcpListener::Addr() { return std::string(); }
 
 st_netfd_t TcpListener::GetStfd() { return conn_->GetStfd(); }
 
-TcpListener *ListenTcp(std::string local_ip, int local_port) {
+int ListenTcpFd(std::string local_ip, int local_port, bool reuse_port, int *pfd) {
+    return ListenTcpFd(local_ip, local_port, SocketOptions(), reuse_port, pfd);
+}
+
+int ListenTcpFd(std::string local_ip, int local_port, const SocketOptions &opts, bool reuse_port,
+                int *pfd) {
     int ret = COCO_SUCCESS;
     int _fd = -1;
-    st_netfd_t stfd = nullptr;
 
     char port_string[8];
     snprintf(port_string, sizeof(port_string), "%d", local_port);
@@ -66,7 +226,7 @@ TcpListener *ListenTcp(std::string local_ip, int local_port) {
     if (getaddrinfo(local_ip.c_str(), port_string, (const addrinfo *)&hints, &result) != 0) {
         ret = ERROR_SYSTEM_IP_INVALID;
         coco_error("bad address. ret=%d", ret);
-        return NULL;
+        return ret;
     }
 
     if ((_fd = socket(result->ai_family, result->ai_socktype, result->ai_protocol)) == -1) {
@@ -74,7 +234,7 @@ TcpListener *ListenTcp(std::string local_ip, int local_port) {
         coco_error("create linux socket error. tcp[%s:%d], ret=%d", local_ip.c_str(), local_port,
                    ret);
         freeaddrinfo(result);
-        return NULL;
+        return ret;
     }
     coco_dbg("create linux socket success. tcp[%s:%d], fd=%d", local_ip.c_str(), local_port, _fd);
 
@@ -82,78 +242,118 @@ TcpListener *ListenTcp(std::string local_ip, int local_port) {
     if (setsockopt(_fd, SOL_SOCKET, SO_REUSEADDR, &reuse_socket, sizeof(int)) == -1) {
         ret = ERROR_SOCKET_SETREUSE;
         coco_error("setsockopt reuse-addr error. port=%d, ret=%d", local_port, ret);
+        ::close(_fd);
         freeaddrinfo(result);
-        return NULL;
+        return ret;
     }
     coco_dbg("setsockopt reuse-addr success. port=%d, fd=%d", local_port, _fd);
 
+    // sharded mode, each worker binds its own socket and the kernel balances the accepts.
+    if (reuse_port && setsockopt(_fd, SOL_SOCKET, SO_REUSEPORT, &reuse_socket, sizeof(int)) == -1) {
+        ret = ERROR_SOCKET_SETREUSEPORT;
+        coco_error("setsockopt reuse-port error. port=%d, ret=%d", local_port, ret);
+        ::close(_fd);
+        freeaddrinfo(result);
+        return ret;
+    }
+
     if (bind(_fd, result->ai_addr, result->ai_addrlen) == -1) {
         ret = ERROR_SOCKET_BIND;
         coco_error("bind socket error. ep=%s:%d, ret=%d", local_ip.c_str(), local_port, ret);
+        ::close(_fd);
         freeaddrinfo(result);
-        return NULL;
+        return ret;
     }
     coco_dbg("bind socket success. ep=%s:%d, fd=%d", local_ip.c_str(), local_port, _fd);
+    freeaddrinfo(result);
+
+    // the window scale of accepted connections is decided by the rcvbuf before listen.
+    if ((ret = ApplySocketOptions(_fd, opts, SOCK_STREAM, SocketListener)) != COCO_SUCCESS) {
+        coco_error("set listen socket options error. ep=%s:%d, ret=%d", local_ip.c_str(),
+                   local_port, ret);
+        ::close(_fd);
+        return ret;
+    }
 
     if (::listen(_fd, SERVER_LISTEN_BACKLOG) == -1) {
         ret = ERROR_SOCKET_LISTEN;
         coco_error("listen socket error. ep=%s:%d, ret=%d", local_ip.c_str(), local_port, ret);
-        freeaddrinfo(result);
-        return NULL;
+        ::close(_fd);
+        return ret;
     }
     coco_dbg("listen socket success. ep=%s:%d, fd=%d", local_ip.c_str(), local_port, _fd);
 
+    *pfd = _fd;
+    return ret;
+}
+
+TcpListener *ListenTcp(std::string local_ip, int local_port, bool reuse_port) {
+    return ListenTcp(local_ip, local_port, SocketOptions(), reuse_port);
+}
+
+TcpListener *ListenTcp(std::string local_ip, int local_port, const SocketOptions &opts,
+                       bool reuse_port) {
+    int ret = COCO_SUCCESS;
+    int _fd = -1;
+    st_netfd_t stfd = nullptr;
+
+    // the worker of master serves the socket listened by master, which is listening already,
+    // so the options are applied after listen, and the rcvbuf never changes the window scale.
+    if ((_fd = CocoMaster::InheritedFd("tcp", local_ip, local_port)) >= 0) {
+        coco_dbg("inherit listen socket. ep=%s:%d, fd=%d", local_ip.c_str(), local_port, _fd);
+        if ((ret = ApplySocketOptions(_fd, opts, SOCK_STREAM, SocketListener)) != COCO_SUCCESS) {
+            coco_error("set listen socket options error. ep=%s:%d, ret=%d", local_ip.c_str(),
+                       local_port, ret);
+            ::close(_fd);
+            return NULL;
+        }
+    } else if (ListenTcpFd(local_ip, local_port, opts, reuse_port, &_fd) != COCO_SUCCESS) {
+        return NULL;
+    }
+
     if ((stfd = st_netfd_open_socket(_fd)) == NULL) {
         ret = ERROR_ST_OPEN_SOCKET;
         coco_error("st_netfd_open_socket open socket failed. ep=%s:%d, ret=%d", local_ip.c_str(),
                    local_port, ret);
-        freeaddrinfo(result);
+        ::close(_fd);
         return NULL;
     }
     coco_dbg("st open socket success. ep=%s:%d, fd=%d, stfd: %p", local_ip.c_str(), local_port, _fd,
              stfd);
 
     TcpListener *l = new TcpListener(new TcpConn(stfd));
-    freeaddrinfo(result);
-
+    l->SetOptions(opts);
     return l;
 }
 
 TcpConn *DialTcp(std::string dst_ip, int dst_port, int timeout) {
+    return DialTcp(dst_ip, dst_port, timeout, SocketOptions());
+}
+
+TcpConn *DialTcp(std::string dst_ip, int dst_port, int timeout, const SocketOptions &opts) {
     int ret = COCO_SUCCESS;
     int _fd = -1;
     st_netfd_t stfd = NULL;
     coco_trace("port is %d", dst_port);
 
-    char port_string[8];
-    snprintf(port_string, sizeof(port_string), "%d", dst_port);
-    addrinfo hints;
-    memset(&hints, 0, sizeof(hints));
-    hints.ai_family = AF_UNSPEC;
-    hints.ai_socktype = SOCK_STREAM;
-    addrinfo *result = NULL;
-
-    if (getaddrinfo(dst_ip.c_str(), port_string, (const addrinfo *)&hints, &result) != 0) {
-        ret = ERROR_SYSTEM_IP_INVALID;
-        coco_error("dns resolve server error, ip empty. ret=%d", ret);
-        return NULL;
-    }
-
-    // ip v4 or v6
-    char ip_c[64];
-    int success = getnameinfo(result->ai_addr, result->ai_addrlen, (char *)&ip_c, sizeof(ip_c),
-                              NULL, 0, NI_NUMERICHOST);
-    if (success != 0) {
-        freeaddrinfo(result);
-        coco_error("get ip addr from sock addr failed.");
+    // resolve by the cache or offload threads, never block the scheduler.
+    DnsAddr addr;
+    if ((ret = DnsResolver::Instance()->Resolve(dst_ip, dst_port, addr)) != COCO_SUCCESS) {
+        coco_error("dns resolve server error, host=%s. ret=%d", dst_ip.c_str(), ret);
         return NULL;
     }
 
-    _fd = socket(result->ai_family, result->ai_socktype, result->ai_protocol);
+    _fd = socket(addr.addr.ss_family, SOCK_STREAM, 0);
     if (_fd == -1) {
         ret = ERROR_SOCKET_CREATE;
         coco_error("[FATAL_SOCKET_CREATE]create socket error. ret=%d", ret);
-        freeaddrinfo(result);
+        return NULL;
+    }
+
+    // before connect, the window scale of SO_RCVBUF is negotiated by syn.
+    if ((ret = ApplySocketOptions(_fd, opts, SOCK_STREAM, SocketDialed)) != COCO_SUCCESS) {
+        coco_error("set socket options error. ret=%d", ret);
+        ::close(_fd);
         return NULL;
     }
 
@@ -163,25 +363,26 @@ TcpConn *DialTcp(std::string dst_ip, int dst_port, int timeout) {
         ret = ERROR_ST_OPEN_SOCKET;
         coco_error("st_netfd_open_socket failed. ret=%d", ret);
         ::close(_fd);
-        freeaddrinfo(result);
         return NULL;
     }
 
-    // connect to server.
-    std::string ip = ip_c;
-    if (ip.empty()) {
-        ret = ERROR_SYSTEM_IP_INVALID;
-        coco_error("dns resolve server error[%s], ip empty. ret=%d", ip.c_str(), ret);
+    // the dns may use up the deadline of coroutine context.
+    int64_t connect_timeout;
+    if ((ret = CocoContext::IoTimeout(timeout, &connect_timeout)) != COCO_SUCCESS) {
+        coco_error("connect to server canceled. ip=%s, port=%d, ret=%d", addr.ip.c_str(),
+                   dst_port, ret);
         goto failed;
     }
 
-    if (st_connect(stfd, result->ai_addr, result->ai_addrlen, timeout) == -1) {
+    // connect to server.
+    if (coco_connect(stfd, (sockaddr *)&addr.addr, addr.len, connect_timeout) == -1) {
         ret = ERROR_ST_CONNECT;
-        coco_error("connect to server error. ip=%s, port=%d, ret=%d", ip_c, dst_port, ret);
+        coco_error("connect to server error. ip=%s, port=%d, ret=%d", addr.ip.c_str(), dst_port,
+                   ret);
         goto failed;
     }
 
-    coco_info("connect ok. server=%s, ip=%s, port=%d", ip.c_str(), ip_c, dst_port);
+    coco_info("connect ok. server=%s, ip=%s, port=%d", dst_ip.c_str(), addr.ip.c_str(), dst_port);
 
     return new TcpConn(stfd);
 
@@ -191,6 +392,5 @@ failed:
         assert(st_netfd_close(stfd) != -1);
         stfd = NULL;
     }
-    freeaddrinfo(result);
     return NULL;
 }
\ No newline at end of file
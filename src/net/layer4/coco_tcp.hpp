@@ -1,20 +1,42 @@
 #pragma once
 
+#include <sys/socket.h>
 #include <unistd.h>
 #include <algorithm>
+#include <deque>
 #include <string>
 #include <vector>
 
 #include "net/coco_socket.hpp"
+#include "net/coco_sockopt.hpp"
 #include "net/layer4/coco_layer4.hpp"
 
+// the max connections accepted in one readiness of listener.
+#define COCO_ACCEPT_BATCH 64
+
 class TcpConn : public StreamConn {
  public:
     TcpConn(st_netfd_t _stfd);
+    // the accepted conn with the peer address, never getpeername for it.
+    TcpConn(st_netfd_t _stfd, const sockaddr *addr, socklen_t addrlen);
     virtual ~TcpConn() = default;
 
  public:
+    // the ip:port of peer, formatted once.
     virtual std::string RemoteAddr();
+
+ private:
+    sockaddr_storage peer_;
+    bool has_peer_ = false;
+    std::string remote_addr_;
+};
+
+struct TcpListenerStats {
+    uint64_t accepted = 0;
+    // the readiness events waited by the acceptors.
+    uint64_t wakeups = 0;
+    // the max connections accepted in one drain.
+    int max_batch = 0;
 };
 
 class TcpListener {
@@ -23,7 +45,25 @@ class TcpListener {
     virtual ~TcpListener();
 
     virtual int Close() { return 0; };
+    /**
+     * accept a connection, the backlog is drained in each readiness, and the accepted
+     * connections are queued, so many acceptor coroutines can share the listener.
+     * @return nullptr when interrupted or failed, see errno.
+     * @remark the connections drained are never more than the acceptors in Accept(), so they
+     *      are taken right away, and the acceptors paused by the limits never get more.
+     */
     virtual TcpConn *Accept();
+    // the max connections accepted in one readiness, 1 to accept one by one.
+    void SetAcceptBatch(int v) { batch_ = std::max(1, v); }
+    // take a connection accepted but not taken by Accept(), nullptr when none, for example to
+    // serve them before the listener is freed, which closes them.
+    TcpConn *PopReady();
+    TcpListenerStats Stats() { return stats_; }
+    // the options of accepted connections, see ListenTcp().
+    void SetOptions(const SocketOptions &opts) {
+        opts_ = opts;
+        has_opts_ = true;
+    }
     virtual std::string Addr();
     virtual st_netfd_t GetStfd();
     virtual void SetRecvTimeout(int64_t timeout_us) { conn_->SetRecvTimeout(timeout_us); };
@@ -33,6 +73,30 @@ class TcpListener {
         conn_->SetSendTimeout(timeout_us);
     }
 
+ private:
+    TcpConn *accept_one();
+    // accept the backlog until EAGAIN, the batch is full or each acceptor gets one.
+    int drain();
+    // apply the options to the accepted fd.
+    int apply_options(int fd);
+
  private:
     TcpConn *conn_;
-};
\ No newline at end of file
+    int batch_ = COCO_ACCEPT_BATCH;
+    // the acceptors in Accept(), which take the connections drained.
+    int accepting_ = 0;
+    std::deque<TcpConn *> ready_;
+    TcpListenerStats stats_;
+    SocketOptions opts_;
+    bool has_opts_ = false;
+};
+
+/**
+ * create the listen socket without st, for the master to listen before forking workers.
+ * @remark the caller owns the fd, see ListenTcp() for the listener of st.
+ */
+int ListenTcpFd(std::string local_ip, int local_port, bool reuse_port, int *pfd);
+// the options are applied between bind and listen, so the rcvbuf takes effect on the window
+// scale of the accepted connections.
+int ListenTcpFd(std::string local_ip, int local_port, const SocketOptions &opts, bool reuse_port,
+                int *pfd);
@@ -5,9 +5,12 @@
 #include <string.h>
 #include <algorithm>
 
+#include "base/coco_master.hpp"
 #include "coco_api.h"
 #include "common/error.hpp"
 #include "log/log.hpp"
+#include "net/coco_dns.hpp"
+#include "net/coco_sockopt.hpp"
 #include "utils/utils.hpp"
 
 UdpConn::UdpConn(st_netfd_t stfd) : DatagramConn(stfd) {}
@@ -41,11 +44,9 @@ int UdpListener::SendTo(void *buf, int size, ssize_t *nwrite, struct sockaddr *t
     return conn_->SendTo(buf, size, nwrite, to, tolen);
 }
 
-// helper function
-UdpListener *ListenUdp(std::string local_ip, int local_port) {
+int ListenUdpFd(std::string local_ip, int local_port, bool reuse_port, int *pfd) {
     int ret = COCO_SUCCESS;
     int _fd = -1;
-    st_netfd_t stfd = NULL;
 
     char port_string[8];
     snprintf(port_string, sizeof(port_string), "%d", local_port);
@@ -58,7 +59,7 @@ UdpListener *ListenUdp(std::string local_ip, int local_port) {
     if (getaddrinfo(local_ip.c_str(), port_string, (const addrinfo *)&hints, &result) != 0) {
         ret = ERROR_SYSTEM_IP_INVALID;
         coco_error("bad address. ret=%d", ret);
-        return NULL;
+        return ret;
     }
 
     if ((_fd = socket(result->ai_family, result->ai_socktype, result->ai_protocol)) == -1) {
@@ -66,70 +67,101 @@ UdpListener *ListenUdp(std::string local_ip, int local_port) {
         coco_error("create linux socket error. udp[%s:%d], ret=%d", local_ip.c_str(), local_port,
                    ret);
         freeaddrinfo(result);
-        return NULL;
+        return ret;
     }
     coco_dbg("create linux socket success. udp[%s:%d], fd=%d", local_ip.c_str(), local_port, _fd);
 
+    // sharded mode, the kernel hashes datagrams to the sockets bound by each worker.
+    int reuse_socket = 1;
+    if (reuse_port && setsockopt(_fd, SOL_SOCKET, SO_REUSEPORT, &reuse_socket, sizeof(int)) == -1) {
+        ret = ERROR_SOCKET_SETREUSEPORT;
+        coco_error("setsockopt reuse-port error. udp[%s:%d], ret=%d", local_ip.c_str(), local_port,
+                   ret);
+        ::close(_fd);
+        freeaddrinfo(result);
+        return ret;
+    }
+
     if (bind(_fd, result->ai_addr, result->ai_addrlen) == -1) {
         ret = ERROR_SOCKET_BIND;
         coco_error("bind socket error. udp[%s:%d], ret=%d", local_ip.c_str(), local_port, ret);
+        ::close(_fd);
         freeaddrinfo(result);
-        return NULL;
+        return ret;
     }
     coco_dbg("bind socket success. udp[%s:%d], fd=%d", local_ip.c_str(), local_port, _fd);
+    freeaddrinfo(result);
+
+    *pfd = _fd;
+    return ret;
+}
+
+// helper function
+UdpListener *ListenUdp(std::string local_ip, int local_port, bool reuse_port) {
+    return ListenUdp(local_ip, local_port, SocketOptions(), reuse_port);
+}
+
+UdpListener *ListenUdp(std::string local_ip, int local_port, const SocketOptions &opts,
+                       bool reuse_port) {
+    int ret = COCO_SUCCESS;
+    int _fd = -1;
+    st_netfd_t stfd = NULL;
+
+    // the worker of master serves the socket bound by master.
+    if ((_fd = CocoMaster::InheritedFd("udp", local_ip, local_port)) >= 0) {
+        coco_dbg("inherit udp socket. udp[%s:%d], fd=%d", local_ip.c_str(), local_port, _fd);
+    } else if (ListenUdpFd(local_ip, local_port, reuse_port, &_fd) != COCO_SUCCESS) {
+        return NULL;
+    }
+
+    if ((ret = ApplySocketOptions(_fd, opts, SOCK_DGRAM, SocketListener)) != COCO_SUCCESS) {
+        coco_error("set udp socket options error. udp[%s:%d], ret=%d", local_ip.c_str(),
+                   local_port, ret);
+        ::close(_fd);
+        return NULL;
+    }
 
     if ((stfd = st_netfd_open_socket(_fd)) == NULL) {
         ret = ERROR_ST_OPEN_SOCKET;
         coco_error("st_netfd_open_socket open socket failed. ep=%s:%d, ret=%d", local_ip.c_str(),
                    local_port, ret);
-        freeaddrinfo(result);
+        ::close(_fd);
         return NULL;
     }
     coco_dbg("st open socket success. ep=%s:%d, fd=%d, stfd: %p", local_ip.c_str(), local_port, _fd,
              stfd);
 
-    UdpListener *l = new UdpListener(new UdpConn(stfd));
-    freeaddrinfo(result);
-
-    return l;
+    return new UdpListener(new UdpConn(stfd));
 }
 
 UdpConn *DialUdp(std::string dst_ip, int dst_port, int timeout) {
+    return DialUdp(dst_ip, dst_port, timeout, SocketOptions());
+}
+
+UdpConn *DialUdp(std::string dst_ip, int dst_port, int timeout, const SocketOptions &opts) {
     int ret = COCO_SUCCESS;
     int _fd = -1;
     st_netfd_t stfd = NULL;
     UdpConn *conn = nullptr;
     // coco_trace("ip: %s, port is %d", dst_ip.c_str(), dst_port);
 
-    char port_string[8];
-    snprintf(port_string, sizeof(port_string), "%d", dst_port);
-    addrinfo hints;
-    memset(&hints, 0, sizeof(hints));
-    hints.ai_family = AF_UNSPEC;
-    hints.ai_socktype = SOCK_DGRAM;
-    addrinfo *result = NULL;
-
-    if (getaddrinfo(dst_ip.c_str(), port_string, (const addrinfo *)&hints, &result) != 0) {
-        ret = ERROR_SYSTEM_IP_INVALID;
-        coco_error("dns resolve server error, ip empty. ret=%d", ret);
+    // resolve by the cache or offload threads, never block the scheduler.
+    DnsAddr addr;
+    if ((ret = DnsResolver::Instance()->Resolve(dst_ip, dst_port, addr)) != COCO_SUCCESS) {
+        coco_error("dns resolve server error, host=%s. ret=%d", dst_ip.c_str(), ret);
         return NULL;
     }
 
-    // ip v4 or v6
-    char ip_c[64];
-    int success = getnameinfo(result->ai_addr, result->ai_addrlen, (char *)&ip_c, sizeof(ip_c),
-                              NULL, 0, NI_NUMERICHOST);
-    if (success != 0) {
-        freeaddrinfo(result);
-        coco_error("get ip addr from sock addr failed.");
-        return NULL;
-    }
-
-    _fd = socket(result->ai_family, result->ai_socktype, result->ai_protocol);
+    _fd = socket(addr.addr.ss_family, SOCK_DGRAM, 0);
     if (_fd == -1) {
         ret = ERROR_SOCKET_CREATE;
         coco_error("[FATAL_SOCKET_CREATE]create socket error. ret=%d", ret);
-        freeaddrinfo(result);
+        return NULL;
+    }
+
+    if ((ret = ApplySocketOptions(_fd, opts, SOCK_DGRAM, SocketDialed)) != COCO_SUCCESS) {
+        coco_error("set udp socket options error. ret=%d", ret);
+        ::close(_fd);
         return NULL;
     }
 
@@ -139,28 +171,10 @@ UdpConn *DialUdp(std::string dst_ip, int dst_port, int timeout) {
         ret = ERROR_ST_OPEN_SOCKET;
         coco_error("st_netfd_open_socket failed. ret=%d", ret);
         ::close(_fd);
-        freeaddrinfo(result);
         return NULL;
     }
 
-    // connect to server.
-    std::string ip = ip_c;
-    if (ip.empty()) {
-        ret = ERROR_SYSTEM_IP_INVALID;
-        coco_error("dns resolve server error[%s], ip empty. ret=%d", ip.c_str(), ret);
-        goto failed;
-    }
-
-    conn = new UdpConn(stfd, *result->ai_addr, result->ai_addrlen);
+    conn = new UdpConn(stfd, *(sockaddr *)&addr.addr, addr.len);
     conn->SetSendTimeout(timeout);
     return conn;
-
-failed:
-    if (stfd) {
-        // we must ensure the close is ok.
-        assert(st_netfd_close(stfd) != -1);
-        stfd = NULL;
-    }
-    freeaddrinfo(result);
-    return NULL;
 }
\ No newline at end of file
@@ -15,14 +15,15 @@ class UdpConn : public DatagramConn {
     virtual ~UdpConn() = default;
 
     virtual int Read(void *buf, int size, ssize_t *nread) {
-        return RecvFrom(buf, size, nread, &dst_addr, &dst_addr_len);
+        return RecvFrom(buf, size, nread, (sockaddr *)&dst_addr, &dst_addr_len);
     };
     virtual int Write(void *buf, int size, ssize_t *nwrite) {
-        return SendTo(buf, size, nwrite, &dst_addr, dst_addr_len);
+        return SendTo(buf, size, nwrite, (sockaddr *)&dst_addr, dst_addr_len);
     }
 
  private:
-    sockaddr dst_addr;
+    // large enough for ipv6.
+    sockaddr_storage dst_addr;
     int dst_addr_len{0};
 };
 
@@ -48,4 +49,7 @@ class UdpListener {
 
  private:
     UdpConn *conn_;
-};
\ No newline at end of file
+};
+
+// create the bound socket without st, for the master to bind before forking workers.
+int ListenUdpFd(std::string local_ip, int local_port, bool reuse_port, int *pfd);
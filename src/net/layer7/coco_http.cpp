@@ -5,6 +5,7 @@
 #include <string.h>
 #include <algorithm>
 
+#include "base/coco_runtime.hpp"
 #include "coco_api.h"
 #include "common/error.hpp"
 #include "log/log.hpp"
@@ -75,13 +76,23 @@ int HttpServerConn::DoCycle() {
             coco_error("api initialize http parser failed. ret=%d", ret);
             return ret;
         }
-        // get a http message
-        if ((ret = http_msg_->Parse(conn_, this)) != COCO_SUCCESS) {
+        // get a http message, the connection is idle until the first byte of request arrives,
+        // and interrupted when draining.
+        idle_ = true;
+        http_msg_->SetMessageBeginHandler([this]() { idle_ = false; });
+        ret = http_msg_->Parse(conn_, this);
+        idle_ = false;
+        if (ret != COCO_SUCCESS) {
             return ret;
         }
 
         // ok, handle http request.
         HttpResponseWriter writer(conn_);
+        // the last request when draining, the client should reconnect to others.
+        bool draining = CocoIsDraining();
+        if (draining) {
+            writer.header()->set("Connection", "close");
+        }
         if ((ret = ProcessRequest(&writer, http_msg_)) != COCO_SUCCESS) {
             return ret;
         }
@@ -95,8 +106,10 @@ int HttpServerConn::DoCycle() {
             }
         }
 
-        // donot keep alive, disconnect it.
-        if (!http_msg_->is_keep_alive()) {
+        // donot keep alive, disconnect it, the response is flushed by reading the next request.
+        // the drain may start while processing, close it without waiting for the next request.
+        if (!http_msg_->is_keep_alive() || draining || CocoIsDraining()) {
+            ret = conn_->Flush();
             break;
         }
     }
@@ -104,27 +117,69 @@ int HttpServerConn::DoCycle() {
     return ret;
 }
 
+void HttpServerConn::Drain() {
+    // no request in processing, never wait for the next one.
+    if (idle_) {
+        Interrupt();
+    }
+}
+
+// the extra coroutine to accept for HttpServer.
+class HttpAcceptor : public CoroutineHandler {
+ public:
+    HttpAcceptor(HttpServer *server) : server_(server) {
+        coroutine = new CoCoroutine("acceptor", this);
+    }
+    virtual ~HttpAcceptor() { coco_freep(coroutine); }
+
+    int Start() { return coroutine->start(); }
+    void Stop() { coroutine->stop(); }
+    virtual int Cycle() { return server_->accept_cycle(this); }
+
+ private:
+    HttpServer *server_;
+};
+
 /* HttpServer */
 HttpServer::HttpServer(bool https) {
     _l = nullptr;
     _mux = nullptr;
     https_ = https;
-    manager = new ConnManager();
+
+    // in a runtime worker, the conns are managed by the worker's scheduler.
+    CocoWorker *worker = CocoRuntime::Current();
+    if (worker != nullptr) {
+        manager = worker->GetConnManager();
+        own_manager_ = false;
+    } else {
+        manager = new ConnManager();
+        own_manager_ = true;
+    }
 }
 
 HttpServer::~HttpServer() {
+    for (auto a : acceptors_) {
+        coco_freep(a);
+    }
+    acceptors_.clear();
+
+    // the conns of shared manager may live longer than us.
+    if (manager && !own_manager_) {
+        manager->Detach(&quota_);
+    }
     if (_l) {
         delete _l;
         _l = nullptr;
     }
-    if (manager) {
+    if (manager && own_manager_) {
         delete manager;
-        manager = nullptr;
     }
+    manager = nullptr;
 }
 
 int HttpServer::ListenAndServe(std::string local_ip, int local_port, HttpServeMux *mux) {
-    _l = ListenTcp(local_ip, local_port);
+    // each runtime worker listens on its own SO_REUSEPORT shard.
+    _l = ListenTcp(local_ip, local_port, CocoRuntime::Current() != nullptr);
     if (_l == nullptr) {
         coco_error("create http listen socket failed");
         return -1;
@@ -140,28 +195,115 @@ int HttpServer::Serve(TcpListener *l, HttpServeMux *mux) {
     return 0;
 }
 
-int HttpServer::Cycle() {
-    while (true) {
-        manager->Destroy();
+int HttpServer::SetAcceptors(int n) {
+    int ret = COCO_SUCCESS;
+
+    // the listen coroutine is the first acceptor.
+    while ((int)acceptors_.size() < n - 1) {
+        HttpAcceptor *a = new HttpAcceptor(this);
+        if ((ret = a->Start()) != COCO_SUCCESS) {
+            coco_error("start http acceptor failed. ret=%d", ret);
+            coco_freep(a);
+            return ret;
+        }
+        acceptors_.push_back(a);
+    }
+    return ret;
+}
+
+int HttpServer::Cycle() { return accept_cycle(this); }
+
+int HttpServer::accept_cycle(CoroutineHandler *h) {
+    while (!h->ShouldTermCycle()) {
+        // over the limits, stop accepting, or accept and reject.
+        bool admitted = manager->Admit(&quota_);
+        if (!admitted && quota_.policy == ConnOverloadPause) {
+            if (manager->WaitAdmit(&quota_) != COCO_SUCCESS) {
+                continue;
+            }
+            admitted = true;
+        }
 
         TcpConn *conn_ = _l->Accept();
         if (conn_ == nullptr) {
+            // stopped when shutdown.
+            if (h->ShouldTermCycle()) {
+                break;
+            }
             coco_error("get null conn");
             continue;
         }
-        HttpServerConn *conn = nullptr;
-        if (https_) {
-            auto ssl = new SslServer(conn_->GetStfd(), conn_);
-            conn = new HttpServerConn(manager, ssl, _mux);
-        } else {
-            conn = new HttpServerConn(manager, conn_, _mux);
+        if (!admitted) {
+            reject(conn_);
+            continue;
         }
 
-        conn->Start();
+        serve(conn_);
     }
     return 0;
 }
 
+void HttpServer::serve(TcpConn *conn_) {
+    HttpServerConn *conn = nullptr;
+    StreamConn *stream = conn_;
+    if (https_) {
+        auto ssl = new SslServer(conn_->GetStfd(), conn_);
+        conn = new HttpServerConn(manager, ssl, _mux);
+        stream = ssl;
+    } else {
+        conn = new HttpServerConn(manager, conn_, _mux);
+    }
+    if (write_buffer_size_ > 0) {
+        stream->EnableWriteBuffer(write_buffer_size_);
+    }
+    manager->Attach(conn, &quota_);
+
+    conn->Start();
+}
+
+void HttpServer::SetConnLimit(int max_conns, ConnOverloadPolicy policy) {
+    quota_.max_conns = coco_max(max_conns, 0);
+    quota_.policy = policy;
+}
+
+void HttpServer::reject(TcpConn *conn) {
+    manager->Reject(&quota_);
+    coco_warn("reject conn %s, conns=%d", conn->RemoteAddr().c_str(), quota_.conns);
+
+    // the ssl handshake is too expensive for a rejection, just close it.
+    if (!https_) {
+        static const char resp[] =
+            "HTTP/1.1 503 Service Unavailable\r\n"
+            "Content-Length: 0\r\n"
+            "Retry-After: 1\r\n"
+            "Connection: close\r\n\r\n";
+        // a fresh socket never blocks for the small response, but never wait if it does.
+        conn->SetSendTimeout(HTTP_REJECT_TIMEOUT_US);
+        conn->Write((void *)resp, sizeof(resp) - 1, nullptr);
+    }
+
+    coco_freep(conn);
+}
+
+void HttpServer::Stop() {
+    ListenRoutine::Stop();
+    for (auto a : acceptors_) {
+        a->Stop();
+    }
+
+    // the connections accepted but not taken by the acceptors are served, never dropped, and
+    // drained with the others when draining.
+    if (_l) {
+        TcpConn *conn = nullptr;
+        while ((conn = _l->PopReady()) != nullptr) {
+            serve(conn);
+        }
+    }
+
+    // close the listener, the new connections go to the other servers.
+    coco_freep(_l);
+}
+
 HttpClient::~HttpClient() {
     Disconnect();
     coco_freep(http_msg_);
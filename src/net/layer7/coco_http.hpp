@@ -20,14 +20,19 @@ class HttpServerConn : public ConnRoutine {
     virtual int DoCycle();
     int ProcessRequest(HttpResponseWriter *w, HttpMessage *r);
     virtual std::string GetRemoteAddr() { return conn_->RemoteAddr(); };
+    virtual void Drain();
 
  private:
     StreamConn *conn_ = nullptr;
+    // wait for the next request, no byte of it received.
+    bool idle_ = false;
     HttpServeMux *_mux = nullptr;
     HttpMessage *http_msg_ = nullptr;
     bool https_ = false;
 };
 
+class HttpAcceptor;
+
 class HttpServer : public ListenRoutine {
  public:
     HttpServer(bool https);
@@ -36,12 +41,38 @@ class HttpServer : public ListenRoutine {
     virtual int ListenAndServe(std::string local_ip, int local_port, HttpServeMux *mux);
     virtual int Serve(TcpListener *l, HttpServeMux *mux);
     virtual int Cycle();
+    // stop accepting and close the listener.
+    virtual void Stop();
+    // the coroutines to accept, which share the listener, 1 by default.
+    int SetAcceptors(int n);
+    // limit the connections of this server, and what to do when over the limits.
+    void SetConnLimit(int max_conns, ConnOverloadPolicy policy);
+    // the admission metrics of this server.
+    ConnQuota Quota() { return quota_; }
+    // coalesce the small writes of each connection, see StreamConn::EnableWriteBuffer().
+    // @remark the streaming handler should HttpResponseWriter::Flush() each message.
+    void SetWriteBuffer(size_t size) { write_buffer_size_ = size; }
+
+ private:
+    friend class HttpAcceptor;
+    // accept and serve the connections, until the acceptor h terminates.
+    int accept_cycle(CoroutineHandler *h);
+    // reply 503 and close the connection rejected by the limits.
+    void reject(TcpConn *conn);
+    // start the coroutine to serve the accepted connection.
+    void serve(TcpConn *conn);
 
  private:
     TcpListener *_l;
     HttpServeMux *_mux;
     ConnManager *manager;
+    bool own_manager_ = true;
     bool https_ = false;
+    ConnQuota quota_;
+    // the size of write buffer of connections, 0 to write through.
+    size_t write_buffer_size_ = 0;
+    // the acceptors besides the listen coroutine.
+    std::vector<HttpAcceptor *> acceptors_;
 };
 
 // the default timeout for http client. 1s
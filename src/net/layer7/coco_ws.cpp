@@ -1,4 +1,6 @@
 #include "net/layer7/coco_ws.hpp"
+#include <string.h>
+
 #include "utils/base64.hpp"
 #include "utils/sha1.hpp"
 
@@ -23,15 +25,8 @@
  +---------------------------------------------------------------+
  */
 
-#define CHECK_LEN(size)                                     \
-    do {                                                    \
-        if (len - (ptr - data) < size) {                    \
-            if (cur_msg_->cache_.empty()) {                 \
-                cur_msg_->cache_.assign((char *)data, len); \
-            }                                               \
-            return;                                         \
-        }                                                   \
-    } while (0)
+// the max size of frame header, with the 64 bits payload length and mask.
+#define WS_MAX_HEADER_SIZE 14
 
 WebSocketConn::WebSocketConn(void *observer, ConnManager *mgr, StreamConn *conn, HttpMessage *r)
     : ConnRoutine(mgr) {
@@ -103,136 +98,171 @@ void WebSocketConn::ProcessMessage(std::unique_ptr<WebSocektMessage> msg) {
 }
 
 void WebSocketConn::decode(uint8_t *data, size_t len) {
-    if (cur_msg_ == nullptr) {
-        cur_msg_.reset(new WebSocektMessage());
-    }
+    inbuf_.Append(data, len);
+    decode_frames();
+}
 
-    uint8_t *ptr = data;
-    if (!cur_msg_->got_header_) {
-        //还没有获取数据头
-        if (!cur_msg_->cache_.empty()) {
-            cur_msg_->cache_.append((char *)data, len);
-            data = ptr = (uint8_t *)cur_msg_->cache_.data();
-            len = cur_msg_->cache_.size();
+void WebSocketConn::decode_frames() {
+    while (true) {
+        if (cur_msg_ == nullptr) {
+            cur_msg_.reset(new WebSocektMessage());
         }
 
-        CHECK_LEN(1);
-        cur_msg_->header_._fin = (*ptr & 0x80) >> 7;
-        cur_msg_->header_._reserved = (*ptr & 0x70) >> 4;
-        cur_msg_->header_._opcode = (WebSocketHeader::Type)(*ptr & 0x0F);
-        if (!cur_msg_->is_fragmented) {
-            cur_msg_->_opcode = cur_msg_->header_._opcode;
-            if (cur_msg_->_opcode == WebSocketHeader::CONTINUATION) {
-                // error
+        if (!cur_msg_->got_header_) {
+            //还没有获取数据头
+            if (inbuf_.Size() < 2) {
+                return;
             }
-        }
-        ptr += 1;
-
-        CHECK_LEN(1);
-        cur_msg_->header_._mask_flag = (*ptr & 0x80) >> 7;
-        cur_msg_->header_._payload_len = (*ptr & 0x7F);
-        ptr += 1;
-
-        if (cur_msg_->header_._payload_len == 126) {
-            CHECK_LEN(2);
-            cur_msg_->header_._payload_len = (*ptr << 8) | *(ptr + 1);
-            ptr += 2;
-        } else if (cur_msg_->header_._payload_len == 127) {
-            CHECK_LEN(8);
-            cur_msg_->header_._payload_len =
-                ((uint64_t)ptr[0] << (8 * 7)) | ((uint64_t)ptr[1] << (8 * 6)) |
-                ((uint64_t)ptr[2] << (8 * 5)) | ((uint64_t)ptr[3] << (8 * 4)) |
-                ((uint64_t)ptr[4] << (8 * 3)) | ((uint64_t)ptr[5] << (8 * 2)) |
-                ((uint64_t)ptr[6] << (8 * 1)) | ((uint64_t)ptr[7] << (8 * 0));
-            ptr += 8;
-        }
-        if (cur_msg_->header_._mask_flag) {
-            CHECK_LEN(4);
-            cur_msg_->header_._mask.assign(ptr, ptr + 4);
-            ptr += 4;
-        }
-        // 读取到协议头
-        cur_msg_->got_header_ = true;
-
-        _mask_offset = 0;
-    }
-
-    //进入后面逻辑代表已经获取到了webSocket协议头，
-    auto remain = len - (ptr - data);
-    if (cur_msg_->header_._payload_len != 0) {
-        if (remain > 0) {
-            auto copy_len = remain;
-            if (remain + cur_msg_->header_.payload_offset_ > cur_msg_->header_._payload_len) {
-                copy_len = cur_msg_->header_._payload_len - cur_msg_->data_.size();
+            uint8_t *ptr = (uint8_t *)inbuf_.Peek(2);
+            size_t header_size = 2;
+            if ((ptr[1] & 0x7F) == 126) {
+                header_size += 2;
+            } else if ((ptr[1] & 0x7F) == 127) {
+                header_size += 8;
+            }
+            if (ptr[1] & 0x80) {
+                header_size += 4;
+            }
+            if (inbuf_.Size() < header_size) {
+                return;
             }
-            cur_msg_->header_.payload_offset_ += copy_len;
-
-            remain -= copy_len;
 
-            // mask
+            // the header is copied only when across the blocks.
+            ptr = (uint8_t *)inbuf_.Peek(header_size);
+            cur_msg_->header_._fin = (*ptr & 0x80) >> 7;
+            cur_msg_->header_._reserved = (*ptr & 0x70) >> 4;
+            cur_msg_->header_._opcode = (WebSocketHeader::Type)(*ptr & 0x0F);
+            if (!cur_msg_->is_fragmented) {
+                cur_msg_->_opcode = cur_msg_->header_._opcode;
+            }
+            ptr += 1;
+
+            cur_msg_->header_._mask_flag = (*ptr & 0x80) >> 7;
+            cur_msg_->header_._payload_len = (*ptr & 0x7F);
+            ptr += 1;
+
+            if (cur_msg_->header_._payload_len == 126) {
+                cur_msg_->header_._payload_len = (ptr[0] << 8) | ptr[1];
+                ptr += 2;
+            } else if (cur_msg_->header_._payload_len == 127) {
+                cur_msg_->header_._payload_len =
+                    ((uint64_t)ptr[0] << (8 * 7)) | ((uint64_t)ptr[1] << (8 * 6)) |
+                    ((uint64_t)ptr[2] << (8 * 5)) | ((uint64_t)ptr[3] << (8 * 4)) |
+                    ((uint64_t)ptr[4] << (8 * 3)) | ((uint64_t)ptr[5] << (8 * 2)) |
+                    ((uint64_t)ptr[6] << (8 * 1)) | ((uint64_t)ptr[7] << (8 * 0));
+                ptr += 8;
+            }
             if (cur_msg_->header_._mask_flag) {
-                for (size_t i = 0; i < copy_len; ++i) {
-                    *(ptr + i) ^= cur_msg_->header_._mask[(i + _mask_offset) % 4];
-                }
-                _mask_offset = (_mask_offset + copy_len) % 4;
+                cur_msg_->header_._mask.assign(ptr, ptr + 4);
+                ptr += 4;
             }
+            inbuf_.Skip(header_size);
 
-            cur_msg_->data_.append((char *)ptr, copy_len);
+            // 读取到协议头
+            cur_msg_->got_header_ = true;
+            cur_msg_->header_.payload_offset_ = 0;
+            _mask_offset = 0;
         }
-    }
 
-    // get whole payload
-    if (cur_msg_->header_.payload_offset_ == cur_msg_->header_._payload_len) {
-        ProcessMessage(std::move(cur_msg_));
+        // the payload is copied from the blocks to message, and unmasked in message.
+        WebSocketHeader &header = cur_msg_->header_;
+        while (header.payload_offset_ < header._payload_len && !inbuf_.Empty()) {
+            char *data = nullptr;
+            size_t size = inbuf_.Front(&data);
+            size = coco_min(size, header._payload_len - header.payload_offset_);
+
+            size_t pos = cur_msg_->data_.size();
+            cur_msg_->data_.append(data, size);
+            inbuf_.Skip(size);
+            header.payload_offset_ += size;
+
+            if (header._mask_flag) {
+                char *p = &cur_msg_->data_[pos];
+                for (size_t i = 0; i < size; ++i) {
+                    p[i] ^= header._mask[(i + _mask_offset) % 4];
+                }
+                _mask_offset = (_mask_offset + size) % 4;
+            }
+        }
 
-        if (remain > 0 && remain <= len) {
-            //解析下一个包
-            decode(data + (len - remain), remain);
+        // wait for the whole payload.
+        if (header.payload_offset_ < header._payload_len) {
+            return;
         }
+        ProcessMessage(std::move(cur_msg_));
     }
 }
 
-std::string WebSocketConn::Encode(WebSocketHeader &header, uint8_t *buffer, uint32_t size) {
-    std::string ret;
-    uint64_t len = size;
-    uint8_t byte = header._fin << 7 | ((header._reserved & 0x07) << 4) | (header._opcode & 0x0F);
-    ret.push_back(byte);
+int WebSocketConn::encode_header(WebSocketHeader &header, uint64_t len, uint8_t *out) {
+    uint8_t *p = out;
+    *p++ = header._fin << 7 | ((header._reserved & 0x07) << 4) | (header._opcode & 0x0F);
 
     auto mask_flag = (header._mask_flag && header._mask.size() >= 4);
-    byte = mask_flag << 7;
+    uint8_t byte = mask_flag << 7;
 
     if (len < 126) {
-        byte |= len;
-        ret.push_back(byte);
+        *p++ = byte | len;
     } else if (len <= 0xFFFF) {
-        byte |= 126;
-        ret.push_back(byte);
+        *p++ = byte | 126;
 
         uint16_t len_low = htons((uint16_t)len);
-        ret.append((char *)&len_low, 2);
+        memcpy(p, &len_low, 2);
+        p += 2;
     } else {
-        byte |= 127;
-        ret.push_back(byte);
+        *p++ = byte | 127;
 
         uint32_t len_high = htonl(len >> 32);
         uint32_t len_low = htonl(len & 0xFFFFFFFF);
-        ret.append((char *)&len_high, 4);
-        ret.append((char *)&len_low, 4);
+        memcpy(p, &len_high, 4);
+        memcpy(p + 4, &len_low, 4);
+        p += 8;
     }
     if (mask_flag) {
-        ret.append((char *)header._mask.data(), 4);
+        memcpy(p, header._mask.data(), 4);
+        p += 4;
     }
 
-    if (len > 0) {
-        if (mask_flag) {
-            uint8_t *ptr = buffer;
-            for (size_t i = 0; i < len; ++i, ++ptr) {
-                *(ptr) ^= header._mask[i % 4];
-            }
-        }
+    return (int)(p - out);
+}
+
+void WebSocketConn::mask_payload(WebSocketHeader &header, uint8_t *buffer, uint64_t len) {
+    if (!header._mask_flag || header._mask.size() < 4) {
+        return;
     }
 
-    return ret;
+    uint8_t *ptr = buffer;
+    for (size_t i = 0; i < len; ++i, ++ptr) {
+        *(ptr) ^= header._mask[i % 4];
+    }
+}
+
+std::string WebSocketConn::Encode(WebSocketHeader &header, uint8_t *buffer, uint32_t size) {
+    uint8_t hdr[WS_MAX_HEADER_SIZE];
+    int nb_hdr = encode_header(header, size, hdr);
+    mask_payload(header, buffer, size);
+
+    return std::string((char *)hdr, nb_hdr);
+}
+
+int WebSocketConn::Frame(Buffer *msg, WebSocketHeader::Type data_type, bool mask) {
+    WebSocketHeader header;
+    header._fin = true;
+    header._reserved = 0;
+    header._opcode = data_type;
+    header._mask_flag = mask;
+
+    uint8_t hdr[WS_MAX_HEADER_SIZE];
+    int nb_hdr = encode_header(header, msg->Size(), hdr);
+    if (msg->Headroom() < (size_t)nb_hdr) {
+        coco_error("ws: no headroom for frame header, headroom=%d, header=%d",
+                   (int)msg->Headroom(), nb_hdr);
+        return ERROR_BUFFER_NO_ROOM;
+    }
+
+    mask_payload(header, msg->Data(), msg->Size());
+    memcpy(msg->Prepend(nb_hdr), hdr, nb_hdr);
+
+    return COCO_SUCCESS;
 }
 
 int WebSocketConn::Send(uint8_t *buf, ssize_t len, WebSocketHeader::Type data_type) {
@@ -243,31 +273,40 @@ int WebSocketConn::Send(uint8_t *buf, ssize_t len, WebSocketHeader::Type data_ty
     //客户端需要加密
     header._mask_flag = true;
 
-    std::string sh = Encode(header, buf, len);
+    uint8_t hdr[WS_MAX_HEADER_SIZE];
+    int nb_hdr = encode_header(header, len, hdr);
+    mask_payload(header, buf, len);
+
+    // the header and payload by one syscall.
+    iovec iovs[2];
+    iovs[0].iov_base = hdr;
+    iovs[0].iov_len = nb_hdr;
+    iovs[1].iov_base = buf;
+    iovs[1].iov_len = len;
 
     ssize_t n_write = 0;
-    // write header
-    conn_->Write((void *)sh.data(), sh.size(), &n_write);
-    return conn_->Write(buf, len, &n_write);
+    return conn_->Writev(iovs, 2, &n_write);
+}
+
+int WebSocketConn::Send(const std::shared_ptr<Buffer> &frame) {
+    return frame->WriteTo(conn_, nullptr);
 }
 
 int WebSocketConn::DoCycle() {
     int ret = COCO_SUCCESS;
     conn_->SetRecvTimeout(HTTP_RECV_TIMEOUT_US);
-    HttpResponseReader *br = http_msg_->body_reader();
+    // the frames received with the upgrade response, then read the connection directly.
+    http_msg_->body_reader()->ReadBuffered(&inbuf_);
+    decode_frames();
 
     // process websocket messages.
     while (!ShouldTermCycle()) {
-        char buf[HTTP_READ_CACHE_BYTES];
-        int nb_read = 0;
-
-        if ((ret = br->Read(buf, HTTP_READ_CACHE_BYTES, &nb_read)) != COCO_SUCCESS) {
+        if ((ret = inbuf_.Fill(conn_, HTTP_READ_CACHE_BYTES, nullptr)) != COCO_SUCCESS) {
             coco_error("read error: %d", ret);
             return ret;
         }
 
-        coco_error("recieved %s", buf);
-        decode((uint8_t *)buf, nb_read);
+        decode_frames();
     }
 
     return ret;
@@ -343,4 +382,9 @@ int WebSocketClient::HandleMessage(std::unique_ptr<WebSocektMessage> msg) {
 int WebSocketClient::Send(uint8_t *buf, ssize_t len, WebSocketHeader::Type data_type) {
     if (conn_ == nullptr) return -1;
     return conn_->Send(buf, len, data_type);
+}
+
+int WebSocketClient::Send(const std::shared_ptr<Buffer> &frame) {
+    if (conn_ == nullptr) return -1;
+    return conn_->Send(frame);
 }
\ No newline at end of file
@@ -1,6 +1,7 @@
 #pragma once
 #include <sstream>
 #include "net/layer7/coco_http.hpp"
+#include "utils/io_buf.hpp"
 #include "utils/utils.hpp"
 
 #define WS_CLIENT_TIMEOUT_US (int64_t)(3 * 1000 * 1000LL)
@@ -82,6 +83,19 @@ class WebSocketConn : public ConnRoutine {
     virtual ~WebSocketConn();
     virtual std::string GetRemoteAddr() { return conn_->RemoteAddr(); };
     int Send(uint8_t *buf, ssize_t len, WebSocketHeader::Type data_type);
+    /**
+     * send the frame built by Frame(), by one write without copying.
+     * @remark the frame can be shared by many connections, which hold it until sent.
+     */
+    int Send(const std::shared_ptr<Buffer> &frame);
+
+ public:
+    /**
+     * build the frame in place, the header is prepended to the headroom of payload in msg.
+     * @param mask whether mask the payload, the client must mask and the server never.
+     * @remark the unmasked frame is the same for all connections, so frame once and share it.
+     */
+    static int Frame(Buffer *msg, WebSocketHeader::Type data_type, bool mask);
 
  public:
     virtual int DoCycle();
@@ -107,11 +121,21 @@ class WebSocketConn : public ConnRoutine {
      */
     void ProcessMessage(std::unique_ptr<WebSocektMessage> msg);
 
+ private:
+    // decode the frames in buffer, and keep the partial frame in buffer.
+    void decode_frames();
+    // write the frame header of len bytes payload to out, return the size of header.
+    static int encode_header(WebSocketHeader &header, uint64_t len, uint8_t *out);
+    // mask the payload in place by the mask key of header.
+    static void mask_payload(WebSocketHeader &header, uint8_t *buffer, uint64_t len);
+
  private:
     // HttpResponseWriter rsp_writer_ = nullptr;
     HttpMessage *http_msg_ = nullptr;
     StreamConn *conn_ = nullptr;
     std::unique_ptr<WebSocektMessage> cur_msg_;
+    // the bytes received but not decoded.
+    IoBuf inbuf_;
 
     int _mask_offset = 0;
     void *observer_ = nullptr;
@@ -136,6 +160,8 @@ class WebSocketClient {
     void SetMessageHandler(WebsocketMessageHandler handler) { message_handler_ = handler; }
     int HandleMessage(std::unique_ptr<WebSocektMessage> msg);
     int Send(uint8_t *buf, ssize_t len, WebSocketHeader::Type data_type = WebSocketHeader::TEXT);
+    // send the frame built by WebSocketConn::Frame() with mask.
+    int Send(const std::shared_ptr<Buffer> &frame);
 
  private:
     std::string sec_websocket_key_;
@@ -29,6 +29,8 @@ enum HttpParseState {
 
 // the default recv timeout.
 #define HTTP_RECV_TIMEOUT_US 60 * 1000 * 1000
+// the send timeout of the 503 response when the connection is rejected by the limits.
+#define HTTP_REJECT_TIMEOUT_US (100 * 1000)
 
 // 6.1.1 Status Code and Reason Phrase
 #define CONSTS_HTTP_Continue 100
@@ -0,0 +1,450 @@
+#include "protocol/http/http_file.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "base/coco_clock.hpp"
+#include "common/error.hpp"
+#include "log/log.hpp"
+#include "protocol/http/http_io.h"
+#include "protocol/http/http_message.h"
+
+// the format of Last-Modified and If-Modified-Since, IMF-fixdate of RFC7231.
+#define HTTP_FILE_DATE_FORMAT "%a, %d %b %Y %H:%M:%S GMT"
+
+static const struct {
+    const char *ext;
+    const char *type;
+} _http_file_types[] = {
+    {".html", "text/html; charset=utf-8"},
+    {".htm", "text/html; charset=utf-8"},
+    {".css", "text/css; charset=utf-8"},
+    {".js", "application/javascript"},
+    {".json", "application/json"},
+    {".txt", "text/plain; charset=utf-8"},
+    {".xml", "text/xml"},
+    {".svg", "image/svg+xml"},
+    {".png", "image/png"},
+    {".jpg", "image/jpeg"},
+    {".jpeg", "image/jpeg"},
+    {".gif", "image/gif"},
+    {".ico", "image/x-icon"},
+    {".webp", "image/webp"},
+    {".wasm", "application/wasm"},
+    {".pdf", "application/pdf"},
+    {".zip", "application/zip"},
+    {".mp3", "audio/mpeg"},
+    {".mp4", "video/mp4"},
+    {".flv", "video/x-flv"},
+    {".m3u8", "application/vnd.apple.mpegurl"},
+    {".ts", "video/MP2T"},
+};
+
+static std::string http_file_content_type(const std::string &path) {
+    size_t pos = path.rfind('.');
+    if (pos != std::string::npos && path.find('/', pos) == std::string::npos) {
+        std::string ext = path.substr(pos);
+        for (auto &t : _http_file_types) {
+            if (strcasecmp(ext.c_str(), t.ext) == 0) {
+                return t.type;
+            }
+        }
+    }
+    return "application/octet-stream";
+}
+
+HttpFile::~HttpFile() {
+    if (fd >= 0) {
+        ::close(fd);
+    }
+}
+
+HttpFileCache::HttpFileCache(int size, int64_t ttl_us) {
+    size_ = size;
+    ttl_us_ = ttl_us;
+}
+
+HttpFileCache::~HttpFileCache() {
+    // the files sending by requests are closed by the last reference.
+    files_.clear();
+    lru_.clear();
+}
+
+int HttpFileCache::Open(const std::string &path, std::shared_ptr<HttpFile> *pfile) {
+    int ret = COCO_SUCCESS;
+
+    int64_t now = CocoClock::Instance()->MonoUs();
+
+    auto it = files_.find(path);
+    if (it != files_.end()) {
+        std::shared_ptr<HttpFile> file = *it->second;
+
+        // the file may be changed or replaced, stat again when the ttl expires.
+        bool fresh = now < file->expires;
+        if (!fresh) {
+            struct stat st;
+            if (::stat(path.c_str(), &st) == 0 && st.st_ino == file->ino &&
+                (int64_t)st.st_size == file->size && st.st_mtime == file->mtime) {
+                file->expires = now + ttl_us_;
+                fresh = true;
+            }
+        }
+
+        if (fresh) {
+            lru_.splice(lru_.begin(), lru_, it->second);
+            stats_.hits++;
+            *pfile = file;
+            return ret;
+        }
+
+        lru_.erase(it->second);
+        files_.erase(it);
+    }
+
+    stats_.misses++;
+    std::shared_ptr<HttpFile> file;
+    if ((ret = open_file(path, &file)) != COCO_SUCCESS) {
+        return ret;
+    }
+    file->expires = now + ttl_us_;
+    *pfile = file;
+
+    if (size_ <= 0) {
+        return ret;
+    }
+
+    lru_.push_front(file);
+    files_[path] = lru_.begin();
+
+    // the evicted file is closed when the last request sent it.
+    while ((int)lru_.size() > size_) {
+        files_.erase(lru_.back()->path);
+        lru_.pop_back();
+        stats_.evictions++;
+    }
+
+    return ret;
+}
+
+int HttpFileCache::open_file(const std::string &path, std::shared_ptr<HttpFile> *pfile) {
+    int ret = COCO_SUCCESS;
+
+    std::shared_ptr<HttpFile> file = std::make_shared<HttpFile>();
+    file->path = path;
+
+    if ((file->fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC)) < 0) {
+        return ERROR_SYSTEM_FILE_OPENE;
+    }
+
+    struct stat st;
+    if (::fstat(file->fd, &st) < 0) {
+        return ERROR_SYSTEM_FILE_OPENE;
+    }
+    if (!S_ISREG(st.st_mode)) {
+        errno = S_ISDIR(st.st_mode) ? EISDIR : EACCES;
+        return ERROR_SYSTEM_IO_INVALID;
+    }
+
+    file->ino = st.st_ino;
+    file->size = (int64_t)st.st_size;
+    file->mtime = st.st_mtime;
+
+    // the etag of nginx, the mtime and size in hex.
+    char buf[64];
+    snprintf(buf, sizeof(buf), "\"%llx-%llx\"", (unsigned long long)file->mtime,
+             (unsigned long long)file->size);
+    file->etag = buf;
+
+    struct tm gmt;
+    if (gmtime_r(&file->mtime, &gmt) != NULL &&
+        strftime(buf, sizeof(buf), HTTP_FILE_DATE_FORMAT, &gmt) > 0) {
+        file->last_modified = buf;
+    }
+
+    file->content_type = http_file_content_type(path);
+
+    *pfile = file;
+    return ret;
+}
+
+// the result of the Range header.
+enum HttpFileRange {
+    // no range, or not supported, for example multiple ranges, serve the whole file.
+    HttpFileRangeNone,
+    HttpFileRangeSatisfiable,
+    HttpFileRangeUnsatisfiable,
+};
+
+// parse the positive decimal, false when not digits or overflow.
+static bool http_file_parse_int(const std::string &s, int64_t *pv) {
+    if (s.empty() || s.length() > 18) {
+        return false;
+    }
+
+    int64_t v = 0;
+    for (char c : s) {
+        if (c < '0' || c > '9') {
+            return false;
+        }
+        v = v * 10 + (c - '0');
+    }
+
+    *pv = v;
+    return true;
+}
+
+// parse the single range of bytes, for example bytes=0-499, bytes=500- and bytes=-500, to the
+// first and last byte of file.
+static HttpFileRange http_file_parse_range(std::string v, int64_t size, int64_t *pstart,
+                                           int64_t *pend) {
+    if (v.compare(0, 6, "bytes=") != 0) {
+        return HttpFileRangeNone;
+    }
+    v = v.substr(6);
+
+    // the multipart of ranges is not supported, the whole file is allowed by RFC7233.
+    size_t dash = v.find('-');
+    if (dash == std::string::npos || v.find(',') != std::string::npos) {
+        return HttpFileRangeNone;
+    }
+
+    std::string first = v.substr(0, dash);
+    std::string last = v.substr(dash + 1);
+
+    int64_t start = 0, end = 0;
+    if (first.empty()) {
+        // the suffix, the last bytes of file.
+        if (!http_file_parse_int(last, &end)) {
+            return HttpFileRangeNone;
+        }
+        if (end == 0 || size == 0) {
+            return HttpFileRangeUnsatisfiable;
+        }
+        *pstart = coco_max(0, size - end);
+        *pend = size - 1;
+        return HttpFileRangeSatisfiable;
+    }
+
+    if (!http_file_parse_int(first, &start)) {
+        return HttpFileRangeNone;
+    }
+    end = size - 1;
+    if (!last.empty() && (!http_file_parse_int(last, &end) || end < start)) {
+        return HttpFileRangeNone;
+    }
+    if (start >= size) {
+        return HttpFileRangeUnsatisfiable;
+    }
+
+    *pstart = start;
+    *pend = coco_min(end, size - 1);
+    return HttpFileRangeSatisfiable;
+}
+
+// decode the %XX of path, false when the escape is invalid.
+static bool http_file_unescape(const std::string &s, std::string *pv) {
+    std::string v;
+    for (size_t i = 0; i < s.length(); i++) {
+        if (s[i] != '%') {
+            v.push_back(s[i]);
+            continue;
+        }
+
+        if (i + 2 >= s.length() || !isxdigit(s[i + 1]) || !isxdigit(s[i + 2])) {
+            return false;
+        }
+        v.push_back((char)strtol(s.substr(i + 1, 2).c_str(), NULL, 16));
+        i += 2;
+    }
+
+    *pv = v;
+    return true;
+}
+
+HttpFileHandler::HttpFileHandler(std::string dir, int cache_size, int64_t cache_ttl_us)
+    : cache_(cache_size, cache_ttl_us) {
+    dir_ = dir;
+    while (dir_.length() > 1 && dir_.at(dir_.length() - 1) == '/') {
+        dir_.erase(dir_.length() - 1);
+    }
+}
+
+HttpFileHandler::~HttpFileHandler() {}
+
+int HttpFileHandler::serve_http(HttpResponseWriter *w, HttpMessage *r) {
+    int ret = COCO_SUCCESS;
+
+    if (!r->is_http_get() && r->method() != HTTP_HEAD) {
+        w->header()->set("Allow", "GET, HEAD");
+        return go_http_error(w, CONSTS_HTTP_MethodNotAllowed);
+    }
+
+    std::string path = file_path(r);
+    if (path.empty()) {
+        coco_warn("http: file path not clean, url=%s", r->url().c_str());
+        return go_http_error(w, CONSTS_HTTP_BadRequest);
+    }
+
+    std::shared_ptr<HttpFile> file;
+    if ((ret = cache_.Open(path, &file)) != COCO_SUCCESS) {
+        int code = CONSTS_HTTP_InternalServerError;
+        if (errno == EISDIR) {
+            // the relative urls in index are resolved by the directory with slash.
+            HttpRedirectHandler redirect(r->path() + "/", CONSTS_HTTP_MovedPermanently);
+            return redirect.serve_http(w, r);
+        } else if (errno == ENOENT || errno == ENOTDIR) {
+            code = CONSTS_HTTP_NotFound;
+        } else if (errno == EACCES) {
+            code = CONSTS_HTTP_Forbidden;
+        }
+
+        coco_info("http: open file %s failed, errno=%d. ret=%d", path.c_str(), errno, ret);
+        return go_http_error(w, code);
+    }
+
+    HttpHeader *h = w->header();
+    h->set("Last-Modified", file->last_modified);
+    h->set("ETag", file->etag);
+    h->set("Accept-Ranges", "bytes");
+
+    if (not_modified(r, file.get())) {
+        w->WriteHeader(CONSTS_HTTP_NotModified);
+        return w->final_request();
+    }
+
+    // the range of the previous version of file is ignored by If-Range.
+    int64_t start = 0, end = file->size - 1;
+    HttpFileRange range = HttpFileRangeNone;
+    std::string v = r->get_request_header("Range");
+    if (!v.empty()) {
+        std::string if_range = r->get_request_header("If-Range");
+        if (if_range.empty() || if_range == file->etag || if_range == file->last_modified) {
+            range = http_file_parse_range(v, file->size, &start, &end);
+        }
+    }
+
+    char buf[128];
+    if (range == HttpFileRangeUnsatisfiable) {
+        snprintf(buf, sizeof(buf), "bytes */%lld", (long long)file->size);
+        h->set("Content-Range", buf);
+        return go_http_error(w, CONSTS_HTTP_RequestedRangeNotSatisfiable);
+    }
+    if (range == HttpFileRangeSatisfiable) {
+        snprintf(buf, sizeof(buf), "bytes %lld-%lld/%lld", (long long)start, (long long)end,
+                 (long long)file->size);
+        h->set("Content-Range", buf);
+    }
+
+    int64_t length = end - start + 1;
+    h->set_content_type(file->content_type);
+    h->set_content_length(length);
+    w->WriteHeader(range == HttpFileRangeSatisfiable ? CONSTS_HTTP_PartialContent
+                                                     : CONSTS_HTTP_OK);
+
+    if (r->method() == HTTP_HEAD || length == 0) {
+        return w->final_request();
+    }
+
+    // the file is referenced until sent, even when evicted by other requests.
+    if ((ret = w->SendFile(file->fd, (off_t)start, length)) != COCO_SUCCESS) {
+        if (!coco_is_client_gracefully_close(ret)) {
+            coco_error("http: send file %s failed. ret=%d", path.c_str(), ret);
+        }
+        return ret;
+    }
+
+    return w->final_request();
+}
+
+std::string HttpFileHandler::file_path(HttpMessage *r) {
+    std::string upath;
+    if (!http_file_unescape(r->path(), &upath)) {
+        return "";
+    }
+
+    // strip the pattern, for example /static/ of /static/js/app.js, and the vhost of pattern.
+    std::string pattern = entry ? entry->pattern : "";
+    if (!pattern.empty() && pattern.at(0) != '/') {
+        size_t pos = pattern.find('/');
+        pattern = pos == std::string::npos ? "" : pattern.substr(pos);
+    }
+    if (pattern.length() > 1 && pattern.at(pattern.length() - 1) == '/' &&
+        upath.compare(0, pattern.length(), pattern) == 0) {
+        upath = upath.substr(pattern.length() - 1);
+    }
+
+    if (upath.empty() || upath.at(0) != '/' || upath.find('\0') != std::string::npos) {
+        return "";
+    }
+
+    // never serve the files outside the directory.
+    size_t pos = 0;
+    while (pos < upath.length()) {
+        size_t next = upath.find('/', pos + 1);
+        if (next == std::string::npos) {
+            next = upath.length();
+        }
+        if (upath.compare(pos, next - pos, "/..") == 0) {
+            return "";
+        }
+        pos = next;
+    }
+
+    if (upath.at(upath.length() - 1) == '/') {
+        upath += HTTP_FILE_INDEX;
+    }
+
+    return dir_ + upath;
+}
+
+bool HttpFileHandler::not_modified(HttpMessage *r, HttpFile *file) {
+    // the If-Modified-Since is ignored when If-None-Match present, see RFC7232.
+    std::string v = r->get_request_header("If-None-Match");
+    if (!v.empty()) {
+        if (v == "*") {
+            return true;
+        }
+
+        // the weak comparison, any of the etags matches.
+        size_t pos = 0;
+        while (pos < v.length()) {
+            size_t next = v.find(',', pos);
+            if (next == std::string::npos) {
+                next = v.length();
+            }
+            std::string etag = v.substr(pos, next - pos);
+            etag.erase(0, etag.find_first_not_of(" \t"));
+            etag.erase(etag.find_last_not_of(" \t") + 1);
+            if (etag.compare(0, 2, "W/") == 0) {
+                etag = etag.substr(2);
+            }
+            if (etag == file->etag) {
+                return true;
+            }
+            pos = next + 1;
+        }
+        return false;
+    }
+
+    v = r->get_request_header("If-Modified-Since");
+    if (v.empty()) {
+        return false;
+    }
+    if (v == file->last_modified) {
+        return true;
+    }
+
+    struct tm gmt;
+    memset(&gmt, 0, sizeof(gmt));
+    if (strptime(v.c_str(), HTTP_FILE_DATE_FORMAT, &gmt) == NULL) {
+        return false;
+    }
+    return file->mtime <= timegm(&gmt);
+}
@@ -0,0 +1,104 @@
+#pragma once
+#include <sys/types.h>
+#include <time.h>
+
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include "protocol/http/http_mux.h"
+
+// the max number of files to keep open.
+#define HTTP_FILE_CACHE_SIZE 1024
+// the time to trust the cached stat of file, then stat again to detect the changes.
+#define HTTP_FILE_CACHE_TTL_US (5 * 1000 * 1000LL)
+// the file to serve for the directory.
+#define HTTP_FILE_INDEX "index.html"
+
+// the opened file and its stat, shared by the cache and the requests sending it.
+struct HttpFile {
+    std::string path;
+    int fd = -1;
+    ino_t ino = 0;
+    int64_t size = 0;
+    time_t mtime = 0;
+    // the validators and headers, formatted once when opened.
+    std::string etag;
+    std::string last_modified;
+    std::string content_type;
+    // the mono time in us to stat again.
+    int64_t expires = 0;
+
+    HttpFile() = default;
+    // close the fd, when evicted and not sending.
+    ~HttpFile();
+};
+
+struct HttpFileCacheStats {
+    // the requests served from the opened files.
+    uint64_t hits = 0;
+    // the files opened, not cached or changed.
+    uint64_t misses = 0;
+    // the files closed for the size of cache.
+    uint64_t evictions = 0;
+};
+
+/**
+ * the lru cache of the opened files and their stat, so the file is opened once, and stat once
+ * in ttl, instead of for each request.
+ * @remark not thread safe, each thread serves by its own mux.
+ */
+class HttpFileCache {
+ public:
+    HttpFileCache(int size = HTTP_FILE_CACHE_SIZE, int64_t ttl_us = HTTP_FILE_CACHE_TTL_US);
+    virtual ~HttpFileCache();
+
+ public:
+    /**
+     * get the opened regular file of path.
+     * @return ERROR_SYSTEM_FILE_OPENE when not opened, and errno is set; ERROR_SYSTEM_IO_INVALID
+     *      when not regular file, and errno is EISDIR for the directory.
+     */
+    int Open(const std::string &path, std::shared_ptr<HttpFile> *pfile);
+    HttpFileCacheStats Stats() { return stats_; }
+
+ private:
+    int open_file(const std::string &path, std::shared_ptr<HttpFile> *pfile);
+
+ private:
+    int size_;
+    int64_t ttl_us_;
+    // the most recently used file at front.
+    std::list<std::shared_ptr<HttpFile>> lru_;
+    std::unordered_map<std::string, std::list<std::shared_ptr<HttpFile>>::iterator> files_;
+    HttpFileCacheStats stats_;
+};
+
+/**
+ * serve the files in directory by GET and HEAD, with the body sent by sendfile for plain tcp,
+ * and Range, If-Range, If-None-Match and If-Modified-Since supported.
+ * the path after the pattern maps to the file in directory, for example:
+ *       mux->handle("/static/", new HttpFileHandler("./www"));
+ * then GET /static/js/app.js serves ./www/js/app.js, and GET /static/ serves ./www/index.html.
+ */
+class HttpFileHandler : public IHttpHandler {
+ public:
+    HttpFileHandler(std::string dir, int cache_size = HTTP_FILE_CACHE_SIZE,
+                    int64_t cache_ttl_us = HTTP_FILE_CACHE_TTL_US);
+    virtual ~HttpFileHandler();
+
+ public:
+    virtual int serve_http(HttpResponseWriter *w, HttpMessage *r);
+    HttpFileCacheStats CacheStats() { return cache_.Stats(); }
+
+ private:
+    // map the request to the file in directory, empty when the path is not clean.
+    std::string file_path(HttpMessage *r);
+    // whether the cached response of client is fresh, so reply 304.
+    bool not_modified(HttpMessage *r, HttpFile *file);
+
+ private:
+    std::string dir_;
+    HttpFileCache cache_;
+};
@@ -3,6 +3,7 @@
 #include <assert.h>
 #include <string.h>
 
+#include "base/coco_clock.hpp"
 #include "common/error.hpp"
 #include "log/log.hpp"
 #include "protocol/http/http_basic.h"
@@ -34,8 +35,8 @@ int HttpResponseWriter::final_request() {
         WriteHeader(CONSTS_HTTP_OK);
     }
 
-    // complete the chunked encoding.
-    if (content_length == -1) {
+    // complete the chunked encoding, never for the status without body, for example 304.
+    if (content_length == -1 && go_http_body_allowd(status)) {
         std::stringstream ss;
         ss << 0 << HTTP_CRLF << HTTP_CRLF;
         std::string ch = ss.str();
@@ -101,6 +102,48 @@ int HttpResponseWriter::Write(char *data, int size) {
     return ret;
 }
 
+int HttpResponseWriter::Write(Buffer *body) {
+    int ret = COCO_SUCCESS;
+
+    // write the header data in memory.
+    if (!header_wrote) {
+        WriteHeader(CONSTS_HTTP_OK);
+    }
+
+    char *data = (char *)body->Data();
+    int size = (int)body->Size();
+
+    // directly send with content length, or the empty body.
+    if (content_length != -1 || size == 0) {
+        return Write(size ? data : nullptr, size);
+    }
+
+    // no room for the chunk framing, send by iovs.
+    int nb_size = snprintf(header_cache, HTTP_HEADER_CACHE_SIZE, "%x", size);
+    if (body->Headroom() < (size_t)nb_size + 2 || body->Tailroom() < 2) {
+        return Write(data, size);
+    }
+
+    if ((ret = SendHeader(data, size)) != COCO_SUCCESS) {
+        coco_error("http: send header failed. ret=%d", ret);
+        return ret;
+    }
+    written += size;
+
+    // send in chunked encoding, framed in place.
+    uint8_t *p = body->Prepend(nb_size + 2);
+    memcpy(p, header_cache, nb_size);
+    memcpy(p + nb_size, HTTP_CRLF, 2);
+    body->Append(HTTP_CRLF, 2);
+
+    ret = body->WriteTo(io_, nullptr);
+
+    body->TrimFront(nb_size + 2);
+    body->TrimBack(2);
+
+    return ret;
+}
+
 int HttpResponseWriter::Writev(iovec *iov, int iovcnt, ssize_t *pnwrite) {
     int ret = COCO_SUCCESS;
 
@@ -184,6 +227,36 @@ int HttpResponseWriter::Writev(iovec *iov, int iovcnt, ssize_t *pnwrite) {
     return ret;
 }
 
+int HttpResponseWriter::SendFile(int fd, off_t offset, int64_t size) {
+    int ret = COCO_SUCCESS;
+
+    // write the header data in memory.
+    if (!header_wrote) {
+        WriteHeader(CONSTS_HTTP_OK);
+    }
+
+    if (content_length == -1) {
+        ret = ERROR_HTTP_CONTENT_LENGTH;
+        coco_error("http: sendfile without content length. ret=%d", ret);
+        return ret;
+    }
+
+    if ((ret = SendHeader(nullptr, 0)) != COCO_SUCCESS) {
+        coco_error("http: send header failed. ret=%d", ret);
+        return ret;
+    }
+
+    // check the bytes send and content length.
+    written += size;
+    if (written > content_length) {
+        ret = ERROR_HTTP_CONTENT_LENGTH;
+        coco_error("http: exceed content length. ret=%d", ret);
+        return ret;
+    }
+
+    return io_->SendFile(fd, offset, (size_t)size, nullptr);
+}
+
 void HttpResponseWriter::WriteHeader(int code) {
     if (header_wrote) {
         coco_warn("http: multiple write_header calls, code=%d", code);
@@ -218,12 +291,19 @@ int HttpResponseWriter::SendHeader(char *data, int size) {
     }
 
     // chunked encoding
-    if (content_length == -1) {
+    if (content_length == -1 && go_http_body_allowd(status)) {
         hdr->set("Transfer-Encoding", "chunked");
     }
 
-    // keep alive to make vlc happy.
-    hdr->set("Connection", "Keep-Alive");
+    // the origin server must send the Date, formatted once a second.
+    if (hdr->get("Date").empty()) {
+        hdr->set("Date", CocoClock::Instance()->HttpDate());
+    }
+
+    // keep alive to make vlc happy, unless the server closes it.
+    if (hdr->get("Connection").empty()) {
+        hdr->set("Connection", "Keep-Alive");
+    }
 
     // write headers
     hdr->write(ss);
@@ -236,6 +316,8 @@ int HttpResponseWriter::SendHeader(char *data, int size) {
     return io_->Write((void *)buf.c_str(), buf.length(), nullptr);
 }
 
+int HttpResponseWriter::Flush() { return io_->Flush(); }
+
 HttpResponseReader::HttpResponseReader(HttpMessage *msg, IoReaderWriter *io) {
     io_ = io;
     owner = msg;
@@ -261,6 +343,17 @@ int HttpResponseReader::initialize(FastBuffer *body) {
 
 bool HttpResponseReader::eof() { return is_eof; }
 
+void HttpResponseReader::ReadBuffered(IoBuf *buf) {
+    int nb_bytes = buffer->size();
+    if (nb_bytes > 0) {
+        buf->Append(buffer->read_slice(nb_bytes), nb_bytes);
+        nb_total_read += nb_bytes;
+    }
+
+    // the connection is read by buf, never by the buffer.
+    buffer->shrink();
+}
+
 int HttpResponseReader::ReadFull(char *data, int nb_data, int *nb_read) {
     int ret = COCO_SUCCESS;
     int nsize = 0;
@@ -5,6 +5,7 @@
 
 #include "protocol/http/http_basic.h"
 #include "protocol/http/http_message.h"
+#include "utils/io_buf.hpp"
 #include "utils/utils.hpp"
 
 class HttpResponseWriter {
@@ -45,8 +46,22 @@ class HttpResponseWriter {
     virtual HttpHeader *header();
     virtual int Write(char *data, int size);
     virtual int Writev(iovec *iov, int iovcnt, ssize_t *pnwrite);
+    /**
+     * write the body in buffer, the chunk size and eof are framed in the headroom and tailroom
+     * of body, so the chunk is sent by one write without copying.
+     * @remark the body is restored after written, but never write a buffer shared by others,
+     *      which is changed while writing.
+     */
+    virtual int Write(Buffer *body);
+    /**
+     * write size bytes of file fd from offset as body, by sendfile when the transport supports.
+     * @remark the Content-Length must be set, the file is never sent in chunked encoding.
+     */
+    virtual int SendFile(int fd, off_t offset, int64_t size);
     virtual void WriteHeader(int code);
     virtual int SendHeader(char *data, int size);
+    // send the bytes buffered by the connection, for example each message of stream.
+    virtual int Flush();
 };
 
 /**
@@ -78,6 +93,11 @@ class HttpResponseReader {
  public:
     virtual bool eof();
     virtual int Read(char *data, int nb_data, int *nb_read);
+    /**
+     * move the bytes left in buffer to buf, for example the frames received with the upgrade
+     * request, then the connection is read by buf.
+     */
+    virtual void ReadBuffered(IoBuf *buf);
     virtual int ReadFull(char *data, int nb_data, int *nb_read);
 
  private:
@@ -14,6 +14,10 @@ public:
 public:
   virtual int Initialize(enum http_parser_type type);
   virtual int Parse(IoReaderWriter *io, void *c);
+  // see HttpParser::SetMessageBeginHandler().
+  void SetMessageBeginHandler(std::function<void()> handler) {
+    parser_->SetMessageBeginHandler(handler);
+  }
 
   virtual int update_buffer(FastBuffer *body);
   virtual HttpResponseReader *get_http_response_reader();
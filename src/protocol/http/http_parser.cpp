@@ -178,6 +178,9 @@ int HttpParser::on_message_begin(http_parser *parser) {
     assert(obj);
 
     obj->state = HttpParseStateStart;
+    if (obj->begin_handler_ != nullptr) {
+        obj->begin_handler_();
+    }
 
     coco_info("***MESSAGE BEGIN***");
 
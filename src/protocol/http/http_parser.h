@@ -1,4 +1,5 @@
 #pragma once
+#include <functional>
 #include <map>
 
 #include "http-parser/http_parser.h"
@@ -77,6 +78,8 @@ class HttpParser {
     http_parser *GetHeader() { return &header_; };
     std::vector<HttpHeaderField> *GetHeaderField() { return &headers_; };
     FastBuffer *GetBuffer() { return buffer_; };
+    // called when the first byte of message is parsed, for example the idle connection is busy.
+    void SetMessageBeginHandler(std::function<void()> handler) { begin_handler_ = handler; };
 
  private:
     /**
@@ -108,4 +111,5 @@ class HttpParser {
 
     std::vector<HttpHeaderField> headers_;
     http_parser header_;
+    std::function<void()> begin_handler_ = nullptr;
 };
\ No newline at end of file
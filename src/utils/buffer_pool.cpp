@@ -0,0 +1,96 @@
+#include "utils/buffer_pool.hpp"
+
+#include <stdlib.h>
+
+#include "utils/utils.hpp"
+
+thread_local CocoBufferPool *_coco_buffer_pool = nullptr;
+
+CocoBufferPool::CocoBufferPool() { max_cached_ = COCO_BUFFER_POOL_MAX_CACHED; }
+
+CocoBufferPool::~CocoBufferPool() { Shrink(); }
+
+CocoBufferPool *CocoBufferPool::Instance() {
+    if (_coco_buffer_pool == nullptr) {
+        _coco_buffer_pool = new CocoBufferPool();
+    }
+    return _coco_buffer_pool;
+}
+
+int CocoBufferPool::class_of(int size) {
+    int capacity = COCO_BUFFER_POOL_MIN_CLASS;
+    for (int i = 0; i < COCO_BUFFER_POOL_NB_CLASSES; i++, capacity <<= 1) {
+        if (size <= capacity) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+char *CocoBufferPool::Get(int size, int *pcapacity) {
+    stats_.gets++;
+
+    int index = class_of(size);
+    int capacity = index < 0 ? size : (COCO_BUFFER_POOL_MIN_CLASS << index);
+
+    char *buf = nullptr;
+    if (index >= 0 && !free_[index].empty()) {
+        buf = free_[index].back();
+        free_[index].pop_back();
+        stats_.hits++;
+        stats_.cached -= capacity;
+    } else {
+        buf = (char *)malloc(capacity);
+    }
+
+    stats_.in_use += capacity;
+    stats_.high_water = coco_max(stats_.high_water, stats_.in_use);
+
+    *pcapacity = capacity;
+    return buf;
+}
+
+void CocoBufferPool::Put(char *buf, int capacity) {
+    if (buf == nullptr) {
+        return;
+    }
+    stats_.in_use -= capacity;
+
+    // only the buffer of class is pooled, never the ones from other allocators.
+    int index = class_of(capacity);
+    if (index < 0 || capacity != (COCO_BUFFER_POOL_MIN_CLASS << index) ||
+        stats_.cached + capacity > max_cached_) {
+        stats_.frees++;
+        free(buf);
+        return;
+    }
+
+    free_[index].push_back(buf);
+    stats_.cached += capacity;
+}
+
+void CocoBufferPool::SetMaxCached(int64_t bytes) {
+    max_cached_ = bytes;
+
+    // free the large buffers first, which are less likely reused.
+    for (int i = COCO_BUFFER_POOL_NB_CLASSES - 1; i >= 0 && stats_.cached > max_cached_; i--) {
+        int capacity = COCO_BUFFER_POOL_MIN_CLASS << i;
+        while (!free_[i].empty() && stats_.cached > max_cached_) {
+            free(free_[i].back());
+            free_[i].pop_back();
+            stats_.cached -= capacity;
+            stats_.frees++;
+        }
+    }
+}
+
+void CocoBufferPool::Shrink() {
+    for (int i = 0; i < COCO_BUFFER_POOL_NB_CLASSES; i++) {
+        for (char *buf : free_[i]) {
+            free(buf);
+            stats_.frees++;
+        }
+        free_[i].clear();
+    }
+    stats_.cached = 0;
+}
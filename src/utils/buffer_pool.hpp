@@ -0,0 +1,68 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <vector>
+
+// the size classes are powers of 2 from min to max, the larger ones are never pooled.
+#define COCO_BUFFER_POOL_MIN_CLASS (4 * 1024)
+#define COCO_BUFFER_POOL_MAX_CLASS (1024 * 1024)
+#define COCO_BUFFER_POOL_NB_CLASSES 9
+// the max bytes of free buffers to keep, the more are freed when put back.
+#define COCO_BUFFER_POOL_MAX_CACHED (32 * 1024 * 1024)
+
+struct BufferPoolStats {
+    // the buffers got, and the ones reused from pool.
+    uint64_t gets = 0;
+    uint64_t hits = 0;
+    // the buffers freed to system, for the pool is full or not pooled.
+    uint64_t frees = 0;
+    // the bytes of buffers in use, and the max of it.
+    int64_t in_use = 0;
+    int64_t high_water = 0;
+    // the bytes of free buffers in pool.
+    int64_t cached = 0;
+
+    double HitRate() const { return gets ? (double)hits / gets : 0; }
+};
+
+/**
+ * the size-classed pool of buffers of each thread, for the recv buffers which are got when
+ * the data arrives and put back when the connection is idle, so the idle connections hold
+ * no buffer, and the busy ones reuse the buffers without malloc.
+ * Usage:
+ *       int capacity = 0;
+ *       char *buf = CocoBufferPool::Instance()->Get(8000, &capacity);
+ *       // capacity is 8192
+ *       CocoBufferPool::Instance()->Put(buf, capacity);
+ * @remark the buffer can be put back to the pool of other thread, but the stats of both pools
+ *      are skewed then.
+ */
+class CocoBufferPool {
+ public:
+    CocoBufferPool();
+    virtual ~CocoBufferPool();
+
+ public:
+    static CocoBufferPool *Instance();
+
+ public:
+    // get a buffer not less than size, and the capacity of the class.
+    char *Get(int size, int *pcapacity);
+    // put back the buffer got with capacity.
+    void Put(char *buf, int capacity);
+    // limit the bytes of free buffers, 0 to never pool.
+    void SetMaxCached(int64_t bytes);
+    // free all buffers in pool, for example when the server is idle.
+    void Shrink();
+    BufferPoolStats Stats() { return stats_; }
+
+ private:
+    // the index of class for size, -1 when too large to pool.
+    static int class_of(int size);
+
+ private:
+    std::vector<char *> free_[COCO_BUFFER_POOL_NB_CLASSES];
+    int64_t max_cached_;
+    BufferPoolStats stats_;
+};
@@ -0,0 +1,316 @@
+#include "utils/io_buf.hpp"
+
+#include <assert.h>
+#include <string.h>
+
+#include <vector>
+
+#include "common/error.hpp"
+#include "log/log.hpp"
+
+IoBuf::Block::Block(size_t size) {
+    data = new char[size];
+    capacity = size;
+    tail = data;
+}
+
+IoBuf::Block::~Block() { delete[] data; }
+
+size_t IoBuf::Segment::tailroom() const {
+    if (end != block->tail) {
+        return 0;
+    }
+    return block->data + block->capacity - end;
+}
+
+IoBuf::IoBuf(size_t block_size) {
+    block_size_ = coco_max(block_size, (size_t)1);
+    size_ = 0;
+}
+
+IoBuf::~IoBuf() {}
+
+int IoBuf::Fill(IoReader *reader, size_t hint, ssize_t *pnread) {
+    int ret = COCO_SUCCESS;
+
+    iovec iovs[COCO_IOBUF_MAX_IOVS];
+    int nb_iovs = 0;
+    size_t room = 0;
+
+    // the tailroom of last block first, then the spare blocks.
+    size_t tailroom = segments_.empty() ? 0 : segments_.back().tailroom();
+    if (tailroom > 0) {
+        iovs[nb_iovs].iov_base = segments_.back().end;
+        iovs[nb_iovs].iov_len = tailroom;
+        nb_iovs++;
+        room += tailroom;
+    }
+
+    hint = coco_max(hint, (size_t)1);
+    for (size_t i = 0; room < hint && nb_iovs < COCO_IOBUF_MAX_IOVS; i++) {
+        if (i == spares_.size()) {
+            spares_.push_back(std::make_shared<Block>(block_size_));
+        }
+        Block *b = spares_[i].get();
+        iovs[nb_iovs].iov_base = b->data;
+        iovs[nb_iovs].iov_len = b->capacity;
+        nb_iovs++;
+        room += b->capacity;
+    }
+
+    ssize_t nread = 0;
+    if ((ret = reader->Readv(iovs, nb_iovs, &nread)) != COCO_SUCCESS) {
+        return ret;
+    }
+    if (pnread) {
+        *pnread = nread;
+    }
+
+    size_t left = (size_t)nread;
+    size_ += left;
+
+    if (tailroom > 0) {
+        Segment &s = segments_.back();
+        size_t n = coco_min(left, tailroom);
+        s.end += n;
+        s.block->tail = s.end;
+        left -= n;
+    }
+
+    while (left > 0) {
+        assert(!spares_.empty());
+        std::shared_ptr<Block> b = spares_.front();
+        spares_.pop_front();
+
+        size_t n = coco_min(left, b->capacity);
+        b->tail = b->data + n;
+
+        Segment s;
+        s.block = b;
+        s.begin = b->data;
+        s.end = b->tail;
+        segments_.push_back(s);
+        left -= n;
+    }
+
+    return ret;
+}
+
+int IoBuf::Grow(IoReader *reader, size_t required) {
+    int ret = COCO_SUCCESS;
+
+    while (size_ < required) {
+        if ((ret = Fill(reader, required - size_, nullptr)) != COCO_SUCCESS) {
+            return ret;
+        }
+    }
+
+    return ret;
+}
+
+void IoBuf::Append(const void *data, size_t size) {
+    const char *p = (const char *)data;
+    size_ += size;
+
+    size_t tailroom = segments_.empty() ? 0 : segments_.back().tailroom();
+    if (tailroom > 0) {
+        Segment &s = segments_.back();
+        size_t n = coco_min(size, tailroom);
+        memcpy(s.end, p, n);
+        s.end += n;
+        s.block->tail = s.end;
+        p += n;
+        size -= n;
+    }
+
+    while (size > 0) {
+        std::shared_ptr<Block> b;
+        if (!spares_.empty()) {
+            b = spares_.front();
+            spares_.pop_front();
+        } else {
+            b = std::make_shared<Block>(coco_max(size, block_size_));
+        }
+
+        size_t n = coco_min(size, b->capacity);
+        memcpy(b->data, p, n);
+        b->tail = b->data + n;
+
+        Segment s;
+        s.block = b;
+        s.begin = b->data;
+        s.end = b->tail;
+        segments_.push_back(s);
+        p += n;
+        size -= n;
+    }
+}
+
+void IoBuf::Append(IoBuf *other) {
+    if (other == this) {
+        return;
+    }
+
+    segments_.insert(segments_.end(), other->segments_.begin(), other->segments_.end());
+    size_ += other->size_;
+
+    other->segments_.clear();
+    other->size_ = 0;
+}
+
+char *IoBuf::Peek(size_t n) {
+    assert(n <= size_);
+    if (n == 0 || segments_.front().size() >= n) {
+        return segments_.empty() ? nullptr : segments_.front().begin;
+    }
+
+    // the bytes across segments, copy to a new block to be contiguous.
+    std::shared_ptr<Block> b = std::make_shared<Block>(coco_max(n, block_size_));
+    char *p = b->data;
+    size_t left = n;
+    while (left > 0) {
+        Segment &s = segments_.front();
+        size_t nb = coco_min(left, s.size());
+        memcpy(p, s.begin, nb);
+        p += nb;
+        left -= nb;
+
+        s.begin += nb;
+        if (s.begin == s.end) {
+            segments_.pop_front();
+        }
+    }
+    b->tail = p;
+
+    Segment s;
+    s.block = b;
+    s.begin = b->data;
+    s.end = b->tail;
+    segments_.push_front(s);
+
+    return s.begin;
+}
+
+size_t IoBuf::Front(char **pdata) const {
+    if (segments_.empty()) {
+        *pdata = nullptr;
+        return 0;
+    }
+
+    *pdata = segments_.front().begin;
+    return segments_.front().size();
+}
+
+size_t IoBuf::Read(void *dst, size_t n) {
+    char *p = (char *)dst;
+    size_t left = coco_min(n, size_);
+    while (left > 0) {
+        const Segment &s = segments_.front();
+        size_t nb = coco_min(left, s.size());
+        memcpy(p, s.begin, nb);
+        p += nb;
+        left -= nb;
+        Skip(nb);
+    }
+
+    return p - (char *)dst;
+}
+
+void IoBuf::Skip(size_t n) {
+    assert(n <= size_);
+    size_ -= n;
+
+    while (n > 0) {
+        Segment &s = segments_.front();
+        size_t nb = coco_min(n, s.size());
+        s.begin += nb;
+        n -= nb;
+
+        if (s.begin == s.end) {
+            segments_.pop_front();
+        }
+    }
+}
+
+void IoBuf::Split(size_t n, IoBuf *head) {
+    assert(n <= size_);
+    size_ -= n;
+    head->size_ += n;
+
+    while (n > 0) {
+        Segment &s = segments_.front();
+        if (s.size() <= n) {
+            n -= s.size();
+            head->segments_.push_back(s);
+            segments_.pop_front();
+            continue;
+        }
+
+        // the head never appends to the block, for its segment never ends at the tail.
+        Segment h = s;
+        h.end = s.begin + n;
+        head->segments_.push_back(h);
+        s.begin += n;
+        n = 0;
+    }
+}
+
+void IoBuf::Slice(size_t offset, size_t n, IoBuf *out) const {
+    assert(offset + n <= size_);
+    out->size_ += n;
+
+    for (size_t i = 0; i < segments_.size() && n > 0; i++) {
+        const Segment &s = segments_[i];
+        if (offset >= s.size()) {
+            offset -= s.size();
+            continue;
+        }
+
+        Segment o = s;
+        o.begin += offset;
+        o.end = o.begin + coco_min(n, s.size() - offset);
+        out->segments_.push_back(o);
+
+        n -= o.size();
+        offset = 0;
+    }
+}
+
+void IoBuf::Clear() {
+    segments_.clear();
+    size_ = 0;
+}
+
+int IoBuf::WriteTo(IoWriter *writer, ssize_t *pnwrite) {
+    int ret = COCO_SUCCESS;
+
+    if (segments_.empty()) {
+        if (pnwrite) {
+            *pnwrite = 0;
+        }
+        return ret;
+    }
+
+    std::vector<iovec> iovs(segments_.size());
+    int nb_iovs = Iovecs(iovs.data(), (int)iovs.size());
+    if ((ret = write_large_iovs(writer, iovs.data(), nb_iovs, nullptr)) != COCO_SUCCESS) {
+        return ret;
+    }
+
+    if (pnwrite) {
+        *pnwrite = (ssize_t)size_;
+    }
+    Clear();
+
+    return ret;
+}
+
+int IoBuf::Iovecs(iovec *iovs, int max) const {
+    int n = 0;
+    for (size_t i = 0; i < segments_.size() && n < max; i++) {
+        iovs[n].iov_base = segments_[i].begin;
+        iovs[n].iov_len = segments_[i].size();
+        n++;
+    }
+    return n;
+}
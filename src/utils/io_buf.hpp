@@ -0,0 +1,113 @@
+#pragma once
+
+#include <sys/uio.h>
+
+#include <deque>
+#include <memory>
+
+#include "utils/utils.hpp"
+
+// the size of each block, the large input is read to multiple blocks by one readv.
+#define COCO_IOBUF_BLOCK_SIZE (16 * 1024)
+// the max blocks to fill by one readv.
+#define COCO_IOBUF_MAX_IOVS 16
+
+/**
+ * the chain of refcounted blocks, the bytes are never moved or copied when the chain grows,
+ * consumed, split or sliced, so the large or pipelined input is copied once from kernel.
+ * the blocks are shared by the chains sliced or split from it, and freed by the last one.
+ * Usage:
+ *       IoBuf in;
+ *       in.Grow(conn, 4);
+ *       uint32_t size = ntohl(*(uint32_t *)in.Peek(4));
+ *       in.Skip(4);
+ *       in.Grow(conn, size);
+ *       IoBuf payload;
+ *       in.Split(size, &payload);
+ * @remark not thread safe, the blocks are shared without lock.
+ */
+class IoBuf {
+ public:
+    IoBuf(size_t block_size = COCO_IOBUF_BLOCK_SIZE);
+    virtual ~IoBuf();
+
+ private:
+    // share the blocks explicitly by Slice(), never by copy.
+    IoBuf(const IoBuf &) = delete;
+    IoBuf &operator=(const IoBuf &) = delete;
+
+ public:
+    // the bytes in chain.
+    size_t Size() const { return size_; }
+    bool Empty() const { return size_ == 0; }
+    // the number of segments, 1 when the bytes are contiguous.
+    int Segments() const { return (int)segments_.size(); }
+
+ public:
+    /**
+     * read once by readv, to the tailroom of the last block and the new blocks for hint bytes.
+     * @param pnread output the bytes read, can be nullptr.
+     */
+    int Fill(IoReader *reader, size_t hint, ssize_t *pnread);
+    // fill until there are required bytes in chain, like FastBuffer::grow().
+    int Grow(IoReader *reader, size_t required);
+    // copy to the tailroom of chain.
+    void Append(const void *data, size_t size);
+    // move all bytes of other to the tail of chain, without copying.
+    void Append(IoBuf *other);
+
+ public:
+    /**
+     * get the first n bytes contiguous, the bytes are copied to a new block only when they are in
+     * multiple segments.
+     * @remark the ptr is valid until the chain is consumed.
+     */
+    char *Peek(size_t n);
+    // the bytes of the first segment, to consume the chain without copying.
+    size_t Front(char **pdata) const;
+    // copy the first n bytes to dst and consume them, return the bytes copied.
+    size_t Read(void *dst, size_t n);
+    // consume the first n bytes.
+    void Skip(size_t n);
+    // move the first n bytes to head, which shares the blocks.
+    void Split(size_t n, IoBuf *head);
+    // append the n bytes from offset to out, which shares the blocks, never consumed.
+    void Slice(size_t offset, size_t n, IoBuf *out) const;
+    void Clear();
+
+ public:
+    /**
+     * write all bytes by writev and consume them.
+     * @param pnwrite output the bytes written, can be nullptr.
+     */
+    int WriteTo(IoWriter *writer, ssize_t *pnwrite);
+    // fill the iovs by segments, return the number of iovs.
+    int Iovecs(iovec *iovs, int max) const;
+
+ private:
+    struct Block {
+        char *data;
+        size_t capacity;
+        // the bytes before tail are written, only the segment ends at tail can append.
+        char *tail;
+
+        Block(size_t size);
+        ~Block();
+    };
+    struct Segment {
+        std::shared_ptr<Block> block;
+        char *begin;
+        char *end;
+
+        size_t size() const { return end - begin; }
+        // the free space after segment, 0 when other segment owns it.
+        size_t tailroom() const;
+    };
+
+ private:
+    size_t block_size_;
+    size_t size_;
+    std::deque<Segment> segments_;
+    // the blocks allocated for readv but not filled, for the next fill.
+    std::deque<std::shared_ptr<Block>> spares_;
+};
@@ -2,16 +2,19 @@
 
 #include <arpa/inet.h>
 #include <assert.h>
+#include <errno.h>
 #include <ifaddrs.h>
 #include <netdb.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 #include <cstdlib>
 
 #include <map>
 
 #include "common/error.hpp"
 #include "log/log.hpp"
+#include "utils/buffer_pool.hpp"
 
 bool is_ipv6(std::string ip) { return false; }
 
@@ -164,22 +167,51 @@ std::string get_public_internet_address() {
 
 // the default recv buffer size, 128KB.
 #define DEFAULT_RECV_BUFFER_SIZE (128 * 1024)
+// the recv buffer size for the small input, which is read by the probe at once.
+#define FAST_BUFFER_MIN_SIZE (16 * 1024)
+// the bytes to read on stack before getting the buffer from pool.
+#define FAST_BUFFER_PROBE_SIZE (4 * 1024)
 // limit user-space buffer to 256KB, for 3Mbps stream delivery.
 //      800*2000/8=200000B(about 195KB).
 // @remark it's ok for higher stream, the buffer is ok for one chunk is 256KB.
 #define MAX_SOCKET_BUFFER (10 * 1024 * 1024)
 
 FastBuffer::FastBuffer() {
-    nb_buffer = DEFAULT_RECV_BUFFER_SIZE;
-    buffer = (char *)malloc(nb_buffer);
-    p = end = buffer;
+    nb_buffer = 0;
+    p = end = buffer = NULL;
 }
 
 FastBuffer::~FastBuffer() {
-    free(buffer);
+    CocoBufferPool::Instance()->Put(buffer, nb_buffer);
     buffer = NULL;
 }
 
+void FastBuffer::alloc_buffer(int size) {
+    int nb_bytes = (int)(end - p);
+
+    int capacity = 0;
+    char *buf = CocoBufferPool::Instance()->Get(size, &capacity);
+    if (nb_bytes > 0) {
+        memcpy(buf, p, nb_bytes);
+    }
+    CocoBufferPool::Instance()->Put(buffer, nb_buffer);
+
+    buffer = buf;
+    nb_buffer = capacity;
+    p = buffer;
+    end = p + nb_bytes;
+}
+
+void FastBuffer::shrink() {
+    if (!buffer || end > p) {
+        return;
+    }
+
+    CocoBufferPool::Instance()->Put(buffer, nb_buffer);
+    nb_buffer = 0;
+    p = end = buffer = NULL;
+}
+
 int FastBuffer::size() { return (int)(end - p); }
 
 char *FastBuffer::bytes() { return p; }
@@ -190,6 +222,10 @@ int FastBuffer::update(char *data, int required_size) {
     // must be positive.
     assert(required_size > 0);
 
+    if (!buffer) {
+        alloc_buffer(coco_max(required_size, FAST_BUFFER_MIN_SIZE));
+    }
+
     // the free space of buffer,
     //      buffer = consumed_bytes + exists_bytes + free_space.
     int nb_free_space = (int)(buffer + nb_buffer - end);
@@ -248,13 +284,7 @@ void FastBuffer::set_buffer(int buffer_size) {
     }
 
     // realloc for buffer change bigger.
-    int start = (int)(p - buffer);
-    int nb_bytes = (int)(end - p);
-
-    buffer = (char *)realloc(buffer, nb_resize_buf);
-    nb_buffer = nb_resize_buf;
-    p = buffer + start;
-    end = p + nb_bytes;
+    alloc_buffer(nb_resize_buf);
 }
 
 char FastBuffer::read_1byte() {
@@ -290,6 +320,29 @@ int FastBuffer::grow(IoReader *reader, int required_size) {
     // must be positive.
     assert(required_size > 0);
 
+    // the buffer is got when the data arrives, so the idle connection holds no buffer, and the
+    // small input never takes the large buffer.
+    if (!buffer) {
+        char probe[FAST_BUFFER_PROBE_SIZE];
+        ssize_t nread;
+        if ((ret = reader->Read(probe, sizeof(probe), &nread)) != COCO_SUCCESS) {
+            return ret;
+        }
+
+        // the large input fills the probe, and is likely followed by more.
+        int size = FAST_BUFFER_MIN_SIZE;
+        if (nread == (ssize_t)sizeof(probe)) {
+            size = DEFAULT_RECV_BUFFER_SIZE;
+        }
+        alloc_buffer(coco_max(size, required_size));
+        memcpy(end, probe, nread);
+        end += nread;
+
+        if (end - p >= required_size) {
+            return ret;
+        }
+    }
+
     // the free space of buffer,
     //      buffer = consumed_bytes + exists_bytes + free_space.
     int nb_free_space = (int)(buffer + nb_buffer - end);
@@ -346,33 +399,73 @@ int FastBuffer::realloc_buffer(int _size) {
     int ret = COCO_SUCCESS;
     int before_free_space = (int)(buffer + nb_buffer - end);
     int before_buffer_size = nb_buffer;
-    int nb_exists_bytes = (int)(end - p);
-    int nb_already_read_bytes = (int)(p - buffer);
-    int realloc_size = nb_already_read_bytes + _size;
-    int n = realloc_size / DEFAULT_RECV_BUFFER_SIZE + 1;
-    realloc_size = n * DEFAULT_RECV_BUFFER_SIZE;
-    realloc_size = coco_max(realloc_size, nb_buffer) + 2 * DEFAULT_RECV_BUFFER_SIZE;
-    if (realloc_size > MAX_SOCKET_BUFFER) {
+
+    // double the buffer for the required bytes, the unread bytes are moved to the start.
+    int realloc_size = coco_min(coco_max(_size, 2 * nb_buffer), MAX_SOCKET_BUFFER);
+    if (_size > MAX_SOCKET_BUFFER) {
         ret = ERROR_READER_BUFFER_OVERFLOW;
         coco_error(
             "buffer overflow, required=%d, buffer size=%d, left=%d, realloc "
             "size=%d, max realloc size=%d",
-            _size, nb_buffer, (int)(buffer + nb_buffer - end), realloc_size, MAX_SOCKET_BUFFER);
+            _size, nb_buffer, before_free_space, realloc_size, MAX_SOCKET_BUFFER);
         return ret;
     }
-    buffer = (char *)realloc(buffer, realloc_size);
-    assert(buffer != NULL);
-    p = buffer + nb_already_read_bytes;
-    end = p + nb_exists_bytes;
-    nb_buffer = realloc_size;
+    alloc_buffer(realloc_size);
     int nb_free_space = (int)(buffer + nb_buffer - end);
-    coco_warn(
+    coco_info(
         "buffer realloc, required=%d, before: max=%d, left=%d, now: "
         "max=%d, left=%d",
         _size, before_buffer_size, before_free_space, nb_buffer, nb_free_space);
     return COCO_SUCCESS;
 }
 
+int IoReader::Readv(const iovec *iov, int iov_size, ssize_t *nread) {
+    for (int i = 0; i < iov_size; i++) {
+        if (iov[i].iov_len > 0) {
+            return Read(iov[i].iov_base, iov[i].iov_len, nread);
+        }
+    }
+
+    if (nread) {
+        *nread = 0;
+    }
+    return COCO_SUCCESS;
+}
+
+int IoWriter::SendFile(int fd, off_t offset, size_t size, ssize_t *nwrite) {
+    int ret = COCO_SUCCESS;
+
+    char *buf = new char[coco_min(size, (size_t)COCO_SENDFILE_CHUNK)];
+    CocoAutoFreeA(char, buf);
+
+    size_t left = size;
+    while (left > 0) {
+        ssize_t nb_read = ::pread(fd, buf, coco_min(left, (size_t)COCO_SENDFILE_CHUNK), offset);
+        if (nb_read < 0 && errno == EINTR) {
+            continue;
+        }
+        if (nb_read <= 0) {
+            ret = nb_read == 0 ? ERROR_SYSTEM_FILE_EOF : ERROR_SYSTEM_FILE_READ;
+            coco_error("pread file fd=%d at %lld failed, errno=%d. ret=%d", fd, (long long)offset,
+                       errno, ret);
+            break;
+        }
+
+        if ((ret = Write(buf, nb_read, nullptr)) != COCO_SUCCESS) {
+            break;
+        }
+        offset += nb_read;
+        left -= nb_read;
+    }
+
+    if (nwrite) {
+        *nwrite = (ssize_t)(size - left);
+    }
+    return ret;
+}
+
+int IoWriter::Flush() { return COCO_SUCCESS; }
+
 int write_large_iovs(IoWriter *skt, iovec *iovs, int size, ssize_t *pnwrite) {
     int ret = COCO_SUCCESS;
     static int limits = 1024;
@@ -454,6 +547,26 @@ std::string GetRemoteAddr(int fd) {
     return GetRemoteAddr(*((sockaddr_in *)&addr));
 }
 
+std::string GetRemoteAddr(const sockaddr *addr) {
+    char ip[INET6_ADDRSTRLEN] = {0};
+    int port = 0;
+    if (addr->sa_family == AF_INET6) {
+        const sockaddr_in6 *in6 = (const sockaddr_in6 *)addr;
+        inet_ntop(AF_INET6, &in6->sin6_addr, ip, sizeof(ip));
+        port = ntohs(in6->sin6_port);
+    } else if (addr->sa_family == AF_INET) {
+        const sockaddr_in *in = (const sockaddr_in *)addr;
+        inet_ntop(AF_INET, &in->sin_addr, ip, sizeof(ip));
+        port = ntohs(in->sin_port);
+    } else {
+        return "";
+    }
+
+    char buf[INET6_ADDRSTRLEN + 8];
+    snprintf(buf, sizeof(buf), "%s:%d", ip, port);
+    return buf;
+}
+
 std::string GetRemoteAddr(sockaddr_in &in) {
     static char _ip_convert_str[INET_ADDRSTRLEN];
     inet_ntop(AF_INET, &(in.sin_addr), _ip_convert_str, INET_ADDRSTRLEN);
@@ -462,4 +575,69 @@ std::string GetRemoteAddr(sockaddr_in &in) {
     sprintf(_ip_convert_str + len + 1, "%d", ntohs(in.sin_port));
 
     return _ip_convert_str;
-}
\ No newline at end of file
+}
+
+Buffer::Buffer(size_t size, size_t headroom, size_t tailroom)
+    : buffer_(new uint8_t[headroom + size + tailroom], std::default_delete<uint8_t[]>()) {
+    capacity_ = headroom + size + tailroom;
+    begin_ = end_ = buffer_.get() + headroom;
+}
+
+Buffer::Buffer(std::unique_ptr<uint8_t[], deleter> data, size_t capacity, size_t len,
+               size_t reserved_front)
+    : buffer_(std::move(data)) {
+    assert(reserved_front + len <= capacity);
+    capacity_ = capacity;
+    begin_ = buffer_.get() + reserved_front;
+    end_ = begin_ + len;
+}
+
+Buffer::~Buffer() {}
+
+std::shared_ptr<Buffer> Buffer::Create(size_t size, size_t headroom, size_t tailroom) {
+    return std::make_shared<Buffer>(size, headroom, tailroom);
+}
+
+uint8_t *Buffer::Prepend(size_t n) {
+    if (Headroom() < n) {
+        return nullptr;
+    }
+    begin_ -= n;
+    return begin_;
+}
+
+uint8_t *Buffer::Append(size_t n) {
+    if (Tailroom() < n) {
+        return nullptr;
+    }
+    uint8_t *p = end_;
+    end_ += n;
+    return p;
+}
+
+bool Buffer::Append(const void *data, size_t size) {
+    uint8_t *p = Append(size);
+    if (p == nullptr) {
+        return false;
+    }
+    memcpy(p, data, size);
+    return true;
+}
+
+void Buffer::TrimFront(size_t n) {
+    assert(n <= Size());
+    begin_ += n;
+}
+
+void Buffer::TrimBack(size_t n) {
+    assert(n <= Size());
+    end_ -= n;
+}
+
+void Buffer::Reset(size_t headroom) {
+    begin_ = end_ = buffer_.get() + coco_min(headroom, capacity_);
+}
+
+int Buffer::WriteTo(IoWriter *writer, ssize_t *pnwrite) {
+    return writer->Write(begin_, Size(), pnwrite);
+}
@@ -2,6 +2,7 @@
 
 #include <arpa/inet.h>
 #include <sys/uio.h>
+#include <functional>
 #include <memory>
 #include <string>
 #include <vector>
@@ -13,6 +14,9 @@ extern std::vector<std::string> &get_local_ipv4_ips();
 // get local public ip, empty string if no public internet address found.
 extern std::string get_public_internet_address();
 
+// the bytes to read from file each time, when the file can't be sent by sendfile.
+#define COCO_SENDFILE_CHUNK (64 * 1024)
+
 // compare
 #define coco_min(a, b) (((a) < (b)) ? (a) : (b))
 #define coco_max(a, b) (((a) < (b)) ? (b) : (a))
@@ -92,6 +96,11 @@ class IoReader {
     virtual ~IoReader() = default;
 
     virtual int Read(void *buf, size_t size, ssize_t *nread) = 0;
+    /**
+     * read once to the iovs, like Read().
+     * @remark the default reads to the first iov, the socket overrides it by readv.
+     */
+    virtual int Readv(const iovec *iov, int iov_size, ssize_t *nread);
 };
 
 class IoWriter {
@@ -101,6 +110,14 @@ class IoWriter {
 
     virtual int Write(void *buf, size_t size, ssize_t *nwrite) = 0;
     virtual int Writev(const iovec *iov, int iov_size, ssize_t *nwrite) = 0;
+    /**
+     * write size bytes of the file fd from offset, the file offset is not changed.
+     * @remark the default reads the file by pread and writes it, the socket overrides it by
+     *      sendfile without copying to user space.
+     */
+    virtual int SendFile(int fd, off_t offset, size_t size, ssize_t *nwrite);
+    // send the bytes buffered by writer, the default writes through and never buffers.
+    virtual int Flush();
 };
 
 class IoReaderWriter : public IoReader, public IoWriter {
@@ -136,6 +153,7 @@ class FastBuffer {
     int nb_buffer;
 
  public:
+    // the buffer is got from CocoBufferPool when the data arrives, never when created.
     FastBuffer();
     virtual ~FastBuffer();
 
@@ -196,6 +214,15 @@ class FastBuffer {
      */
     virtual int grow(IoReader *reader, int required_size);
     virtual int realloc_buffer(int size);
+    /**
+     * put back the buffer to pool when all bytes are consumed, for example when the connection
+     * is idle, and the buffer is got again when the data arrives.
+     */
+    virtual void shrink();
+
+ private:
+    // get the buffer from pool, and move the unread bytes to it.
+    void alloc_buffer(int size);
 };
 
 extern int write_large_iovs(IoWriter *skt, iovec *iovs, int size, ssize_t *pnwrite);
@@ -203,29 +230,76 @@ std::string coco_get_peer_ip(int fd);
 int coco_get_peer_port(int fd);
 std::string GetRemoteAddr(sockaddr_in &in);
 std::string GetRemoteAddr(int fd);
+// format the ipv4 or ipv6 address as ip:port.
+std::string GetRemoteAddr(const sockaddr *addr);
 
-struct Buffer {
+// the bytes reserved before the data of Buffer, for the headers prepended by protocols.
+#define COCO_BUFFER_HEADROOM 64
+// the bytes reserved after the data of Buffer, for the trailers, for example CRLF of chunk.
+#define COCO_BUFFER_TAILROOM 16
+
+/**
+ * the refcounted buffer with headroom before the data and tailroom after it, so the protocol
+ * layers prepend the headers and append the trailers in place, and the framed message is sent
+ * by one write, without copying the payload to a new buffer.
+ * Usage:
+ *       std::shared_ptr<Buffer> msg = Buffer::Create(size);
+ *       memcpy(msg->Append(size), payload, size);
+ *       WebSocketConn::Frame(msg.get(), WebSocketHeader::TEXT, false);
+ *       for (WebSocketConn *conn : conns) conn->Send(msg);
+ * @remark the buffer is read only when shared, frame it before shared by the sockets.
+ */
+class Buffer {
+ public:
     using deleter = std::function<void(uint8_t[])>;
-    const uint16_t kDefaultReserve = 200;
-    explicit Buffer(const size_t capacity)
-        : capacity(capacity),
-          length(0),
-          reserved_front(kDefaultReserve),
-          buffer(new uint8_t[capacity], std::default_delete<uint8_t[]>()) {}
-    Buffer(std::unique_ptr<uint8_t[], deleter> data, const size_t capacity, const size_t len,
-           const size_t reserved_front = 0)
-        : capacity(capacity),
-          length(len),
-          reserved_front(reserved_front),
-          buffer(std::move(data)) {}
-
-    uint8_t *data() { return (buffer == nullptr) ? nullptr : buffer.get() + reserved_front; }
-
-    const size_t capacity;
-    size_t length = 0;
-    size_t reserved_front = 0;
+    // allocate the size bytes for data, and the headroom before it and tailroom after it.
+    explicit Buffer(size_t size, size_t headroom = COCO_BUFFER_HEADROOM,
+                    size_t tailroom = COCO_BUFFER_TAILROOM);
+    // wrap the len bytes at reserved_front of data, which is freed by the deleter.
+    Buffer(std::unique_ptr<uint8_t[], deleter> data, size_t capacity, size_t len,
+           size_t reserved_front = 0);
+    virtual ~Buffer();
 
  private:
-    Buffer() : capacity(0){};
-    std::unique_ptr<uint8_t[], deleter> buffer;
-};
\ No newline at end of file
+    // share the buffer by std::shared_ptr, never by copy.
+    Buffer(const Buffer &) = delete;
+    Buffer &operator=(const Buffer &) = delete;
+
+ public:
+    static std::shared_ptr<Buffer> Create(size_t size, size_t headroom = COCO_BUFFER_HEADROOM,
+                                          size_t tailroom = COCO_BUFFER_TAILROOM);
+
+ public:
+    uint8_t *Data() { return begin_; }
+    size_t Size() const { return end_ - begin_; }
+    size_t Capacity() const { return capacity_; }
+    // the free bytes before and after the data.
+    size_t Headroom() const { return begin_ - buffer_.get(); }
+    size_t Tailroom() const { return buffer_.get() + capacity_ - end_; }
+
+ public:
+    // extend the data n bytes to front, return the ptr to fill, nullptr when no headroom.
+    uint8_t *Prepend(size_t n);
+    // extend the data n bytes to tail, return the ptr to fill, nullptr when no tailroom.
+    uint8_t *Append(size_t n);
+    // copy to the tailroom, return false when no tailroom.
+    bool Append(const void *data, size_t size);
+    // remove n bytes from front or tail, for example to strip the header after sent.
+    void TrimFront(size_t n);
+    void TrimBack(size_t n);
+    // empty the data, which starts at headroom.
+    void Reset(size_t headroom = COCO_BUFFER_HEADROOM);
+
+ public:
+    /**
+     * write the data by one write, the buffer is never changed.
+     * @param pnwrite output the bytes written, can be nullptr.
+     */
+    int WriteTo(IoWriter *writer, ssize_t *pnwrite);
+
+ private:
+    std::unique_ptr<uint8_t[], deleter> buffer_;
+    size_t capacity_;
+    uint8_t *begin_;
+    uint8_t *end_;
+};